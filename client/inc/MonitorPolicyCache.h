@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef _MONITORPOLICYCACHE_H_
+#define _MONITORPOLICYCACHE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * The monitor policies of the client, one for each (user, package, privacy).
+ * The package and privacy ids are interned to small indexes, a policy is found
+ * by an integer key in an open addressing table with linear probing.
+ * A lookup hashes the two ids it is given and allocates nothing.
+ * The cache holds either all the policies, or the slices of the (user, package)
+ * pairs that were asked for. A slice is loaded whole, a package without policy
+ * is then known as such. Past MAX_SLICE_COUNT slices the least recently used
+ * one is evicted.
+ */
+class MonitorPolicyCache
+{
+public:
+	MonitorPolicyCache(void);
+
+	// the key is the one of the server, "userId|packageId|privacyId"
+	bool set(const std::string& userPkgIdPrivacyId, const int monitorPolicy);
+	bool set(const int userId, const std::string& packageId, const std::string& privacyId, const int monitorPolicy);
+	// bKnown tells whether a policy not found doesn't exist, or isn't loaded
+	bool find(const int userId, const std::string& packageId, const std::string& privacyId, int& monitorPolicy, bool& bKnown) const;
+	// the policies of the package for the user, or for all the users with a userId of -1
+	void erase(const int userId, const std::string& packageId);
+	void clear(void);
+	size_t size(void) const
+	{
+		return m_entryCount - m_sliceCount;
+	}
+
+	// all the policies of the user for the package, they replace those in the cache
+	bool setSlice(const int userId, const std::string& packageId, const std::list < std::pair < std::string, int > >& policyList);
+	bool isSliceLoaded(const int userId, const std::string& packageId) const;
+	// all the policies were set, there are no slices any more
+	void setComplete(void)
+	{
+		m_bComplete = true;
+	}
+	bool isComplete(void) const
+	{
+		return m_bComplete;
+	}
+	void print(void) const;
+
+private:
+	// the strings of one kind, known by their index from 1, 0 is none
+	class StringTable
+	{
+	public:
+		StringTable(void);
+		unsigned int find(const std::string& value) const;
+		unsigned int intern(const std::string& value);
+		const std::string& get(unsigned int index) const
+		{
+			return m_strings[index - 1];
+		}
+		size_t size(void) const
+		{
+			return m_strings.size();
+		}
+		void clear(void);
+
+	private:
+		void grow(void);
+
+		std::vector < std::string > m_strings;
+		std::vector < size_t > m_hashes;
+		// an index of m_strings plus 1 in each used slot
+		std::vector < unsigned int > m_slots;
+	};
+
+	struct Entry
+	{
+		// 0 in an empty slot, a key always has a package index
+		unsigned long long key;
+		// for the marker of a slice, of privacy index 0, the index of its use
+		int monitorPolicy;
+	};
+
+	// the last use of each slice, shared by the copies of the cache
+	struct SliceUses;
+
+	static unsigned long long makeKey(const int userId, const unsigned int packageIndex, const unsigned int privacyIndex);
+	size_t findSlot(const unsigned long long key) const;
+	void grow(void);
+	void insert(const unsigned long long key, const int monitorPolicy);
+	// the policies of the package for the user or all the users, the markers too if bWithSlices
+	void remove(const int userId, const unsigned int packageIndex, const bool bWithSlices);
+	void evictSlice(void);
+
+	StringTable m_packageIds;
+	StringTable m_privacyIds;
+	std::vector < Entry > m_entries;
+	size_t m_entryCount;
+	bool m_bComplete;
+	std::shared_ptr < SliceUses > m_pSliceUses;
+	// the key of the marker of each slice by the index of its use, 0 for a free one
+	std::vector < unsigned long long > m_sliceKeys;
+	size_t m_sliceCount;
+};
+
+#endif // _MONITORPOLICYCACHE_H_
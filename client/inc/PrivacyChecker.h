@@ -26,18 +26,30 @@
 #include <dbus/dbus.h>
 #include <glib.h>
 #include "PrivacyGuardTypes.h"
+#include "MonitorPolicyCache.h"
+#include "MonitorPolicySnapshot.h"
+#include "SnapshotPointer.h"
 
 struct sqlite3;
 
 class EXTERN_API PrivacyChecker
 {
 private:
-	static std::map < std::string, bool > m_privacyCache;
-	static std::map < std::string, std::map < std::string, bool > > m_privacyInfoCache;
-	static std::map < std::string, int > m_monitorPolicyCache;
+	// the caches as a whole, never changed once published
+	struct CacheSnapshot
+	{
+		std::map < std::string, bool > privacyCache;
+		std::map < std::string, std::shared_ptr < const std::map < std::string, bool > > > privacyInfoCache;
+		std::shared_ptr < const MonitorPolicyCache > pMonitorPolicyCache;
+		// the file of the server, the cache is used without it
+		std::shared_ptr < const MonitorPolicySnapshot > pMonitorPolicySnapshot;
+	};
+
+	static SnapshotPointer < CacheSnapshot > m_cacheSnapshot;
 	static std::string m_pkgId;
 	static bool m_isInitialized;
 	static bool m_isMonitorEnable;
+	// taken by the writers of m_cacheSnapshot only, the readers don't lock
 	static std::mutex m_cacheMutex;
 	static std::mutex m_dbusMutex;
 	static std::mutex m_initializeMutex;
@@ -54,7 +66,11 @@ private:
 	static void printCache(void);
 	static void* runSignalListenerThread(void* pData);
 	static int getCurrentPkgId(std::string& pkgId);
-	static int check(const std::string privacyId, std::map < std::string, bool >& privacyMap);
+	static int check(const std::string privacyId, const std::map < std::string, bool >& privacyMap);
+	// the policies of the package for the user, at the first check that misses them
+	static int loadMonitorPolicySlice(const int userId, const std::string& packageId);
+	// maps the last file of the server in place of pReplaced, none if it can't be read
+	static void openMonitorPolicySnapshot(const MonitorPolicySnapshot* pReplaced);
 
 public:
 	// for Checking in App Process
@@ -72,7 +88,9 @@ public:
 	static int checkWithDeviceCap(const std::string deviceCap);
 	static void printMonitorPolicyCache(void);
 	static int initMonitorPolicyCache(void);
-	static int getMonitorPolicy(const int userId, const std::string packageId, const std::string privacyId, int &monitorPolicy);
+	// all the monitor policies of all the users, for the daemons that check any package
+	static int prefetchMonitorPolicyCache(void);
+	static int getMonitorPolicy(const int userId, const std::string& packageId, const std::string& privacyId, int &monitorPolicy);
 	// common
 	static int finalize(void);
 	static DBusHandlerResult handleNotification(DBusConnection* connection, DBusMessage* message, void* user_data);
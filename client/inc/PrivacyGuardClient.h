@@ -22,7 +22,14 @@
 #include <list>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <condition_variable>
+#include <pthread.h>
 #include "PrivacyGuardTypes.h"
+#include "SocketConnection.h"
+#ifdef USE_ACCESS_LOG_RING
+#include "AccessLogRing.h"
+#endif
 
 class SocketClient;
 
@@ -36,10 +43,54 @@ private:
 
 	static std::mutex m_singletonMutex;
 
-	std::list <std::pair<std::string, std::string>> logInfoList;
+	// a log waiting for the flush thread
+	struct PendingLog
+	{
+		int userId;
+		std::string packageId;
+		std::string privacyId;
+		PendingLog* pNext;
+	};
+
+	static const int FLUSH_COUNT;
+	static const int FLUSH_DELAY_MS;
+
+	// the callers push to the front without a lock, the flush thread takes the whole list
+	std::atomic < PendingLog* > m_pPendingLogs;
+	// may be below the length of the list for a moment, never above it for long
+	std::atomic < int > m_pendingLogCount;
+	pthread_t m_flushThread;
+	std::atomic < bool > m_bFlushThreadStarted;
+	bool m_bFlushStopRequested;
+	// held around the waits of the flush thread, never around a call
+	std::mutex m_flushMutex;
+	std::condition_variable m_flushCondition;
+	// the flushes are made one at a time, in the order of the logs
+	std::mutex m_flushCallMutex;
+#ifdef USE_ACCESS_LOG_RING
+	// one writer at a time for the ring, the loggers only try it
+	std::mutex m_ringMutex;
+	std::unique_ptr < AccessLogRing > m_pAccessLogRing;
+	bool m_bAccessLogRingFailed;
+	// the user the server knows the process by
+	int m_ringUserId;
+#endif
 
 	PrivacyGuardClient();
 	~PrivacyGuardClient();
+	void pushPendingLog(const int userId, const std::string& packageId, const std::string& privacyId);
+	int flushPendingLogs(void);
+	int startFlushThread(void);
+	void stopFlushThread(void);
+	static void* flushThread(void* pData);
+	void flushLoop(void);
+	static void flushAtExit(void);
+	static void prepareFork(void);
+	static void resumeParent(void);
+	static void resumeChild(void);
+#ifdef USE_ACCESS_LOG_RING
+	void openAccessLogRing(void);
+#endif
 
 public:
 	static PrivacyGuardClient* getInstance(void);
@@ -60,24 +111,47 @@ public:
 
 	int PgForeachTotalPrivacyCountOfPackage(const int userId, const int startDate, const int endDate, std::list < std::pair <std::string, int > > & packageInfoList) const;
 
+	// the receiver gets each result as it arrives, see ListReceiver
+	int PgForeachTotalPrivacyCountOfPackage(const int userId, const int startDate, const int endDate, ListReceiver < std::pair <std::string, int > > packageInfoReceiver) const;
+
 	int PgForeachTotalPrivacyCountOfPrivacy(const int userId, const int startDate, const int endDate, std::list < std::pair <std::string, int > > & privacyInfoList) const;
 
+	int PgForeachTotalPrivacyCountOfPrivacy(const int userId, const int startDate, const int endDate, ListReceiver < std::pair <std::string, int > > privacyInfoReceiver) const;
+
 	int PgForeachPrivacyCountByPrivacyId(const int userId, const int startDate, const int endDate, const std::string privacyId, std::list < std::pair <std::string, int > > & packageInfoList) const;
 
+	int PgForeachPrivacyCountByPrivacyId(const int userId, const int startDate, const int endDate, const std::string privacyId, ListReceiver < std::pair <std::string, int > > packageInfoReceiver) const;
+
 	int PgForeachPrivacyCountByPackageId(const int userId, const int startDate, const int endDate, const std::string packageId, std::list < std::pair <std::string, int > > & privacyInfoList) const;
 
+	int PgForeachPrivacyCountByPackageId(const int userId, const int startDate, const int endDate, const std::string packageId, ListReceiver < std::pair <std::string, int > > privacyInfoReceiver) const;
+
 	int PgForeachPrivacyPackageId(const int userId, std::list < std::string > & packageList) const;
 
+	int PgForeachPrivacyPackageId(const int userId, ListReceiver < std::string > packageReceiver) const;
+
 	int PgForeachPackageByPrivacyId(const int userId, const std::string privacyId, std::list < std::string > & packageList) const;
 
+	int PgForeachPackageByPrivacyId(const int userId, const std::string privacyId, ListReceiver < std::string > packageReceiver) const;
+
 	int PgForeachMonitorPolicyByPackageId(const int userId, const std::string packageId,
 		std::list <privacy_data_s> & privacyInfoList) const;
 
+	// a privacy_data_s is received as the pair of its privacy id and monitor policy
+	int PgForeachMonitorPolicyByPackageId(const int userId, const std::string packageId,
+		ListReceiver < std::pair <std::string, int > > privacyInfoReceiver) const;
+
+	// the monitor policies of several packages in one round trip
+	int PgForeachMonitorPolicyByPackageIdList(const int userId, const std::list < std::string >& packageList,
+		std::list < std::pair < std::string, std::list <privacy_data_s> > > & monitorPolicyList) const;
+
 	int PgGetMonitorPolicy(const int userId, const std::string packageId,
 		const std::string privacyId, int& monitorPolicy) const;
 
 	int PgGetAllMonitorPolicy(std::list < std::pair < std::string, int > > & monitorPolicyList) const;
 
+	int PgGetAllMonitorPolicy(ListReceiver < std::pair < std::string, int > > monitorPolicyReceiver) const;
+
 	int PgCheckPrivacyPackage(const int userId, const std::string packageId, bool &isPrivacyPackage);
 
 	int PgUpdateMonitorPolicy(const int userId, const std::string packageId,
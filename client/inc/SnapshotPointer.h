@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef _SNAPSHOTPOINTER_H_
+#define _SNAPSHOTPOINTER_H_
+
+#include <atomic>
+#include <sched.h>
+
+/*
+ * An immutable value shared by many readers and replaced by one writer at a time.
+ * A reader takes no lock: it counts itself in the current epoch, reads the value
+ * and leaves. The writer publishes a new value, flips the epoch and frees the old
+ * value once no reader of the old epoch is left.
+ * The readers are counted on stripes of their own cache line, chosen by thread,
+ * so that readers on other cores don't write the same line.
+ * The writers must be serialized by the caller, and a thread must not publish
+ * while it reads.
+ */
+template < typename T >
+class SnapshotPointer
+{
+private:
+	// a power of 2
+	static const unsigned int STRIPE_COUNT = 16;
+
+	struct alignas(64) Stripe
+	{
+		std::atomic < unsigned int > readerCount[2];
+	};
+
+	std::atomic < T* > m_pValue;
+	std::atomic < unsigned int > m_epoch;
+	Stripe m_stripes[STRIPE_COUNT];
+
+	static unsigned int getStripeIndex(void)
+	{
+		// the threads take the stripes in turn at their first read. A hash of pthread_self()
+		// would put them all on one stripe, the thread ids are page aligned addresses
+		static std::atomic < unsigned int > nextStripeIndex(0);
+		static __thread unsigned int stripeIndex = 0;
+		if (stripeIndex == 0)
+			stripeIndex = nextStripeIndex.fetch_add(1, std::memory_order_relaxed) | STRIPE_COUNT;
+		return stripeIndex & (STRIPE_COUNT - 1);
+	}
+
+	unsigned int enter(std::atomic < unsigned int >** ppReaderCount)
+	{
+		Stripe& stripe = m_stripes[getStripeIndex()];
+		while (1)
+		{
+			unsigned int epoch = m_epoch.load(std::memory_order_seq_cst) & 1;
+			stripe.readerCount[epoch].fetch_add(1, std::memory_order_seq_cst);
+			// a writer that flipped the epoch meanwhile may not wait for this reader
+			if ((m_epoch.load(std::memory_order_seq_cst) & 1) == epoch)
+			{
+				*ppReaderCount = &stripe.readerCount[epoch];
+				return epoch;
+			}
+			stripe.readerCount[epoch].fetch_sub(1, std::memory_order_release);
+		}
+	}
+
+	void waitForReaders(unsigned int epoch)
+	{
+		for (unsigned int i = 0; i < STRIPE_COUNT; ++i)
+		{
+			while (m_stripes[i].readerCount[epoch].load(std::memory_order_acquire) != 0)
+				sched_yield();
+		}
+	}
+
+public:
+	class ReadGuard
+	{
+	private:
+		std::atomic < unsigned int >* m_pReaderCount;
+		const T* m_pValue;
+
+		ReadGuard(const ReadGuard&);
+		ReadGuard& operator=(const ReadGuard&);
+
+	public:
+		explicit ReadGuard(SnapshotPointer& pointer)
+		{
+			pointer.enter(&m_pReaderCount);
+			m_pValue = pointer.m_pValue.load(std::memory_order_acquire);
+		}
+		~ReadGuard(void)
+		{
+			m_pReaderCount->fetch_sub(1, std::memory_order_release);
+		}
+		const T* operator->(void) const
+		{
+			return m_pValue;
+		}
+		const T& operator*(void) const
+		{
+			return *m_pValue;
+		}
+	};
+
+	explicit SnapshotPointer(T* pValue)
+		: m_pValue(pValue)
+		, m_epoch(0)
+	{
+		for (unsigned int i = 0; i < STRIPE_COUNT; ++i)
+		{
+			m_stripes[i].readerCount[0] = 0;
+			m_stripes[i].readerCount[1] = 0;
+		}
+	}
+
+	~SnapshotPointer(void)
+	{
+		delete m_pValue.load();
+	}
+
+	// the value as the writer sees it, the writer is the only one to free it
+	const T* get(void) const
+	{
+		return m_pValue.load(std::memory_order_acquire);
+	}
+
+	// returns once the old value is freed, no reader can see it any more
+	void publish(T* pValue)
+	{
+		T* pOldValue = m_pValue.exchange(pValue, std::memory_order_seq_cst);
+		unsigned int oldEpoch = m_epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+		waitForReaders(oldEpoch);
+		delete pOldValue;
+	}
+};
+
+#endif // _SNAPSHOTPOINTER_H_
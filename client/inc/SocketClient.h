@@ -18,25 +18,44 @@
 #define _SOCKETCLIENT_H_
 
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
 #include <string>
+#include <vector>
+#include <functional>
 #include <dlog.h>
 #include "SocketConnection.h"
 
 /* IMPORTANT:
- * Methods connect(), call() and disconnected() should be called one by one.
- * Between connect() and disconnect() you can use call() only once.
- * It is because of timeout on call, e.g. to avoid waiting for corrupted data.
+ * The client keeps one connection to the server and sends every call on it.
+ * The connection is opened by the first call and opened again when the server
+ * has closed it, e.g. after a restart of the daemon. A request that could not be
+ * sent on a reused connection is sent once more on a new one.
+ * Each request carries an id and the server answers with the same id, so a
+ * response that does not belong to the request closes the connection.
+ * Calls from several threads are serialized on the connection.
+ * A list read into a ListReceiver is handed over while the response is still
+ * being received; a call made from the receiver goes over a connection of its own.
  */
 
 /* USAGE:
  * Class should be used according to this scheme:
  * SocketClient client("Interface Name");
  * (...)
- * client.connect();
  * client.call("Method name", in_arg1, in_arg2, ..., in_argN,
  *             out_arg1, out_arg2, ..., out_argM);
- * client.disconnect();
  * (...)
+ * client.disconnect(); // optional, closes the connection
+ *
+ * Several calls can be sent at once, the requests are written back to back and
+ * the responses are read after them:
+ * SocketClient::Batch batch;
+ * batch.add("Method name", in_arg1, ..., out_arg1, ...);
+ * batch.add("Other method", in_arg1, ..., out_arg1, ...);
+ * client.callBatch(batch);
+ * The arguments of a batched call are copied, output pointers must stay valid
+ * until callBatch() returns.
  *
  * input parameters of the call are passed with reference,
  * output ones are passed as pointers - parameters MUST be passed this way.
@@ -54,8 +73,38 @@
 class EXTERN_API SocketClient
 {
 public:
+	class Batch
+	{
+	public:
+		template<typename ...Args>
+		void add(const std::string& methodName, const Args&... args)
+		{
+			BatchCall batchCall;
+			batchCall.methodName = methodName;
+			batchCall.writeArgs = [=](SocketClient* pClient) { return pClient->write_args(args...); };
+			batchCall.readArgs = [=](SocketClient* pClient) { return pClient->read_args(args...); };
+			m_callList.push_back(batchCall);
+		}
+
+		size_t size(void) const
+		{
+			return m_callList.size();
+		}
 
-	SocketClient(const std::string &interfaceName);
+	private:
+		friend class SocketClient;
+		struct BatchCall
+		{
+			std::string methodName;
+			std::function < int (SocketClient*) > writeArgs;
+			std::function < int (SocketClient*) > readArgs;
+		};
+		std::vector < BatchCall > m_callList;
+	};
+
+	// serverAddress is the path of the server socket, another one is for tests
+	SocketClient(const std::string &interfaceName, const std::string &serverAddress = SERVER_ADDRESS);
+	~SocketClient();
 	int connect();
 	int disconnect();
 
@@ -63,13 +112,31 @@ public:
 	{
 		PF_LOGI("call m_interfaceName : %s, methodName : %s", m_interfaceName.c_str(), methodName.c_str());
 
-		int res = make_call(m_interfaceName);
-		PF_LOGI("call make_call interface res : %d", res);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "make_call : %d", res);
+		if (m_callingThread.load() == std::this_thread::get_id())
+		{
+			SocketClient nestedClient(m_interfaceName, m_serverAddress);
+			return nestedClient.call(methodName);
+		}
 
-		res = make_call(methodName);
-		PF_LOGI("call make_call method res : %d", res);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "make_call : %d", res);
+		std::lock_guard < std::mutex > guard(m_connectionMutex);
+		CallingThreadScope callingThreadScope(this);
+
+		int res = PRIV_FLTR_ERROR_IPC_ERROR;
+		for (int attempt = 0; attempt < MAX_SEND_ATTEMPTS; ++attempt)
+		{
+			bool bReused = false;
+			res = beginRequest(methodName, &bReused);
+			if (res == PRIV_FLTR_ERROR_SUCCESS)
+				res = readResponseHeader(m_requestId);
+			PF_LOGI("call res : %d", res);
+			if (res == PRIV_FLTR_ERROR_SUCCESS)
+				return PRIV_FLTR_ERROR_SUCCESS;
+
+			closeConnection();
+			if (bReused == false || m_bResponseStarted == true)
+				break;
+		}
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 		return PRIV_FLTR_ERROR_SUCCESS;
 	}
@@ -78,25 +145,140 @@ public:
 	int call(std::string methodName, const Args&... args)
 	{
 		PF_LOGI("call Args m_interfaceName : %s, methodName : %s", m_interfaceName.c_str(), methodName.c_str());
-		int res = make_call(m_interfaceName);
-		PF_LOGI("call Args make_call interface res : %d", res);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "make_call : %d", res);
-		res = make_call(methodName);
-		PF_LOGI("call Args make_call method res : %d", res);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "make_call : %d", res);
-		res = make_call(args...);
-		PF_LOGI("call Args make_call args res : %d", res);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "make_call : %d", res);
 
+		// the connection is busy with the response this call is made from
+		if (m_callingThread.load() == std::this_thread::get_id())
+		{
+			SocketClient nestedClient(m_interfaceName, m_serverAddress);
+			return nestedClient.call(methodName, args...);
+		}
+
+		std::lock_guard < std::mutex > guard(m_connectionMutex);
+		CallingThreadScope callingThreadScope(this);
+
+		int res = PRIV_FLTR_ERROR_IPC_ERROR;
+		for (int attempt = 0; attempt < MAX_SEND_ATTEMPTS; ++attempt)
+		{
+			bool bReused = false;
+			res = beginRequest(methodName, &bReused);
+			if (res == PRIV_FLTR_ERROR_SUCCESS)
+				res = make_call(args...);
+			// a call without output arguments still waits for the response
+			if (res == PRIV_FLTR_ERROR_SUCCESS && m_bResponseStarted == false)
+				res = readResponseHeader(m_requestId);
+			PF_LOGI("call Args res : %d", res);
+			if (res == PRIV_FLTR_ERROR_SUCCESS)
+				return PRIV_FLTR_ERROR_SUCCESS;
+
+			closeConnection();
+			// once the response is being read the request may have been served, never send it again
+			if (bReused == false || m_bResponseStarted == true)
+				break;
+		}
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
+
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	int callBatch(const Batch& batch);
+
+	// for pthread_atfork : no call is halfway through the connection when the process forks,
+	// and the child never shares the connection of its parent
+	void prepareFork(void);
+	void resumeParent(void);
+	void resetAfterFork(void);
+
+private:
+	// marks the thread using the connection while it is held
+	class CallingThreadScope
+	{
+	public:
+		explicit CallingThreadScope(SocketClient* pClient) : m_pClient(pClient)
+		{
+			m_pClient->m_callingThread = std::this_thread::get_id();
+		}
+
+		~CallingThreadScope()
+		{
+			m_pClient->m_callingThread = std::thread::id();
+		}
+
+	private:
+		SocketClient* m_pClient;
+	};
+
+	int openConnection(void);
+	void closeConnection(void);
+	int prepareConnection(bool* pReused);
+	int writeRequestHeader(const std::string& methodName);
+	int beginRequest(const std::string& methodName, bool* pReused);
+	int readResponseHeader(unsigned int expectedRequestId);
+
+	// batched calls write the input arguments first and read the output arguments later
+	int write_args(void)
+	{
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	template<typename T, typename ...Args>
+	int write_args(const T& invalue, const Args&... args)
+	{
+		int res = write_arg(invalue);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write_arg : %d", res);
+
+		return write_args(args...);
+	}
+
+	template<typename T>
+	int write_arg(const T& invalue)
+	{
+		return m_socketConnector->write(invalue);
+	}
+
+	template<typename T>
+	int write_arg(const T* invalue)
+	{
+		return m_socketConnector->write(invalue);
+	}
+
+	template<typename T>
+	int write_arg(T* outvalue)
+	{
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	int read_args(void)
+	{
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	template<typename T, typename ...Args>
+	int read_args(const T& invalue, const Args&... args)
+	{
+		int res = read_arg(invalue);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "read_arg : %d", res);
+
+		return read_args(args...);
+	}
+
+	template<typename T>
+	int read_arg(const T& invalue)
+	{
 		return PRIV_FLTR_ERROR_SUCCESS;
 	}
 
 	template<typename T>
-	int read(T* outvalue)
+	int read_arg(const T* invalue)
+	{
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	template<typename T>
+	int read_arg(T* outvalue)
 	{
 		return m_socketConnector->read(outvalue);
 	}
-private:
+
 	template<typename T, typename ...Args>
 	int make_call(const T& invalue, const Args&... args)
 	{
@@ -145,15 +327,28 @@ private:
 	template<typename T>
 	int make_call(T* outvalue)
 	{
+		if (m_bResponseStarted == false)
+		{
+			int res = readResponseHeader(m_requestId);
+			TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readResponseHeader : %d", res);
+		}
 		return m_socketConnector->read(outvalue);
-    }
+	}
 
 
 private:
+	static const int MAX_SEND_ATTEMPTS;
+	static const int CALL_TIMEOUT_MS;
+	static const size_t MAX_PIPELINE_DEPTH;
+	static const size_t MAX_PIPELINE_BYTES;
 	std::string m_serverAddress;
 	std::string m_interfaceName;
 	std::unique_ptr<SocketConnection> m_socketConnector;
 	int m_socketFd;
+	std::mutex m_connectionMutex;
+	unsigned int m_requestId;
+	bool m_bResponseStarted;
+	std::atomic < std::thread::id > m_callingThread;
 };
 
 #endif // _SOCKETCLIENT_H_
\ No newline at end of file
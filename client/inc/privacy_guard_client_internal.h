@@ -39,6 +39,14 @@ extern "C" {
  */
 EXTERN_API int privacy_guard_client_add_privacy_access_log(const int user_id, const char *package_id, const char *privacy_id);
 
+/**
+ * @fn int privacy_guard_client_prefetch_monitor_policy(void)
+ * @brief load the monitor policies of all users and packages at once, for a daemon that logs for any package
+ * @remarks Without it the policies are loaded per user and package at their first check
+ * @return the result of operation (ERRORCODE : success, ....)
+ */
+EXTERN_API int privacy_guard_client_prefetch_monitor_policy(void);
+
 /**
  * @fn int privacy_guard_client_delete_all_logs_and_monitor_policy(void)
  * @brief clear all data from StatisticsMonitor and MonitorPolicy DB
@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include <atomic>
+#include <functional>
+#include <stdlib.h>
+#include <dlog.h>
+#include "Utils.h"
+#include "MonitorPolicyCache.h"
+
+// powers of 2, the tables are grown before they are half full
+#define INITIAL_SLOT_COUNT 16
+// the bits of the package and privacy indexes in a key, the user id has the upper 32
+#define PACKAGE_INDEX_BITS 24
+#define PRIVACY_INDEX_BITS 8
+#define MAX_PACKAGE_INDEX ((1U << PACKAGE_INDEX_BITS) - 1)
+#define MAX_PRIVACY_INDEX ((1U << PRIVACY_INDEX_BITS) - 1)
+// a process checks its own package and a few others, a daemon asks for all the policies instead
+#define MAX_SLICE_COUNT 64
+
+struct MonitorPolicyCache::SliceUses
+{
+	// moved by the writer at each slice it loads, the readers only copy it
+	std::atomic < unsigned int > tick;
+	std::atomic < unsigned int > lastUse[MAX_SLICE_COUNT];
+};
+
+// Fibonacci hashing, the upper bits of the product are spread over the table
+static inline size_t
+spreadHash(unsigned long long value, size_t slotCount)
+{
+	return (size_t)((value * 0x9E3779B97F4A7C15ULL) >> 32) & (slotCount - 1);
+}
+
+MonitorPolicyCache::StringTable::StringTable(void)
+	: m_slots(INITIAL_SLOT_COUNT, 0)
+{
+
+}
+
+unsigned int
+MonitorPolicyCache::StringTable::find(const std::string& value) const
+{
+	size_t hash = std::hash < std::string > ()(value);
+	size_t mask = m_slots.size() - 1;
+	for (size_t slot = spreadHash(hash, m_slots.size()); m_slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		unsigned int index = m_slots[slot];
+		if (m_hashes[index - 1] == hash && m_strings[index - 1] == value)
+			return index;
+	}
+
+	return 0;
+}
+
+unsigned int
+MonitorPolicyCache::StringTable::intern(const std::string& value)
+{
+	unsigned int index = find(value);
+	if (index != 0)
+		return index;
+
+	if ((m_strings.size() + 1) * 2 > m_slots.size())
+		grow();
+
+	size_t hash = std::hash < std::string > ()(value);
+	m_strings.push_back(value);
+	m_hashes.push_back(hash);
+	index = m_strings.size();
+
+	size_t mask = m_slots.size() - 1;
+	size_t slot = spreadHash(hash, m_slots.size());
+	while (m_slots[slot] != 0)
+		slot = (slot + 1) & mask;
+	m_slots[slot] = index;
+
+	return index;
+}
+
+void
+MonitorPolicyCache::StringTable::grow(void)
+{
+	std::vector < unsigned int > slots(m_slots.size() * 2, 0);
+	size_t mask = slots.size() - 1;
+	for (size_t i = 0; i < m_strings.size(); ++i)
+	{
+		size_t slot = spreadHash(m_hashes[i], slots.size());
+		while (slots[slot] != 0)
+			slot = (slot + 1) & mask;
+		slots[slot] = i + 1;
+	}
+	m_slots.swap(slots);
+}
+
+void
+MonitorPolicyCache::StringTable::clear(void)
+{
+	m_strings.clear();
+	m_hashes.clear();
+	m_slots.assign(INITIAL_SLOT_COUNT, 0);
+}
+
+MonitorPolicyCache::MonitorPolicyCache(void)
+	: m_entryCount(0)
+	, m_bComplete(false)
+	, m_pSliceUses(new SliceUses())
+	, m_sliceKeys(MAX_SLICE_COUNT, 0)
+	, m_sliceCount(0)
+{
+	Entry emptyEntry = { 0, 0 };
+	m_entries.assign(INITIAL_SLOT_COUNT, emptyEntry);
+
+	m_pSliceUses->tick = 0;
+	for (int i = 0; i < MAX_SLICE_COUNT; ++i)
+		m_pSliceUses->lastUse[i] = 0;
+}
+
+unsigned long long
+MonitorPolicyCache::makeKey(const int userId, const unsigned int packageIndex, const unsigned int privacyIndex)
+{
+	return ((unsigned long long)(unsigned int)userId << 32) | ((unsigned long long)packageIndex << PRIVACY_INDEX_BITS) | privacyIndex;
+}
+
+size_t
+MonitorPolicyCache::findSlot(const unsigned long long key) const
+{
+	size_t mask = m_entries.size() - 1;
+	size_t slot = spreadHash(key, m_entries.size());
+	while (m_entries[slot].key != 0 && m_entries[slot].key != key)
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+void
+MonitorPolicyCache::grow(void)
+{
+	std::vector < Entry > entries;
+	entries.swap(m_entries);
+	Entry emptyEntry = { 0, 0 };
+	m_entries.assign(entries.size() * 2, emptyEntry);
+
+	for (std::vector < Entry >::const_iterator iter = entries.begin(); iter != entries.end(); ++iter)
+	{
+		if (iter->key != 0)
+			m_entries[findSlot(iter->key)] = *iter;
+	}
+}
+
+bool
+MonitorPolicyCache::set(const std::string& userPkgIdPrivacyId, const int monitorPolicy)
+{
+	// a package id has no '|', a privacy id neither
+	size_t packageIdStart = userPkgIdPrivacyId.find('|');
+	size_t privacyIdStart = userPkgIdPrivacyId.rfind('|');
+	TryReturn(packageIdStart != std::string::npos && packageIdStart != privacyIdStart, false, , "Invalid monitor policy key : %s", userPkgIdPrivacyId.c_str());
+
+	int userId = atoi(userPkgIdPrivacyId.substr(0, packageIdStart).c_str());
+	std::string packageId = userPkgIdPrivacyId.substr(packageIdStart + 1, privacyIdStart - packageIdStart - 1);
+	std::string privacyId = userPkgIdPrivacyId.substr(privacyIdStart + 1);
+
+	return set(userId, packageId, privacyId, monitorPolicy);
+}
+
+bool
+MonitorPolicyCache::set(const int userId, const std::string& packageId, const std::string& privacyId, const int monitorPolicy)
+{
+	unsigned int packageIndex = m_packageIds.find(packageId);
+	unsigned int privacyIndex = m_privacyIds.find(privacyId);
+	if (packageIndex == 0)
+	{
+		TryReturn(m_packageIds.size() < MAX_PACKAGE_INDEX, false, , "Too many packages : %d", (int)m_packageIds.size());
+		packageIndex = m_packageIds.intern(packageId);
+	}
+	if (privacyIndex == 0)
+	{
+		// the privacy ids are a short fixed list, more means the keys are broken
+		TryReturn(m_privacyIds.size() < MAX_PRIVACY_INDEX, false, , "Too many privacy ids : %s", privacyId.c_str());
+		privacyIndex = m_privacyIds.intern(privacyId);
+	}
+
+	insert(makeKey(userId, packageIndex, privacyIndex), monitorPolicy);
+
+	return true;
+}
+
+void
+MonitorPolicyCache::insert(const unsigned long long key, const int monitorPolicy)
+{
+	size_t slot = findSlot(key);
+	if (m_entries[slot].key == 0)
+	{
+		if ((m_entryCount + 1) * 2 > m_entries.size())
+		{
+			grow();
+			slot = findSlot(key);
+		}
+		m_entries[slot].key = key;
+		m_entryCount++;
+	}
+	m_entries[slot].monitorPolicy = monitorPolicy;
+}
+
+bool
+MonitorPolicyCache::find(const int userId, const std::string& packageId, const std::string& privacyId, int& monitorPolicy, bool& bKnown) const
+{
+	bKnown = m_bComplete;
+
+	unsigned int packageIndex = m_packageIds.find(packageId);
+	if (packageIndex == 0)
+		return false;
+
+	if (m_bComplete == false)
+	{
+		const Entry& marker = m_entries[findSlot(makeKey(userId, packageIndex, 0))];
+		if (marker.key == 0)
+			return false;
+		bKnown = true;
+
+		// written only when the tick moved, a slice in use costs its readers no store
+		unsigned int tick = m_pSliceUses->tick.load(std::memory_order_relaxed);
+		std::atomic < unsigned int >& lastUse = m_pSliceUses->lastUse[marker.monitorPolicy];
+		if (lastUse.load(std::memory_order_relaxed) != tick)
+			lastUse.store(tick, std::memory_order_relaxed);
+	}
+
+	unsigned int privacyIndex = m_privacyIds.find(privacyId);
+	if (privacyIndex == 0)
+		return false;
+
+	const Entry& entry = m_entries[findSlot(makeKey(userId, packageIndex, privacyIndex))];
+	if (entry.key == 0)
+		return false;
+
+	monitorPolicy = entry.monitorPolicy;
+	return true;
+}
+
+void
+MonitorPolicyCache::erase(const int userId, const std::string& packageId)
+{
+	unsigned int packageIndex = m_packageIds.find(packageId);
+	if (packageIndex == 0)
+		return;
+
+	// a loaded slice stays loaded, without policy
+	remove(userId, packageIndex, false);
+}
+
+void
+MonitorPolicyCache::remove(const int userId, const unsigned int packageIndex, const bool bWithSlices)
+{
+	// linear probing can't leave holes in a chain, the other entries are put back
+	std::vector < Entry > entries;
+	entries.swap(m_entries);
+	Entry emptyEntry = { 0, 0 };
+	m_entries.assign(entries.size(), emptyEntry);
+	m_entryCount = 0;
+
+	for (std::vector < Entry >::const_iterator iter = entries.begin(); iter != entries.end(); ++iter)
+	{
+		if (iter->key == 0)
+			continue;
+		if (((unsigned int)(iter->key >> PRIVACY_INDEX_BITS) & MAX_PACKAGE_INDEX) == packageIndex
+				&& (userId == -1 || (int)(iter->key >> 32) == userId)
+				&& (bWithSlices == true || (iter->key & MAX_PRIVACY_INDEX) != 0))
+			continue;
+		m_entries[findSlot(iter->key)] = *iter;
+		m_entryCount++;
+	}
+}
+
+void
+MonitorPolicyCache::clear(void)
+{
+	m_packageIds.clear();
+	m_privacyIds.clear();
+	Entry emptyEntry = { 0, 0 };
+	m_entries.assign(INITIAL_SLOT_COUNT, emptyEntry);
+	m_entryCount = 0;
+	m_bComplete = false;
+	m_sliceKeys.assign(MAX_SLICE_COUNT, 0);
+	m_sliceCount = 0;
+}
+
+bool
+MonitorPolicyCache::isSliceLoaded(const int userId, const std::string& packageId) const
+{
+	unsigned int packageIndex = m_packageIds.find(packageId);
+	if (packageIndex == 0)
+		return false;
+
+	return m_entries[findSlot(makeKey(userId, packageIndex, 0))].key != 0;
+}
+
+bool
+MonitorPolicyCache::setSlice(const int userId, const std::string& packageId, const std::list < std::pair < std::string, int > >& policyList)
+{
+	unsigned int packageIndex = m_packageIds.find(packageId);
+	if (packageIndex == 0)
+	{
+		TryReturn(m_packageIds.size() < MAX_PACKAGE_INDEX, false, , "Too many packages : %d", (int)m_packageIds.size());
+		packageIndex = m_packageIds.intern(packageId);
+	}
+
+	unsigned long long sliceKey = makeKey(userId, packageIndex, 0);
+	size_t slot = findSlot(sliceKey);
+	int useIndex = 0;
+	if (m_entries[slot].key != 0)
+	{
+		// loaded again, the policies of the server replace those in the cache
+		useIndex = m_entries[slot].monitorPolicy;
+		remove(userId, packageIndex, false);
+	}
+	else
+	{
+		if (m_sliceCount == MAX_SLICE_COUNT)
+			evictSlice();
+		while (m_sliceKeys[useIndex] != 0)
+			useIndex++;
+		m_sliceKeys[useIndex] = sliceKey;
+		m_sliceCount++;
+		insert(sliceKey, useIndex);
+	}
+	m_pSliceUses->lastUse[useIndex] = ++m_pSliceUses->tick;
+
+	for (std::list < std::pair < std::string, int > >::const_iterator iter = policyList.begin(); iter != policyList.end(); ++iter)
+		set(userId, packageId, iter->first, iter->second);
+
+	return true;
+}
+
+void
+MonitorPolicyCache::evictSlice(void)
+{
+	// the slice used longest ago, a reader may still mark it meanwhile
+	int victimIndex = 0;
+	unsigned int tick = m_pSliceUses->tick.load();
+	for (int i = 1; i < MAX_SLICE_COUNT; ++i)
+	{
+		if (tick - m_pSliceUses->lastUse[i].load() > tick - m_pSliceUses->lastUse[victimIndex].load())
+			victimIndex = i;
+	}
+
+	unsigned long long sliceKey = m_sliceKeys[victimIndex];
+	PF_LOGD("Monitor policy slice evicted : %d|%s", (int)(sliceKey >> 32), m_packageIds.get((unsigned int)(sliceKey >> PRIVACY_INDEX_BITS) & MAX_PACKAGE_INDEX).c_str());
+	remove((int)(sliceKey >> 32), (unsigned int)(sliceKey >> PRIVACY_INDEX_BITS) & MAX_PACKAGE_INDEX, true);
+	m_sliceKeys[victimIndex] = 0;
+	m_sliceCount--;
+}
+
+void
+MonitorPolicyCache::print(void) const
+{
+	for (std::vector < Entry >::const_iterator iter = m_entries.begin(); iter != m_entries.end(); ++iter)
+	{
+		if (iter->key == 0 || (iter->key & MAX_PRIVACY_INDEX) == 0)
+			continue;
+		// the indexes are taken in the log, it is compiled out with everything it uses
+		PF_LOGD("PRIVACY string : %d|%s|%s", (int)(iter->key >> 32),
+			m_packageIds.get((unsigned int)(iter->key >> PRIVACY_INDEX_BITS) & MAX_PACKAGE_INDEX).c_str(),
+			m_privacyIds.get((unsigned int)iter->key & MAX_PRIVACY_INDEX).c_str());
+		PF_LOGD("PRIVACY monitor_policy : %d", iter->monitorPolicy);
+	}
+}
@@ -29,9 +29,7 @@
 
 bool PrivacyChecker::m_isInitialized = false;
 bool PrivacyChecker::m_isMonitorEnable = false;
-std::map < std::string, bool >PrivacyChecker::m_privacyCache;
-std::map < std::string, std::map < std::string, bool > > PrivacyChecker::m_privacyInfoCache;
-std::map < std::string, int > PrivacyChecker::m_monitorPolicyCache;
+SnapshotPointer < PrivacyChecker::CacheSnapshot > PrivacyChecker::m_cacheSnapshot(new PrivacyChecker::CacheSnapshot());
 std::mutex PrivacyChecker::m_cacheMutex;
 std::mutex PrivacyChecker::m_dbusMutex;
 std::mutex PrivacyChecker::m_initializeMutex;
@@ -49,12 +47,22 @@ PrivacyChecker::initialize(void)
 		return PRIV_FLTR_ERROR_SUCCESS;
 	}
 
-	std::lock_guard < std::mutex > guard(m_cacheMutex);
+	{
+		std::lock_guard < std::mutex > guard(m_cacheMutex);
 
-	int res = initMonitorPolicyCache();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, ,"Failed to update cache (%d)", res);
+		// the monitor policies are loaded by (user, package) as they are checked
+		if (!m_cacheSnapshot.get()->pMonitorPolicyCache)
+		{
+			CacheSnapshot* pSnapshot = new CacheSnapshot(*m_cacheSnapshot.get());
+			pSnapshot->pMonitorPolicyCache.reset(new MonitorPolicyCache());
+			m_cacheSnapshot.publish(pSnapshot);
+		}
+	}
 
-	res = initializeGMain();
+	// unless the file of the server has them all
+	openMonitorPolicySnapshot(NULL);
+
+	int res = initializeGMain();
 	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, ,"Failed to initialize() (%d)", res);
 
 	return PRIV_FLTR_ERROR_SUCCESS;
@@ -85,10 +93,9 @@ PrivacyChecker::initializeGMain(void)
 void
 PrivacyChecker::printMonitorPolicyCache(void)
 {
-	for(std::map<std::string, int>::iterator itr = m_monitorPolicyCache.begin(); itr != m_monitorPolicyCache.end(); itr++) {		
-		PF_LOGD("PRIVACY string : %s", itr->first.c_str());
-		PF_LOGD("PRIVACY monitor_policy : %d", itr->second);
-	}
+	SnapshotPointer < CacheSnapshot >::ReadGuard snapshot(m_cacheSnapshot);
+	if (snapshot->pMonitorPolicyCache)
+		snapshot->pMonitorPolicyCache->print();
 }
 
 int
@@ -96,16 +103,100 @@ PrivacyChecker::initMonitorPolicyCache(void)
 {
 	PF_LOGD("PrivacyChecker::initCache");
 
-	std::list < std::pair < std::string, int > > monitorPolicyList;
-	int retval = PrivacyGuardClient::getInstance()->PgGetAllMonitorPolicy(monitorPolicyList);
-	if(retval == PRIV_FLTR_ERROR_SUCCESS && !monitorPolicyList.empty()) {
-		m_monitorPolicyCache.insert(monitorPolicyList.begin(), monitorPolicyList.end());
+	// the policies go into the cache as they are received, the whole list is never held
+	std::shared_ptr < MonitorPolicyCache > pMonitorPolicyCache(new MonitorPolicyCache());
+	ListReceiver < std::pair < std::string, int > > receiver = [&pMonitorPolicyCache](std::pair < std::string, int >& monitorPolicy) {
+		pMonitorPolicyCache->set(monitorPolicy.first, monitorPolicy.second);
+		return true;
+	};
+	int retval = PrivacyGuardClient::getInstance()->PgGetAllMonitorPolicy(receiver);
+	// no policy at all is a complete list too
+	TryReturn(retval == PRIV_FLTR_ERROR_SUCCESS || retval == PRIV_FLTR_ERROR_NO_DATA, retval, , "PgGetAllMonitorPolicy : %d", retval);
+	pMonitorPolicyCache->setComplete();
+
+	// the caller holds m_cacheMutex
+	CacheSnapshot* pSnapshot = new CacheSnapshot(*m_cacheSnapshot.get());
+	pSnapshot->pMonitorPolicyCache = pMonitorPolicyCache;
+	m_cacheSnapshot.publish(pSnapshot);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+void
+PrivacyChecker::openMonitorPolicySnapshot(const MonitorPolicySnapshot* pReplaced)
+{
+	std::lock_guard < std::mutex > guard(m_cacheMutex);
+
+	// another thread may have mapped the new file while this one waited
+	const MonitorPolicySnapshot* pCurrent = m_cacheSnapshot.get()->pMonitorPolicySnapshot.get();
+	if (pCurrent != pReplaced)
+		return;
+
+	std::shared_ptr < MonitorPolicySnapshot > pMonitorPolicySnapshot(new MonitorPolicySnapshot());
+	int res = pMonitorPolicySnapshot->open(MONITOR_POLICY_SNAPSHOT_PATH);
+	if (res != PRIV_FLTR_ERROR_SUCCESS) {
+		// the policies are then asked to the server
+		PF_LOGD("no monitor policy snapshot : %d", res);
+		if (pCurrent == NULL)
+			return;
+		pMonitorPolicySnapshot.reset();
 	}
-	return retval;
+	else {
+		PF_LOGD("monitor policy snapshot %u : %u policies", pMonitorPolicySnapshot->getGeneration(), pMonitorPolicySnapshot->size());
+	}
+
+	// the old file is unmapped once no reader holds it
+	CacheSnapshot* pSnapshot = new CacheSnapshot(*m_cacheSnapshot.get());
+	pSnapshot->pMonitorPolicySnapshot = pMonitorPolicySnapshot;
+	m_cacheSnapshot.publish(pSnapshot);
 }
 
 int
-PrivacyChecker::getMonitorPolicy(const int userId, const std::string packageId, const std::string privacyId, int &monitorPolicy)
+PrivacyChecker::prefetchMonitorPolicyCache(void)
+{
+	int res = initialize();
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "initialize : %d", res);
+
+	std::lock_guard < std::mutex > guard(m_cacheMutex);
+
+	// the file of the server holds them all already
+	if (m_cacheSnapshot.get()->pMonitorPolicySnapshot || m_cacheSnapshot.get()->pMonitorPolicyCache->isComplete() == true)
+		return PRIV_FLTR_ERROR_SUCCESS;
+
+	return initMonitorPolicyCache();
+}
+
+int
+PrivacyChecker::loadMonitorPolicySlice(const int userId, const std::string& packageId)
+{
+	// the deltas of the D-Bus thread wait meanwhile, none is lost before the slice is in
+	std::lock_guard < std::mutex > guard(m_cacheMutex);
+
+	// another thread may have loaded it while this one waited
+	const MonitorPolicyCache& monitorPolicyCache = *m_cacheSnapshot.get()->pMonitorPolicyCache;
+	if (monitorPolicyCache.isComplete() == true || monitorPolicyCache.isSliceLoaded(userId, packageId) == true)
+		return PRIV_FLTR_ERROR_SUCCESS;
+
+	std::list < std::pair < std::string, int > > policyList;
+	ListReceiver < std::pair < std::string, int > > receiver = [&policyList](std::pair < std::string, int >& monitorPolicy) {
+		policyList.push_back(monitorPolicy);
+		return true;
+	};
+	int res = PrivacyGuardClient::getInstance()->PgForeachMonitorPolicyByPackageId(userId, packageId, receiver);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "PgForeachMonitorPolicyByPackageId : %d", res);
+
+	std::shared_ptr < MonitorPolicyCache > pMonitorPolicyCache(new MonitorPolicyCache(monitorPolicyCache));
+	pMonitorPolicyCache->setSlice(userId, packageId, policyList);
+
+	CacheSnapshot* pSnapshot = new CacheSnapshot(*m_cacheSnapshot.get());
+	pSnapshot->pMonitorPolicyCache = pMonitorPolicyCache;
+	m_cacheSnapshot.publish(pSnapshot);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyChecker::getMonitorPolicy(const int userId, const std::string& packageId, const std::string& privacyId, int &monitorPolicy)
 {
 	PF_LOGD("getMonitorPolicy m_isInitialized : %d", m_isInitialized);
 
@@ -114,19 +205,46 @@ PrivacyChecker::getMonitorPolicy(const int userId, const std::string packageId,
 	}
 //	printMonitorPolicyCache();
 
-	std::string userPkgIdPrivacyId = std::to_string(userId) + std::string("|") + packageId + std::string("|") + privacyId;
-	PF_LOGD("key : %s", userPkgIdPrivacyId.c_str());
-	std::map<std::string, int>::iterator itr = m_monitorPolicyCache.find(userPkgIdPrivacyId);
-	int res = PRIV_FLTR_ERROR_SUCCESS;
-	if(itr != m_monitorPolicyCache.end()) {
-		monitorPolicy = itr->second;
+	// no key string is built, the cache finds the policy by the ids themselves
+	PF_LOGD("key : %d|%s|%s", userId, packageId.c_str(), privacyId.c_str());
+	const MonitorPolicySnapshot* pReplaced = NULL;
+	{
+		SnapshotPointer < CacheSnapshot >::ReadGuard snapshot(m_cacheSnapshot);
+		const MonitorPolicySnapshot* pMonitorPolicySnapshot = snapshot->pMonitorPolicySnapshot.get();
+		if (pMonitorPolicySnapshot != NULL) {
+			// the file holds all the policies, one not in it doesn't exist
+			if (pMonitorPolicySnapshot->isReplaced() == false) {
+				if (pMonitorPolicySnapshot->find(userId, packageId, privacyId, monitorPolicy) == true)
+					return PRIV_FLTR_ERROR_SUCCESS;
+				monitorPolicy = 0;
+				return PRIV_FLTR_ERROR_NO_DATA;
+			}
+			pReplaced = pMonitorPolicySnapshot;
+		}
 	}
-	else {
-		monitorPolicy = 0;
-		res = PRIV_FLTR_ERROR_NO_DATA;
+	if (pReplaced != NULL) {
+		openMonitorPolicySnapshot(pReplaced);
+		return getMonitorPolicy(userId, packageId, privacyId, monitorPolicy);
 	}
-	PF_LOGD("Here3");
-	return res;
+
+	bool bKnown = false;
+	{
+		SnapshotPointer < CacheSnapshot >::ReadGuard snapshot(m_cacheSnapshot);
+		if (snapshot->pMonitorPolicyCache && snapshot->pMonitorPolicyCache->find(userId, packageId, privacyId, monitorPolicy, bKnown) == true)
+			return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	if (bKnown == false) {
+		int res = loadMonitorPolicySlice(userId, packageId);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, monitorPolicy = 0, "loadMonitorPolicySlice : %d", res);
+
+		SnapshotPointer < CacheSnapshot >::ReadGuard snapshot(m_cacheSnapshot);
+		if (snapshot->pMonitorPolicyCache->find(userId, packageId, privacyId, monitorPolicy, bKnown) == true)
+			return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	monitorPolicy = 0;
+	return PRIV_FLTR_ERROR_NO_DATA;
 }
 
 void
@@ -236,19 +354,24 @@ PrivacyChecker::handleNotification(DBusConnection* connection, DBusMessage* mess
 
 		std::lock_guard < std::mutex > guard(m_cacheMutex);
 
+		// the readers keep the version they have, the next ones see the updated copy
+		std::unique_ptr < CacheSnapshot > pSnapshot(new CacheSnapshot(*m_cacheSnapshot.get()));
 		if (std::string(pPkgId) == m_pkgId)
 		{
 			LOGI("Current app pkg privacy information updated");
-			updateCache(m_pkgId, pPrivacyId, m_privacyCache);
+			updateCache(m_pkgId, pPrivacyId, pSnapshot->privacyCache);
 			//printCache();
 		}
 
-		std::map < std::string, std::map < std::string, bool > > :: iterator iter = m_privacyInfoCache.find(std::string(pPkgId));
-		if (iter != m_privacyInfoCache.end())
+		std::map < std::string, std::shared_ptr < const std::map < std::string, bool > > > :: iterator iter = pSnapshot->privacyInfoCache.find(std::string(pPkgId));
+		if (iter != pSnapshot->privacyInfoCache.end())
 		{
 			LOGI("Current pkg privacy is in cache");
-			updateCache(std::string(pPkgId), pPrivacyId, iter->second);
+			std::shared_ptr < std::map < std::string, bool > > pPkgCacheMap(new std::map < std::string, bool > (*iter->second));
+			updateCache(std::string(pPkgId), pPrivacyId, *pPkgCacheMap);
+			iter->second = pPkgCacheMap;
 		}
+		m_cacheSnapshot.publish(pSnapshot.release());
 
 	}
 	else if (dbus_message_is_signal(message, DBUS_SIGNAL_INTERFACE.c_str(), DBUS_SIGNAL_PKG_REMOVED.c_str()))
@@ -260,10 +383,70 @@ PrivacyChecker::handleNotification(DBusConnection* connection, DBusMessage* mess
 
 		std::lock_guard < std::mutex > guard(m_cacheMutex);
 
-		std::map < std::string, std::map < std::string, bool > > :: iterator iter = m_privacyInfoCache.find(std::string(pPkgId));
-		if (iter != m_privacyInfoCache.end())
+		if (m_cacheSnapshot.get()->privacyInfoCache.count(std::string(pPkgId)) > 0)
 		{
-			m_privacyInfoCache.erase(iter);
+			CacheSnapshot* pSnapshot = new CacheSnapshot(*m_cacheSnapshot.get());
+			pSnapshot->privacyInfoCache.erase(std::string(pPkgId));
+			m_cacheSnapshot.publish(pSnapshot);
+		}
+	}
+
+	else if (dbus_message_is_signal(message, DBUS_SIGNAL_INTERFACE.c_str(), DBUS_SIGNAL_MONITOR_POLICY_CHANGED.c_str()))
+	{
+		dbus_int32_t userId = 0;
+		dbus_int32_t monitorPolicy = 0;
+		r = dbus_message_get_args(message, &error,
+			DBUS_TYPE_INT32, &userId,
+			DBUS_TYPE_STRING, &pPkgId,
+			DBUS_TYPE_STRING, &pPrivacyId,
+			DBUS_TYPE_INT32, &monitorPolicy,
+			DBUS_TYPE_INVALID);
+		TryReturn(r, DBUS_HANDLER_RESULT_NOT_YET_HANDLED, , "Fail to get data : %s", error.message);
+
+		std::lock_guard < std::mutex > guard(m_cacheMutex);
+
+		// policies not loaded yet are read with the change in them
+		const std::shared_ptr < const MonitorPolicyCache >& pCurrentCache = m_cacheSnapshot.get()->pMonitorPolicyCache;
+		if (pCurrentCache && (pCurrentCache->isComplete() == true || pCurrentCache->isSliceLoaded(userId, std::string(pPkgId)) == true))
+		{
+			std::shared_ptr < MonitorPolicyCache > pMonitorPolicyCache(new MonitorPolicyCache(*m_cacheSnapshot.get()->pMonitorPolicyCache));
+			pMonitorPolicyCache->set(userId, std::string(pPkgId), std::string(pPrivacyId), monitorPolicy);
+
+			CacheSnapshot* pSnapshot = new CacheSnapshot(*m_cacheSnapshot.get());
+			pSnapshot->pMonitorPolicyCache = pMonitorPolicyCache;
+			m_cacheSnapshot.publish(pSnapshot);
+		}
+	}
+	else if (dbus_message_is_signal(message, DBUS_SIGNAL_INTERFACE.c_str(), DBUS_SIGNAL_MONITOR_POLICY_REMOVED.c_str()))
+	{
+		dbus_int32_t userId = 0;
+		r = dbus_message_get_args(message, &error,
+			DBUS_TYPE_INT32, &userId,
+			DBUS_TYPE_STRING, &pPkgId,
+			DBUS_TYPE_INVALID);
+		TryReturn(r, DBUS_HANDLER_RESULT_NOT_YET_HANDLED, , "Fail to get data : %s", error.message);
+
+		std::lock_guard < std::mutex > guard(m_cacheMutex);
+
+		if (m_cacheSnapshot.get()->pMonitorPolicyCache)
+		{
+			std::shared_ptr < MonitorPolicyCache > pMonitorPolicyCache;
+			// an empty package id removes the policies of all the packages
+			if (pPkgId[0] == '\0')
+			{
+				pMonitorPolicyCache.reset(new MonitorPolicyCache());
+				if (m_cacheSnapshot.get()->pMonitorPolicyCache->isComplete() == true)
+					pMonitorPolicyCache->setComplete();
+			}
+			else
+			{
+				pMonitorPolicyCache.reset(new MonitorPolicyCache(*m_cacheSnapshot.get()->pMonitorPolicyCache));
+				pMonitorPolicyCache->erase(userId, std::string(pPkgId));
+			}
+
+			CacheSnapshot* pSnapshot = new CacheSnapshot(*m_cacheSnapshot.get());
+			pSnapshot->pMonitorPolicyCache = pMonitorPolicyCache;
+			m_cacheSnapshot.publish(pSnapshot);
 		}
 	}
 
@@ -272,11 +455,11 @@ PrivacyChecker::handleNotification(DBusConnection* connection, DBusMessage* mess
 }
 
 int
-PrivacyChecker::check(const std::string privacyId, std::map < std::string, bool >& privacyMap)
+PrivacyChecker::check(const std::string privacyId, const std::map < std::string, bool >& privacyMap)
 {
 	TryReturn(m_isInitialized, PRIV_FLTR_ERROR_NOT_INITIALIZED, , "Not initialized");
 
-	std::map < std::string, bool >::iterator iter;
+	std::map < std::string, bool >::const_iterator iter;
 
 	iter = privacyMap.find(privacyId);
 	if (iter == privacyMap.end() )
@@ -299,9 +482,9 @@ PrivacyChecker::check(const std::string privacyId)
 	if (!m_isInitialized)
 		return PRIV_FLTR_ERROR_NOT_INITIALIZED;
 
-	std::lock_guard < std::mutex > guard(m_cacheMutex);
+	SnapshotPointer < CacheSnapshot >::ReadGuard snapshot(m_cacheSnapshot);
 
-	int res = check(privacyId, m_privacyCache);
+	int res = check(privacyId, snapshot->privacyCache);
 
 	return res;
 }
@@ -312,26 +495,45 @@ PrivacyChecker::check(const std::string pkgId, const std::string privacyId)
 	if (!m_isInitialized)
 		initialize();
 
-	std::lock_guard < std::mutex > guard(m_cacheMutex);
 	int res;
+	std::map < std::string, std::shared_ptr < const std::map < std::string, bool > > >::const_iterator iter;
+
+	{
+		SnapshotPointer < CacheSnapshot >::ReadGuard snapshot(m_cacheSnapshot);
+		iter = snapshot->privacyInfoCache.find(pkgId);
+		if (iter != snapshot->privacyInfoCache.end())
+		{
+			if (iter->second->size() == 0)
+			{
+				return PRIV_FLTR_ERROR_USER_NOT_CONSENTED;
+			}
+			return check(privacyId, *iter->second);
+		}
+	}
+
+	// a package not in the cache yet is read once, by the thread that gets the lock first
+	std::lock_guard < std::mutex > guard(m_cacheMutex);
 
-	std::map < std::string, std::map < std::string, bool > >::iterator iter = m_privacyInfoCache.find(pkgId);
-	if (iter == m_privacyInfoCache.end() )
+	iter = m_cacheSnapshot.get()->privacyInfoCache.find(pkgId);
+	if (iter == m_cacheSnapshot.get()->privacyInfoCache.end() )
 	{
-		std::map < std::string, bool > pkgCacheMap;
-		res = updateCache(pkgId, pkgCacheMap);
+		std::shared_ptr < std::map < std::string, bool > > pPkgCacheMap(new std::map < std::string, bool > ());
+		res = updateCache(pkgId, *pPkgCacheMap);
 		TryReturn( res == PRIV_FLTR_ERROR_SUCCESS, PRIV_FLTR_ERROR_DB_ERROR, , "Failed to update cache : %d", res);
 
-		m_privacyInfoCache.insert( std::map < std::string, std::map < std::string, bool > >::value_type(std::string(pkgId), pkgCacheMap));
-		iter = m_privacyInfoCache.find(pkgId);
+		CacheSnapshot* pSnapshot = new CacheSnapshot(*m_cacheSnapshot.get());
+		pSnapshot->privacyInfoCache.insert(std::make_pair(pkgId, pPkgCacheMap));
+		m_cacheSnapshot.publish(pSnapshot);
+		iter = m_cacheSnapshot.get()->privacyInfoCache.find(pkgId);
 	}
 
-	if (iter->second.size() == 0)
+	// the snapshot of this thread can't be replaced while it holds m_cacheMutex
+	if (iter->second->size() == 0)
 	{
 		return PRIV_FLTR_ERROR_USER_NOT_CONSENTED;
 	}
 
-	res = check(privacyId, iter->second);
+	res = check(privacyId, *iter->second);
 
 	return res;
 }
@@ -368,8 +570,10 @@ int
 PrivacyChecker::finalize(void)
 {
 	std::lock_guard <std::mutex> guard (m_cacheMutex);
-	m_privacyCache.clear();
-	m_privacyInfoCache.clear();
+	CacheSnapshot* pSnapshot = new CacheSnapshot();
+	pSnapshot->pMonitorPolicyCache = m_cacheSnapshot.get()->pMonitorPolicyCache;
+	pSnapshot->pMonitorPolicySnapshot = m_cacheSnapshot.get()->pMonitorPolicySnapshot;
+	m_cacheSnapshot.publish(pSnapshot);
 
 	if (m_pLoop != NULL)
 	{
@@ -391,8 +595,9 @@ PrivacyChecker::finalize(void)
 void
 PrivacyChecker::printCache(void)
 {
-	std::map < std::string, bool >::const_iterator iter = m_privacyCache.begin();
-	for (; iter != m_privacyCache.end(); ++iter)
+	SnapshotPointer < CacheSnapshot >::ReadGuard snapshot(m_cacheSnapshot);
+	std::map < std::string, bool >::const_iterator iter = snapshot->privacyCache.begin();
+	for (; iter != snapshot->privacyCache.end(); ++iter)
 	{
 		LOGD(" %s : %d", iter->first.c_str(), iter->second);
 	}
@@ -16,23 +16,37 @@
 
 #include <algorithm>
 #include <memory>
+#include <pthread.h>
+#include <unistd.h>
 #include "Utils.h"
 #include "PrivacyGuardClient.h"
 #include "SocketClient.h"
 #include "PrivacyIdInfo.h"
 
-#define COUNT 10
-
 #undef __READ_DB_IPC__
 
 std::mutex PrivacyGuardClient::m_singletonMutex;
 PrivacyGuardClient* PrivacyGuardClient::m_pInstance = NULL;
 const std::string PrivacyGuardClient::INTERFACE_NAME("PrivacyInfoService");
+// the logs are sent once this many are waiting, or FLUSH_DELAY_MS after the first of them
+const int PrivacyGuardClient::FLUSH_COUNT = 64;
+const int PrivacyGuardClient::FLUSH_DELAY_MS = 500;
 
 PrivacyGuardClient::PrivacyGuardClient(void)
+	: m_pPendingLogs(NULL)
+	, m_pendingLogCount(0)
+	, m_flushThread(-1)
+	, m_bFlushThreadStarted(false)
+	, m_bFlushStopRequested(false)
+#ifdef USE_ACCESS_LOG_RING
+	, m_bAccessLogRingFailed(false)
+	, m_ringUserId(-1)
+#endif
 {
 	std::unique_ptr<SocketClient> pSocketClient(new SocketClient(INTERFACE_NAME));
 	m_pSocketClient = std::move(pSocketClient);
+	// the logs still waiting are sent before the process ends
+	atexit(flushAtExit);
 }
 
 PrivacyGuardClient*
@@ -40,70 +54,305 @@ PrivacyGuardClient::getInstance(void)
 {
 	std::lock_guard<std::mutex> guard(m_singletonMutex);
 	if (m_pInstance == NULL)
+	{
 		m_pInstance = new PrivacyGuardClient();
+		// a forked child has no flush thread and must not send the logs or use the ring of its parent,
+		// the handlers are registered once there is an instance for them to use
+		pthread_atfork(prepareFork, resumeParent, resumeChild);
+	}
 	return m_pInstance;
 }
 
-int
-PrivacyGuardClient::PgAddPrivacyAccessLog(const int userId, const std::string packageId, const std::string privacyId)
+void
+PrivacyGuardClient::prepareFork(void)
+{
+	if (m_pInstance == NULL)
+		return;
+	m_pInstance->m_flushCallMutex.lock();
+	m_pInstance->m_flushMutex.lock();
+#ifdef USE_ACCESS_LOG_RING
+	m_pInstance->m_ringMutex.lock();
+#endif
+	// the last one, a flush or a ring registration takes the others before it calls
+	m_pInstance->m_pSocketClient->prepareFork();
+}
+
+void
+PrivacyGuardClient::resumeParent(void)
+{
+	if (m_pInstance == NULL)
+		return;
+	m_pInstance->m_pSocketClient->resumeParent();
+#ifdef USE_ACCESS_LOG_RING
+	m_pInstance->m_ringMutex.unlock();
+#endif
+	m_pInstance->m_flushMutex.unlock();
+	m_pInstance->m_flushCallMutex.unlock();
+}
+
+void
+PrivacyGuardClient::resumeChild(void)
+{
+	if (m_pInstance == NULL)
+		return;
+	// the parent sends the logs it has, the child starts its own flush thread at its first log
+	PendingLog* pLog = m_pInstance->m_pPendingLogs.exchange(NULL);
+	while (pLog != NULL)
+	{
+		PendingLog* pNext = pLog->pNext;
+		delete pLog;
+		pLog = pNext;
+	}
+	m_pInstance->m_pendingLogCount = 0;
+	m_pInstance->m_bFlushThreadStarted = false;
+	m_pInstance->m_bFlushStopRequested = false;
+	m_pInstance->m_pSocketClient->resetAfterFork();
+#ifdef USE_ACCESS_LOG_RING
+	// the child makes its own ring, the parent's stays open in the parent
+	m_pInstance->m_pAccessLogRing.reset();
+	m_pInstance->m_bAccessLogRingFailed = false;
+	m_pInstance->m_ringMutex.unlock();
+#endif
+	m_pInstance->m_flushMutex.unlock();
+	m_pInstance->m_flushCallMutex.unlock();
+}
+
+#ifdef USE_ACCESS_LOG_RING
+void
+PrivacyGuardClient::openAccessLogRing(void)
 {
+	{
+		std::lock_guard < std::mutex > guard(m_ringMutex);
+		if (m_pAccessLogRing || m_bAccessLogRingFailed == true)
+			return;
+		// a server without rings is not asked again, the logs go over the socket
+		m_bAccessLogRingFailed = true;
+	}
+
+	std::unique_ptr < AccessLogRing > pRing(new AccessLogRing());
+	int res = pRing->create();
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, , , "create : %d", res);
+
+	FileDescriptor memoryFd = { pRing->getMemoryFd() };
+	FileDescriptor eventFd = { pRing->getEventFd() };
+	FileDescriptor hangupFd = { pRing->getHangupFd() };
 	int result = PRIV_FLTR_ERROR_SUCCESS;
-	logInfoList.push_back(std::pair <std::string, std::string> (packageId, privacyId));
-	PF_LOGD("PrivacyGuardClient userId : %d, PgAddPrivacyAccessLog logInfoList.size() : %d", userId, logInfoList.size());
+	res = m_pSocketClient->call("PgRegisterAccessLogRing", memoryFd, eventFd, hangupFd, &result);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS && result == PRIV_FLTR_ERROR_SUCCESS, , , "PgRegisterAccessLogRing : %d, %d", res, result);
+	pRing->closePassedFds();
+
+	std::lock_guard < std::mutex > guard(m_ringMutex);
+	m_pAccessLogRing = std::move(pRing);
+	m_ringUserId = getuid();
+	m_bAccessLogRingFailed = false;
+	PF_LOGD("Access log ring registered");
+}
+#endif
 
-	if(logInfoList.size() >= COUNT) {
-		int res = m_pSocketClient->connect();
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+void
+PrivacyGuardClient::pushPendingLog(const int userId, const std::string& packageId, const std::string& privacyId)
+{
+	PendingLog* pLog = new PendingLog();
+	pLog->userId = userId;
+	pLog->packageId = packageId;
+	pLog->privacyId = privacyId;
+	pLog->pNext = m_pPendingLogs.load(std::memory_order_relaxed);
+	while (m_pPendingLogs.compare_exchange_weak(pLog->pNext, pLog, std::memory_order_release, std::memory_order_relaxed) == false)
+		;
+
+	int pendingLogCount = ++m_pendingLogCount;
+	// the flush thread waits for the first log and for a full batch, the other logs wake nobody
+	if (pendingLogCount == 1 || pendingLogCount == FLUSH_COUNT)
+	{
+		std::lock_guard < std::mutex > guard(m_flushMutex);
+		m_flushCondition.notify_one();
+	}
+}
 
-		res = m_pSocketClient->call("PgAddPrivacyAccessLog", userId, logInfoList, &result);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+int
+PrivacyGuardClient::flushPendingLogs(void)
+{
+	std::lock_guard < std::mutex > guard(m_flushCallMutex);
+
+	// the list is newest first, reversed into the order of the logs
+	PendingLog* pLog = m_pPendingLogs.exchange(NULL, std::memory_order_acquire);
+	PendingLog* pOrderedLogs = NULL;
+	int logCount = 0;
+	while (pLog != NULL)
+	{
+		PendingLog* pNext = pLog->pNext;
+		pLog->pNext = pOrderedLogs;
+		pOrderedLogs = pLog;
+		pLog = pNext;
+		logCount++;
+	}
+	m_pendingLogCount -= logCount;
 
-		res = m_pSocketClient->disconnect();
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
-		logInfoList.clear();
+	// one call for each run of logs of the same user
+	int result = PRIV_FLTR_ERROR_SUCCESS;
+	while (pOrderedLogs != NULL)
+	{
+		int userId = pOrderedLogs->userId;
+		std::list < std::pair < std::string, std::string > > logInfoList;
+		while (pOrderedLogs != NULL && pOrderedLogs->userId == userId)
+		{
+			logInfoList.push_back(std::pair < std::string, std::string > (pOrderedLogs->packageId, pOrderedLogs->privacyId));
+			PendingLog* pNext = pOrderedLogs->pNext;
+			delete pOrderedLogs;
+			pOrderedLogs = pNext;
+		}
+
+		int callResult = PRIV_FLTR_ERROR_SUCCESS;
+		int res = m_pSocketClient->call("PgAddPrivacyAccessLog", userId, logInfoList, &callResult);
+		if (res != PRIV_FLTR_ERROR_SUCCESS) {
+			PF_LOGE("call : %d, %d logs are lost", res, (int)logInfoList.size());
+			result = res;
+		} else if (callResult != PRIV_FLTR_ERROR_SUCCESS) {
+			result = callResult;
+		}
 	}
 
 	return result;
 }
 
 int
-PrivacyGuardClient::PgAddPrivacyAccessLogTest(const int userId, const std::string packageId, const std::string privacyId)
+PrivacyGuardClient::startFlushThread(void)
 {
-	int result = PRIV_FLTR_ERROR_SUCCESS;
+	std::lock_guard < std::mutex > guard(m_flushMutex);
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	if (m_bFlushThreadStarted == true)
+		return PRIV_FLTR_ERROR_SUCCESS;
 
-	res = m_pSocketClient->call("PgAddPrivacyAccessLogTest", userId, packageId, privacyId, &result);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+	int res = pthread_create(&m_flushThread, NULL, &flushThread, this);
+	TryReturn(res == 0, PRIV_FLTR_ERROR_SYSTEM_ERROR, , "pthread_create : %s", strerror(res));
 
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+	m_bFlushThreadStarted = true;
 
-	return result;
+	return PRIV_FLTR_ERROR_SUCCESS;
 }
 
-int
-PrivacyGuardClient::PgAddPrivacyAccessLogBeforeTerminate(void)
+void
+PrivacyGuardClient::stopFlushThread(void)
 {
-	int result = PRIV_FLTR_ERROR_SUCCESS;
-	PF_LOGD("PgAddPrivacyAccessLogBeforeTerminate, logInfoList.size() : %d", logInfoList.size());
+	{
+		std::lock_guard < std::mutex > guard(m_flushMutex);
+		if (m_bFlushThreadStarted == false)
+			return;
+		m_bFlushStopRequested = true;
+		m_flushCondition.notify_one();
+	}
+
+	// the thread sends what is left before it ends
+	pthread_join(m_flushThread, NULL);
+
+	std::lock_guard < std::mutex > guard(m_flushMutex);
+	m_bFlushThreadStarted = false;
+	m_bFlushStopRequested = false;
+}
+
+void
+PrivacyGuardClient::flushAtExit(void)
+{
+	if (m_pInstance == NULL)
+		return;
+
+	m_pInstance->stopFlushThread();
+	// the logs pushed after the thread ended
+	m_pInstance->flushPendingLogs();
+}
+
+void*
+PrivacyGuardClient::flushThread(void* pData)
+{
+	PrivacyGuardClient &t = *static_cast< PrivacyGuardClient* > (pData);
+	t.flushLoop();
+	return (void*) 0;
+}
+
+void
+PrivacyGuardClient::flushLoop(void)
+{
+	while (1)
+	{
+#ifdef USE_ACCESS_LOG_RING
+		// registered here, no caller waits for it
+		openAccessLogRing();
+#endif
+
+		bool bStopRequested = false;
+		{
+			std::unique_lock < std::mutex > lock(m_flushMutex);
+			m_flushCondition.wait(lock, [this] { return m_bFlushStopRequested == true || m_pendingLogCount.load() > 0; });
+			// the next logs go out with the first one, unless a batch is full before
+			if (m_bFlushStopRequested == false) {
+				m_flushCondition.wait_for(lock, std::chrono::milliseconds(FLUSH_DELAY_MS), [this] {
+						return m_bFlushStopRequested == true || m_pendingLogCount.load() >= FLUSH_COUNT;
+					});
+			}
+			bStopRequested = m_bFlushStopRequested;
+		}
+
+		flushPendingLogs();
+
+		if (bStopRequested == true)
+			break;
+	}
+}
 
-	if(logInfoList.size() > 0) {
-		int res = m_pSocketClient->connect();
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+int
+PrivacyGuardClient::PgAddPrivacyAccessLog(const int userId, const std::string packageId, const std::string privacyId)
+{
+#ifdef USE_ACCESS_LOG_RING
+	// the server reads the ring behind, the process makes no system call for the log.
+	// The ring has one writer, a thread that finds another one writing doesn't wait for it
+	// and queues its log for the flush thread instead
+	std::unique_lock < std::mutex > ringLock(m_ringMutex, std::try_to_lock);
+	if (ringLock.owns_lock() == true) {
+		if (m_pAccessLogRing && userId == m_ringUserId) {
+			if (m_pAccessLogRing->push(userId, packageId, privacyId) == true)
+				return PRIV_FLTR_ERROR_SUCCESS;
+			// a full ring nobody reads belongs to a server that is gone, the flush thread registers a new one
+			if (m_pAccessLogRing->isReaderGone() == true) {
+				PF_LOGE("The server of the access log ring is gone, its unread logs are lost");
+				m_pAccessLogRing.reset();
+			}
+		}
+		ringLock.unlock();
+	}
+#endif
 
-		res = m_pSocketClient->call("PgAddPrivacyAccessLog", logInfoList, &result);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+	// queued without a lock, the flush thread makes the call
+	pushPendingLog(userId, packageId, privacyId);
+	PF_LOGD("PrivacyGuardClient userId : %d, PgAddPrivacyAccessLog pending logs : %d", userId, m_pendingLogCount.load());
 
-		res = m_pSocketClient->disconnect();
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
-		logInfoList.clear();
+	if (m_bFlushThreadStarted == false && startFlushThread() != PRIV_FLTR_ERROR_SUCCESS) {
+		// without the thread the logs are sent by the caller
+		return flushPendingLogs();
 	}
 
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyGuardClient::PgAddPrivacyAccessLogTest(const int userId, const std::string packageId, const std::string privacyId)
+{
+	int result = PRIV_FLTR_ERROR_SUCCESS;
+
+	int res = m_pSocketClient->call("PgAddPrivacyAccessLogTest", userId, packageId, privacyId, &result);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
+
 	return result;
 }
 
+int
+PrivacyGuardClient::PgAddPrivacyAccessLogBeforeTerminate(void)
+{
+	PF_LOGD("PgAddPrivacyAccessLogBeforeTerminate, pending logs : %d", m_pendingLogCount.load());
+
+	// sent now, on the calling thread, the process may end before the flush thread wakes up
+	return flushPendingLogs();
+}
+
 int
 PrivacyGuardClient::PgAddMonitorPolicy(const int userId, const std::string pkgId, const std::list < std::string >& list, int monitorPolicy)
 {
@@ -119,14 +368,8 @@ PrivacyGuardClient::PgAddMonitorPolicy(const int userId, const std::string pkgId
 
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
-
 	res = m_pSocketClient->call("PgAddMonitorPolicy", userId, pkgId, privacyList, monitorPolicy, &result);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
-
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -136,14 +379,8 @@ PrivacyGuardClient::PgDeleteAllLogsAndMonitorPolicy(void)
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
-
-	res = m_pSocketClient->call("PgDeleteAllLogsAndMonitorPolicy", &result);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
-
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+	int res = m_pSocketClient->call("PgDeleteAllLogsAndMonitorPolicy", &result);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -153,14 +390,8 @@ PrivacyGuardClient::PgDeleteLogsByPackageId(const std::string packageId)
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
-
-	res = m_pSocketClient->call("PgDeleteLogsByPackageId", packageId, &result);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
-
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+	int res = m_pSocketClient->call("PgDeleteLogsByPackageId", packageId, &result);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -170,14 +401,8 @@ PrivacyGuardClient::PgDeleteMonitorPolicyByPackageId(const std::string packageId
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
-
-	res = m_pSocketClient->call("PgDeleteMonitorPolicyByPackageId", packageId, &result);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
-
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+	int res = m_pSocketClient->call("PgDeleteMonitorPolicyByPackageId", packageId, &result);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -187,14 +412,19 @@ PrivacyGuardClient::PgForeachTotalPrivacyCountOfPackage(const int userId, const
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgForeachTotalPrivacyCountOfPackage", userId, startDate, endDate, &result, &packageInfoList);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
-	res = m_pSocketClient->call("PgForeachTotalPrivacyCountOfPackage", userId, startDate, endDate, &result, &packageInfoList);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+	return result;
+}
 
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+int
+PrivacyGuardClient::PgForeachTotalPrivacyCountOfPackage(const int userId, const int startDate, const int endDate, ListReceiver < std::pair <std::string, int > > packageInfoReceiver) const
+{
+	int result = PRIV_FLTR_ERROR_SUCCESS;
+
+	int res = m_pSocketClient->call("PgForeachTotalPrivacyCountOfPackage", userId, startDate, endDate, &result, &packageInfoReceiver);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -204,14 +434,19 @@ PrivacyGuardClient::PgForeachTotalPrivacyCountOfPrivacy(const int userId, const
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgForeachTotalPrivacyCountOfPrivacy", userId, startDate, endDate, &result, &privacyInfoList);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
+
+	return result;
+}
 
-	res = m_pSocketClient->call("PgForeachTotalPrivacyCountOfPrivacy", userId, startDate, endDate, &result, &privacyInfoList);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+int
+PrivacyGuardClient::PgForeachTotalPrivacyCountOfPrivacy(const int userId, const int startDate, const int endDate, ListReceiver < std::pair <std::string, int > > privacyInfoReceiver) const
+{
+	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+	int res = m_pSocketClient->call("PgForeachTotalPrivacyCountOfPrivacy", userId, startDate, endDate, &result, &privacyInfoReceiver);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -226,14 +461,24 @@ PrivacyGuardClient::PgForeachPrivacyCountByPrivacyId(const int userId, const int
 	if (!isValid)
 		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgForeachPrivacyCountByPrivacyId", userId, startDate, endDate, privacyId, &result, &packageInfoList);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
+
+	return result;
+}
+
+int
+PrivacyGuardClient::PgForeachPrivacyCountByPrivacyId(const int userId, const int startDate, const int endDate, const std::string privacyId, ListReceiver < std::pair <std::string, int > > packageInfoReceiver) const
+{
+	int result = PRIV_FLTR_ERROR_SUCCESS;
+
+	bool isValid = PrivacyIdInfo::isValidPrivacyId(privacyId);
 
-	res = m_pSocketClient->call("PgForeachPrivacyCountByPrivacyId", userId, startDate, endDate, privacyId, &result, &packageInfoList);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+	if (!isValid)
+		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
 
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+	int res = m_pSocketClient->call("PgForeachPrivacyCountByPrivacyId", userId, startDate, endDate, privacyId, &result, &packageInfoReceiver);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -243,14 +488,19 @@ PrivacyGuardClient::PgForeachPrivacyCountByPackageId(const int userId, const int
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgForeachPrivacyCountByPackageId", userId, startDate, endDate, packageId, &result, &privacyInfoList);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
-	res = m_pSocketClient->call("PgForeachPrivacyCountByPackageId", userId, startDate, endDate, packageId, &result, &privacyInfoList);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+	return result;
+}
+
+int
+PrivacyGuardClient::PgForeachPrivacyCountByPackageId(const int userId, const int startDate, const int endDate, const std::string packageId, ListReceiver < std::pair <std::string, int > > privacyInfoReceiver) const
+{
+	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+	int res = m_pSocketClient->call("PgForeachPrivacyCountByPackageId", userId, startDate, endDate, packageId, &result, &privacyInfoReceiver);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -260,14 +510,19 @@ PrivacyGuardClient::PgForeachPrivacyPackageId(const int userId, std::list < std:
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgForeachPrivacyPackageId", userId, &result, &packageList);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
-	res = m_pSocketClient->call("PgForeachPrivacyPackageId", userId, &result, &packageList);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+	return result;
+}
+
+int
+PrivacyGuardClient::PgForeachPrivacyPackageId(const int userId, ListReceiver < std::string > packageReceiver) const
+{
+	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgForeachPrivacyPackageId", userId, &result, &packageReceiver);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -282,14 +537,24 @@ PrivacyGuardClient::PgForeachPackageByPrivacyId(const int userId, const std::str
 	if (!isValid)
 		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgForeachPackageByPrivacyId", userId, privacyId, &result, &packageList);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
+
+	return result;
+}
 
-	res = m_pSocketClient->call("PgForeachPackageByPrivacyId", userId, privacyId, &result, &packageList);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+int
+PrivacyGuardClient::PgForeachPackageByPrivacyId(const int userId, const std::string privacyId, ListReceiver < std::string > packageReceiver) const
+{
+	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	bool isValid = PrivacyIdInfo::isValidPrivacyId(privacyId);
+
+	if (!isValid)
+		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
+
+	int res = m_pSocketClient->call("PgForeachPackageByPrivacyId", userId, privacyId, &result, &packageReceiver);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -300,18 +565,51 @@ PrivacyGuardClient::PgForeachMonitorPolicyByPackageId(const int userId, const st
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgForeachMonitorPolicyByPackageId", userId, packageId, &result, &privacyInfoList);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
+
+	return result;
+}
 
-	res = m_pSocketClient->call("PgForeachMonitorPolicyByPackageId", userId, packageId, &result, &privacyInfoList);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+int
+PrivacyGuardClient::PgForeachMonitorPolicyByPackageId(const int userId, const std::string packageId,
+		ListReceiver < std::pair <std::string, int > > privacyInfoReceiver) const
+{
+	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+	int res = m_pSocketClient->call("PgForeachMonitorPolicyByPackageId", userId, packageId, &result, &privacyInfoReceiver);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
 
+int
+PrivacyGuardClient::PgForeachMonitorPolicyByPackageIdList(const int userId, const std::list < std::string >& packageList,
+		std::list < std::pair < std::string, std::list <privacy_data_s> > > & monitorPolicyList) const
+{
+	if (packageList.empty())
+		return PRIV_FLTR_ERROR_SUCCESS;
+
+	// one request per package, all of them sent in one batch
+	std::vector < int > resultList(packageList.size(), PRIV_FLTR_ERROR_SUCCESS);
+	SocketClient::Batch batch;
+	int index = 0;
+	for (std::list < std::string >::const_iterator iter = packageList.begin(); iter != packageList.end(); ++iter, ++index) {
+		monitorPolicyList.push_back(std::pair < std::string, std::list <privacy_data_s> > (*iter, std::list <privacy_data_s> ()));
+		batch.add("PgForeachMonitorPolicyByPackageId", userId, *iter, &resultList[index], &monitorPolicyList.back().second);
+	}
+
+	int res = m_pSocketClient->callBatch(batch);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "callBatch : %d", res);
+
+	for (std::vector < int >::const_iterator iter = resultList.begin(); iter != resultList.end(); ++iter) {
+		if (*iter != PRIV_FLTR_ERROR_SUCCESS)
+			return *iter;
+	}
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
 int
 PrivacyGuardClient::PgGetMonitorPolicy(const int userId, const std::string packageId,
 		const std::string privacyId, int &monitorPolicy) const
@@ -323,14 +621,8 @@ PrivacyGuardClient::PgGetMonitorPolicy(const int userId, const std::string packa
 	if (!isValid)
 		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
-
-	res = m_pSocketClient->call("PgGetMonitorPolicy", userId, packageId, privacyId, &result, &monitorPolicy);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
-
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgGetMonitorPolicy", userId, packageId, privacyId, &result, &monitorPolicy);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -340,14 +632,19 @@ PrivacyGuardClient::PgGetAllMonitorPolicy(std::list < std::pair < std::string, i
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgGetAllMonitorPolicy", &result, &monitorPolicyList);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
+
+	return result;
+}
 
-	res = m_pSocketClient->call("PgGetAllMonitorPolicy", &result, &monitorPolicyList);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
+int
+PrivacyGuardClient::PgGetAllMonitorPolicy(ListReceiver < std::pair < std::string, int > > monitorPolicyReceiver) const
+{
+	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgGetAllMonitorPolicy", &result, &monitorPolicyReceiver);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -357,14 +654,8 @@ PrivacyGuardClient::PgCheckPrivacyPackage(const int userId, const std::string pa
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
-
-	res = m_pSocketClient->call("PgCheckPrivacyPackage", userId, packageId, &result, &isPrivacyPackage);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
-
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgCheckPrivacyPackage", userId, packageId, &result, &isPrivacyPackage);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -380,14 +671,8 @@ PrivacyGuardClient::PgUpdateMonitorPolicy(const int userId, const std::string pa
 	if (!isValid)
 		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
-
-	res = m_pSocketClient->call("PgUpdateMonitorPolicy", userId, packageId, privacyId, monitorPolicy, &result);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
-
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgUpdateMonitorPolicy", userId, packageId, privacyId, monitorPolicy, &result);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -397,14 +682,8 @@ PrivacyGuardClient::PgGetMainMonitorPolicy(const int userId, bool &mainMonitorPo
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
-
-	res = m_pSocketClient->call("PgGetMainMonitorPolicy", userId, &result, &mainMonitorPolicy);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
-
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgGetMainMonitorPolicy", userId, &result, &mainMonitorPolicy);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -414,14 +693,8 @@ PrivacyGuardClient::PgUpdateMainMonitorPolicy(const int userId, const bool mainM
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
-
-	res = m_pSocketClient->call("PgUpdateMainMonitorPolicy", userId, mainMonitorPolicy, &result);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
-
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
+	int res = m_pSocketClient->call("PgUpdateMainMonitorPolicy", userId, mainMonitorPolicy, &result);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
@@ -431,14 +704,8 @@ PrivacyGuardClient::PgDeleteMainMonitorPolicyByUserId(const int userId)
 {
 	int result = PRIV_FLTR_ERROR_SUCCESS;
 
-	int res = m_pSocketClient->connect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "connect : %d", res);
-
-	res = m_pSocketClient->call("PgDeleteMainMonitorPolicyByUserId", userId, &result);
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, m_pSocketClient->disconnect(), "call : %d", res);
-
-	res = m_pSocketClient->disconnect();
-	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "disconnect : %d", res);
+	int res = m_pSocketClient->call("PgDeleteMainMonitorPolicyByUserId", userId, &result);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "call : %d", res);
 
 	return result;
 }
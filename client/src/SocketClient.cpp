@@ -21,6 +21,7 @@
 #include <sys/un.h>
 #include <errno.h>
 #include <unistd.h>
+#include <poll.h>
 #include "PrivacyGuardTypes.h"
 #include "SocketClient.h"
 #include "Utils.h"
@@ -30,14 +31,50 @@
 												return -1; \
 											} while(0)
 
-SocketClient::SocketClient(const std::string& interfaceName)
+const int SocketClient::MAX_SEND_ATTEMPTS = 2;
+// a call, or a chunk of a batch, fails when the server hasn't answered it within this time
+const int SocketClient::CALL_TIMEOUT_MS = 5000;
+// the client reads nothing while it writes a chunk of requests, so the requests of one chunk
+// must fit in the socket buffer even when the server is blocked writing the responses
+const size_t SocketClient::MAX_PIPELINE_DEPTH = 32;
+const size_t SocketClient::MAX_PIPELINE_BYTES = 32 * 1024;
+
+SocketClient::SocketClient(const std::string& interfaceName, const std::string& serverAddress)
+	: m_socketFd(-1)
+	, m_requestId(0)
+	, m_bResponseStarted(false)
+	, m_callingThread(std::thread::id())
 {
 	m_interfaceName = interfaceName;
-	m_serverAddress = SERVER_ADDRESS;
+	m_serverAddress = serverAddress;
 	PF_LOGI("Client created m_interfaceName : %s, m_serverAddress : %s", m_interfaceName.c_str(), m_serverAddress.c_str());
 }
 
+SocketClient::~SocketClient()
+{
+	closeConnection();
+}
+
 int SocketClient::connect()
+{
+	std::lock_guard < std::mutex > guard(m_connectionMutex);
+
+	if (m_socketFd != -1)
+		return PRIV_FLTR_ERROR_SUCCESS;
+
+	return openConnection();
+}
+
+int SocketClient::disconnect()
+{
+	std::lock_guard < std::mutex > guard(m_connectionMutex);
+
+	closeConnection();
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int SocketClient::openConnection(void)
 {
 	struct sockaddr_un remote;
 	m_socketFd = socket(AF_UNIX, SOCK_STREAM,0);
@@ -49,27 +86,195 @@ int SocketClient::connect()
 	if ( (flags = fcntl(m_socketFd, F_GETFL, 0)) == -1 )
 		flags = 0;
 	res = fcntl(m_socketFd, F_SETFL, flags | O_NONBLOCK);
-	TryReturn( m_socketFd != -1, PRIV_FLTR_ERROR_IPC_ERROR, , "fcntl : %s", strerror(errno));
+	TryReturn( res != -1, PRIV_FLTR_ERROR_IPC_ERROR, closeConnection(), "fcntl : %s", strerror(errno));
 
 	bzero(&remote, sizeof(remote));
 	remote.sun_family = AF_UNIX;
 	strcpy(remote.sun_path, m_serverAddress.c_str());
 	res = ::connect(m_socketFd, (struct sockaddr *)&remote, SUN_LEN(&remote));
-	TryReturn( res != -1, PRIV_FLTR_ERROR_IPC_ERROR, , "connect : %s", strerror(errno));
+	TryReturn( res != -1, PRIV_FLTR_ERROR_IPC_ERROR, closeConnection(), "connect : %s", strerror(errno));
 
 	m_socketConnector.reset(new SocketConnection(m_socketFd));
-	
+
 	LOGI("Client connected");
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
 
-int SocketClient::disconnect()
+void SocketClient::closeConnection(void)
 {
-	//Socket should be already closed by server side,
-	//even though we should close it in case of any errors
+	if (m_socketFd == -1)
+		return;
+
+	m_socketConnector.reset();
 	close(m_socketFd);
+	m_socketFd = -1;
 	LOGI("Client disconnected");
+}
+
+void SocketClient::prepareFork(void)
+{
+	m_connectionMutex.lock();
+}
+
+void SocketClient::resumeParent(void)
+{
+	m_connectionMutex.unlock();
+}
+
+void SocketClient::resetAfterFork(void)
+{
+	// the responses to the requests of one process would be read by the other,
+	// the child connects anew. Only the fd is closed, a shutdown() would end the parent's connection
+	m_socketConnector.reset();
+	if (m_socketFd != -1)
+		close(m_socketFd);
+	m_socketFd = -1;
+	m_bResponseStarted = false;
+	m_callingThread = std::thread::id();
+	// taken by prepareFork() in the thread that forked, the only one of the child
+	m_connectionMutex.unlock();
+}
+
+int SocketClient::beginRequest(const std::string& methodName, bool* pReused)
+{
+	m_bResponseStarted = false;
+
+	int res = prepareConnection(pReused);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "prepareConnection : %d", res);
+
+	return writeRequestHeader(methodName);
+}
+
+int SocketClient::prepareConnection(bool* pReused)
+{
+	*pReused = false;
+
+	if (m_socketFd != -1)
+	{
+		// nothing is expected from an idle connection, a readable socket means the server closed it
+		pollfd idlePollFd;
+		idlePollFd.fd = m_socketFd;
+		idlePollFd.events = POLLIN | POLLRDHUP;
+		idlePollFd.revents = 0;
+		if (poll(&idlePollFd, 1, 0) != 0)
+		{
+			LOGI("Connection closed by server, reconnecting");
+			closeConnection();
+		}
+		else
+		{
+			*pReused = true;
+		}
+	}
+
+	if (m_socketFd == -1)
+	{
+		int res = openConnection();
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "openConnection : %d", res);
+	}
+
+	m_socketConnector->setTimeout(CALL_TIMEOUT_MS);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int SocketClient::writeRequestHeader(const std::string& methodName)
+{
+	++m_requestId;
+
+	int res = m_socketConnector->write(m_requestId, m_interfaceName, methodName);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int SocketClient::readResponseHeader(unsigned int expectedRequestId)
+{
+	// the request is complete once the response is awaited
+	int res = m_socketConnector->flush();
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "flush : %d", res);
+
+	m_bResponseStarted = true;
+
+	res = m_socketConnector->readMessage();
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readMessage : %d", res);
+
+	unsigned int requestId = 0;
+	res = m_socketConnector->read(&requestId);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "read : %d", res);
+	TryReturn(requestId == expectedRequestId, PRIV_FLTR_ERROR_IPC_ERROR, , "response %u does not match request %u", requestId, expectedRequestId);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int SocketClient::callBatch(const Batch& batch)
+{
+	PF_LOGI("callBatch m_interfaceName : %s, calls : %d", m_interfaceName.c_str(), (int)batch.m_callList.size());
+
+	// the connection is busy with the response this call is made from
+	if (m_callingThread.load() == std::this_thread::get_id())
+	{
+		SocketClient nestedClient(m_interfaceName, m_serverAddress);
+		return nestedClient.callBatch(batch);
+	}
+
+	std::lock_guard < std::mutex > guard(m_connectionMutex);
+	CallingThreadScope callingThreadScope(this);
+
+	size_t callCount = batch.m_callList.size();
+	size_t chunkStart = 0;
+	int attempt = 0;
+
+	while (chunkStart < callCount)
+	{
+		m_bResponseStarted = false;
+		bool bReused = false;
+		bool bFlushFailed = false;
+		size_t sentBytes = 0;
+
+		int res = prepareConnection(&bReused);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "prepareConnection : %d", res);
+
+		// the requests of a chunk are gathered and sent with one flush
+		unsigned int firstRequestId = m_requestId + 1;
+		size_t chunkEnd = chunkStart;
+		while (res == PRIV_FLTR_ERROR_SUCCESS && chunkEnd < callCount
+				&& chunkEnd - chunkStart < MAX_PIPELINE_DEPTH && m_socketConnector->getOutputSize() < MAX_PIPELINE_BYTES)
+		{
+			res = writeRequestHeader(batch.m_callList[chunkEnd].methodName);
+			if (res == PRIV_FLTR_ERROR_SUCCESS)
+				res = batch.m_callList[chunkEnd].writeArgs(this);
+			m_socketConnector->endMessage();
+			++chunkEnd;
+		}
+
+		if (res == PRIV_FLTR_ERROR_SUCCESS)
+		{
+			res = m_socketConnector->flush(&sentBytes);
+			bFlushFailed = (res != PRIV_FLTR_ERROR_SUCCESS);
+		}
+
+		for (size_t i = chunkStart; i < chunkEnd && res == PRIV_FLTR_ERROR_SUCCESS; ++i)
+		{
+			res = readResponseHeader(firstRequestId + (i - chunkStart));
+			if (res == PRIV_FLTR_ERROR_SUCCESS)
+				res = batch.m_callList[i].readArgs(this);
+		}
+
+		if (res != PRIV_FLTR_ERROR_SUCCESS)
+		{
+			closeConnection();
+			// only a chunk of which nothing reached the server is sent again
+			if (bReused == true && bFlushFailed == true && sentBytes == 0 && ++attempt < MAX_SEND_ATTEMPTS)
+				continue;
+			PF_LOGE("callBatch : %d, %d calls served", res, (int)chunkStart);
+			return res;
+		}
+
+		chunkStart = chunkEnd;
+		attempt = 0;
+	}
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -58,6 +58,13 @@ int privacy_guard_client_add_privacy_access_log(const int user_id, const char *p
 	return retval;
 }
 
+int privacy_guard_client_prefetch_monitor_policy(void)
+{
+	int retval = PrivacyChecker::prefetchMonitorPolicyCache();
+
+	return retval;
+}
+
 int privacy_guard_client_delete_all_logs_and_monitor_policy(void)
 {
 	PrivacyGuardClient *pInst = PrivacyGuardClient::getInstance();
@@ -97,23 +104,23 @@ int privacy_guard_client_foreach_total_privacy_count_of_package(const int user_i
 	if (user_id < 0 || start_date > end_date || start_date <= 0)
 		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
 	PrivacyGuardClient *pInst = PrivacyGuardClient::getInstance();
-	std::list <std::pair<std::string, int>> list;
+	int resultCount = 0;
+
+	// each result goes to the callback as soon as it is received
+	ListReceiver < std::pair <std::string, int> > receiver = [&](std::pair <std::string, int>& info) {
+		PF_LOGD("result > package_id : %s, count : %d", info.first.c_str(), info.second);
+		++resultCount;
+		return callback(info.first.c_str(), info.second, user_data);
+	};
 
 	PF_LOGD("start_date : %d, end_date : %d", start_date, end_date);
-	int retval = pInst->PgForeachTotalPrivacyCountOfPackage(user_id, start_date, end_date, list);
+	int retval = pInst->PgForeachTotalPrivacyCountOfPackage(user_id, start_date, end_date, receiver);
 
 	if (retval != PRIV_FLTR_ERROR_SUCCESS)
 		return retval;
-	if (list.size() == 0)
+	if (resultCount == 0)
 		return PRIV_FLTR_ERROR_NO_DATA;
 
-	for (std::list <std::pair <std::string, int>>::iterator iter = list.begin(); iter != list.end(); ++iter) {
-		PF_LOGD("result > package_id : %s, count : %d", iter->first.c_str(), iter->second);
-		bool ret = callback(iter->first.c_str(), iter->second, user_data);
-		if (ret == false)
-			break;
-	}
-
 	return retval;
 }
 
@@ -124,23 +131,23 @@ int privacy_guard_client_foreach_total_privacy_count_of_privacy(const int user_i
 		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
 
 	PrivacyGuardClient *pInst = PrivacyGuardClient::getInstance();
-	std::list <std::pair<std::string, int>> list;
+	int resultCount = 0;
+
+	// each result goes to the callback as soon as it is received
+	ListReceiver < std::pair <std::string, int> > receiver = [&](std::pair <std::string, int>& info) {
+		PF_LOGD("result > privacy_id : %s, count : %d", info.first.c_str(), info.second);
+		++resultCount;
+		return callback(info.first.c_str(), info.second, user_data);
+	};
 
 	PF_LOGD("start_date : %d, end_date : %d", start_date, end_date);
-	int retval = pInst->PgForeachTotalPrivacyCountOfPrivacy(user_id, start_date, end_date, list);
+	int retval = pInst->PgForeachTotalPrivacyCountOfPrivacy(user_id, start_date, end_date, receiver);
 
 	if (retval != PRIV_FLTR_ERROR_SUCCESS)
 		return retval;
-	if (list.size() == 0)
+	if (resultCount == 0)
 		return PRIV_FLTR_ERROR_NO_DATA;
 
-	for (std::list <std::pair <std::string, int>>::iterator iter = list.begin(); iter != list.end(); ++iter) {
-		PF_LOGD("result > privacy_id : %s, count : %d", iter->first.c_str(), iter->second);
-		bool ret = callback(iter->first.c_str(), iter->second, user_data);
-		if (ret == false)
-			break;
-	}
-
 	return retval;
 }
 
@@ -152,23 +159,23 @@ int privacy_guard_client_foreach_privacy_count_by_privacy_id(const int user_id,
 		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
 
 	PrivacyGuardClient *pInst = PrivacyGuardClient::getInstance();
-	std::list <std::pair<std::string, int>> list;
+	int resultCount = 0;
+
+	// each result goes to the callback as soon as it is received
+	ListReceiver < std::pair <std::string, int> > receiver = [&](std::pair <std::string, int>& info) {
+		PF_LOGD("result > package_id : %s, count : %d", info.first.c_str(), info.second);
+		++resultCount;
+		return callback(info.first.c_str(), info.second, user_data);
+	};
 
 	PF_LOGD("start_date : %d, end_date : %d", start_date, end_date);
-	int retval = pInst->PgForeachPrivacyCountByPrivacyId(user_id, start_date, end_date, std::string(privacy_id), list);
+	int retval = pInst->PgForeachPrivacyCountByPrivacyId(user_id, start_date, end_date, std::string(privacy_id), receiver);
 
 	if (retval != PRIV_FLTR_ERROR_SUCCESS)
 		return retval;
-	if (list.size() == 0)
+	if (resultCount == 0)
 		return PRIV_FLTR_ERROR_NO_DATA;
 
-	for (std::list <std::pair <std::string, int>>::iterator iter = list.begin(); iter != list.end(); ++iter) {
-		PF_LOGD("result > package_id : %s, count : %d", iter->first.c_str(), iter->second);
-		bool ret = callback(iter->first.c_str(), iter->second, user_data);
-		if (ret == false)
-			break;
-	}
-
 	return retval;
 }
 
@@ -181,23 +188,23 @@ int privacy_guard_client_foreach_privacy_count_by_package_id(const int user_id,
 		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
 
 	PrivacyGuardClient *pInst = PrivacyGuardClient::getInstance();
-	std::list <std::pair<std::string, int>> list;
+	int resultCount = 0;
+
+	// each result goes to the callback as soon as it is received
+	ListReceiver < std::pair <std::string, int> > receiver = [&](std::pair <std::string, int>& info) {
+		PF_LOGD("result > privacy_id : %s, count : %d", info.first.c_str(), info.second);
+		++resultCount;
+		return callback(info.first.c_str(), info.second, user_data);
+	};
 
 	PF_LOGD("start_date : %d, end_date : %d", start_date, end_date);
-	int retval = pInst->PgForeachPrivacyCountByPackageId(user_id, start_date, end_date, std::string(package_id), list);
+	int retval = pInst->PgForeachPrivacyCountByPackageId(user_id, start_date, end_date, std::string(package_id), receiver);
 
 	if (retval != PRIV_FLTR_ERROR_SUCCESS)
 		return retval;
-	if (list.size() == 0)
+	if (resultCount == 0)
 		return PRIV_FLTR_ERROR_NO_DATA;
 
-	for (std::list <std::pair <std::string, int>>::iterator iter = list.begin(); iter != list.end(); ++iter) {
-		PF_LOGD("result > privacy_id : %s, count : %d", iter->first.c_str(), iter->second);
-		bool ret = callback(iter->first.c_str(), iter->second, user_data);
-		if (ret == false)
-			break;
-	}
-
 	return retval;
 }
 
@@ -240,29 +247,27 @@ int privacy_guard_client_foreach_monitor_policy_by_package_id(const int user_id,
 
 	PF_LOGD("package_id : %s", package_id);
 
-	std::list <privacy_data_s> privacyInfoList;
+	int resultCount = 0;
+	ListReceiver < std::pair <std::string, int> > receiver = [&](std::pair <std::string, int>& privacyInfo) {
+		PF_LOGD("result > privacy_id : %s, monitor_policy : %d",
+						privacyInfo.first.c_str(), privacyInfo.second);
+		++resultCount;
+		return callback(privacyInfo.first.c_str(), privacyInfo.second, user_data);
+	};
 	int retval = -1;
 
-	retval = PrivacyGuardClient::getInstance()->PgForeachMonitorPolicyByPackageId(user_id, std::string(package_id), privacyInfoList);
+	retval = PrivacyGuardClient::getInstance()->PgForeachMonitorPolicyByPackageId(user_id, std::string(package_id), receiver);
 
 	if (retval != PRIV_FLTR_ERROR_SUCCESS) {
 		PF_LOGE("PgForeachMonitorPolicyByPackageId : fail");
 		return retval;
 	}
 
-	if (privacyInfoList.size() == 0) {
+	if (resultCount == 0) {
 		PF_LOGE("PgForeachMonitorPolicyByPackageId (privacyList.size = 0): fail");
 		return PRIV_FLTR_ERROR_NO_DATA;
 	}
 
-	for (std::list <privacy_data_s>::iterator iter = privacyInfoList.begin(); iter != privacyInfoList.end(); ++iter) {
-		PF_LOGD("result > privacy_id : %s, monitor_policy : %d",
-						iter->privacy_id, iter->monitor_policy);
-		bool ret = callback(iter->privacy_id, iter->monitor_policy, user_data);
-		if (ret == false)
-			break;
-	}
-
 	return retval;
 }
 
@@ -287,26 +292,24 @@ int privacy_guard_client_foreach_privacy_package_id(const int user_id, privacy_g
 
 	PrivacyGuardClient* pInst = PrivacyGuardClient::getInstance();
 
-	std::list < std::string > packageList;
+	int resultCount = 0;
+	ListReceiver < std::string > receiver = [&](std::string& packageId) {
+		PF_LOGD("package_id : %s", packageId.c_str());
+		++resultCount;
+		return callback(packageId.c_str(), user_data);
+	};
 
-	int retval = pInst->PgForeachPrivacyPackageId(user_id, packageList);
+	int retval = pInst->PgForeachPrivacyPackageId(user_id, receiver);
 	if (retval != PRIV_FLTR_ERROR_SUCCESS) {
 		PF_LOGE("PgForeachPrivacyPackageId : fail");
 		return retval;
 	}
 
-	if (packageList.size() == 0) {
+	if (resultCount == 0) {
 		PF_LOGE("PgForeachPrivacyPackageId (packageList.size = 0): fail");
 		return PRIV_FLTR_ERROR_NO_DATA;
 	}
 
-	for (std::list < std::string >::iterator iter = packageList.begin(); iter != packageList.end(); ++iter) {
-		PF_LOGD("package_id : %s", iter->c_str());
-		bool ret = callback(iter->c_str(), user_data);
-		if (ret == false)
-			break;
-	}
-
 	return retval;
 }
 
@@ -317,26 +320,24 @@ int privacy_guard_client_foreach_package_by_privacy_id(const int user_id, const
 
 	PrivacyGuardClient* pInst = PrivacyGuardClient::getInstance();
 
-	std::list < std::string > packageList;
+	int resultCount = 0;
+	ListReceiver < std::string > receiver = [&](std::string& packageId) {
+		PF_LOGD("package_id : %s", packageId.c_str());
+		++resultCount;
+		return callback(packageId.c_str(), user_data);
+	};
 
-	int retval = pInst->PgForeachPackageByPrivacyId(user_id, std::string(privacy_id), packageList);
+	int retval = pInst->PgForeachPackageByPrivacyId(user_id, std::string(privacy_id), receiver);
 	if (retval != PRIV_FLTR_ERROR_SUCCESS) {
 		PF_LOGE("PgForeachPackageByPrivacyId : fail");
 		return retval;
 	}
 
-	if (packageList.size() == 0) {
+	if (resultCount == 0) {
 		PF_LOGE("PgForeachPackageByPrivacyId (packageList.size = 0): fail");
 		return PRIV_FLTR_ERROR_NO_DATA;
 	}
 
-	for (std::list < std::string >::iterator iter = packageList.begin(); iter != packageList.end(); ++iter) {
-		PF_LOGD("package_id : %s", iter->c_str());
-		bool ret = callback(iter->c_str(), user_data);
-		if (ret == false)
-			break;
-	}
-
 	return retval;
 }
 
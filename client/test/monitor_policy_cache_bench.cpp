@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// Looks up 10000 cached monitor policies, 1000 packages of 10 privacies, in a random
+// order : in MonitorPolicyCache, and in the std::map the client had before, keyed by
+// "userId|packageId|privacyId" built at each lookup. Prints ns/lookup of both, for
+// policies found and for packages without policy, and the allocations per lookup.
+// Fails when a policy is found wrong or a lookup in MonitorPolicyCache allocates.
+//
+// usage : monitor-policy-cache-bench [rounds]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include "MonitorPolicyCache.h"
+
+#define USER_ID 5001
+#define PACKAGE_COUNT 1000
+#define PRIVACY_COUNT 10
+
+// only the allocations of the lookups are counted
+static bool g_bCounting = false;
+static std::atomic < unsigned long > g_allocationCount(0);
+
+// not inlined, the compiler would pair a malloc() it sees with an operator delete
+static void* __attribute__((noinline))
+allocate(size_t size)
+{
+	if (g_bCounting == true)
+		++g_allocationCount;
+	return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(size_t size)
+{
+	void* pMemory = allocate(size);
+	if (pMemory == NULL)
+		throw std::bad_alloc();
+	return pMemory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+static void __attribute__((noinline))
+release(void* pMemory)
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	release(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+	release(pMemory);
+}
+
+struct Lookup
+{
+	std::string packageId;
+	std::string privacyId;
+	int monitorPolicy;
+};
+
+struct Result
+{
+	double nsPerLookup;
+	double allocationsPerLookup;
+	unsigned long failedCount;
+};
+
+static int
+expectedPolicy(int package, int privacy)
+{
+	return (package + privacy) % 2;
+}
+
+// what PrivacyChecker::getMonitorPolicy did before
+static bool
+findInMap(const std::map < std::string, int >& policyMap, const Lookup& lookup, int& monitorPolicy)
+{
+	std::string key = std::to_string(USER_ID) + "|" + lookup.packageId + "|" + lookup.privacyId;
+	std::map < std::string, int >::const_iterator iter = policyMap.find(key);
+	if (iter == policyMap.end())
+		return false;
+	monitorPolicy = iter->second;
+	return true;
+}
+
+static bool
+findInCache(const MonitorPolicyCache& cache, const Lookup& lookup, int& monitorPolicy)
+{
+	bool bKnown = false;
+	return cache.find(USER_ID, lookup.packageId, lookup.privacyId, monitorPolicy, bKnown);
+}
+
+template < typename Find >
+static Result
+run(const std::vector < Lookup >& lookups, int roundCount, Find find)
+{
+	Result result = { 0.0, 0.0, 0 };
+	unsigned long before = g_allocationCount;
+	g_bCounting = true;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int round = 0; round < roundCount; ++round)
+	{
+		for (std::vector < Lookup >::const_iterator iter = lookups.begin(); iter != lookups.end(); ++iter)
+		{
+			int monitorPolicy = -1;
+			bool bFound = find(*iter, monitorPolicy);
+			if (bFound != (iter->monitorPolicy != -1) || (bFound == true && monitorPolicy != iter->monitorPolicy))
+				++result.failedCount;
+		}
+	}
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+	g_bCounting = false;
+
+	double lookupCount = (double)lookups.size() * roundCount;
+	result.nsPerLookup = std::chrono::duration < double, std::nano > (elapsed).count() / lookupCount;
+	result.allocationsPerLookup = (g_allocationCount - before) / lookupCount;
+	return result;
+}
+
+int
+main(int argc, char* argv[])
+{
+	int roundCount = argc > 1 ? atoi(argv[1]) : 100;
+
+	MonitorPolicyCache cache;
+	std::map < std::string, int > policyMap;
+	std::vector < Lookup > hits;
+	std::vector < Lookup > misses;
+	for (int package = 0; package < PACKAGE_COUNT; ++package)
+	{
+		std::string packageId = "org.tizen.monitorpolicycachebench.application" + std::to_string(package);
+		for (int privacy = 0; privacy < PRIVACY_COUNT; ++privacy)
+		{
+			std::string privacyId = "http://tizen.org/privacy/monitorpolicycachebench" + std::to_string(privacy);
+			int monitorPolicy = expectedPolicy(package, privacy);
+			cache.set(USER_ID, packageId, privacyId, monitorPolicy);
+			policyMap[std::to_string(USER_ID) + "|" + packageId + "|" + privacyId] = monitorPolicy;
+
+			Lookup hit = { packageId, privacyId, monitorPolicy };
+			hits.push_back(hit);
+			// an application the cache has never seen, with a privacy it knows
+			Lookup miss = { "org.tizen.monitorpolicycachebench.other" + std::to_string(package), privacyId, -1 };
+			misses.push_back(miss);
+		}
+	}
+	cache.setComplete();
+
+	// a fixed order, the same for both
+	srand(1);
+	std::random_shuffle(hits.begin(), hits.end());
+	std::random_shuffle(misses.begin(), misses.end());
+
+	Result mapHits = run(hits, roundCount, [&policyMap](const Lookup& lookup, int& monitorPolicy) {
+		return findInMap(policyMap, lookup, monitorPolicy);
+	});
+	Result cacheHits = run(hits, roundCount, [&cache](const Lookup& lookup, int& monitorPolicy) {
+		return findInCache(cache, lookup, monitorPolicy);
+	});
+	Result mapMisses = run(misses, roundCount, [&policyMap](const Lookup& lookup, int& monitorPolicy) {
+		return findInMap(policyMap, lookup, monitorPolicy);
+	});
+	Result cacheMisses = run(misses, roundCount, [&cache](const Lookup& lookup, int& monitorPolicy) {
+		return findInCache(cache, lookup, monitorPolicy);
+	});
+
+	printf("%zu policies, %d rounds of lookups\n", cache.size(), roundCount);
+	printf("%-8s %-6s %12s %20s\n", "", "", "ns/lookup", "allocations/lookup");
+	printf("%-8s %-6s %12.1f %20.2f\n", "found", "map", mapHits.nsPerLookup, mapHits.allocationsPerLookup);
+	printf("%-8s %-6s %12.1f %20.2f\n", "found", "cache", cacheHits.nsPerLookup, cacheHits.allocationsPerLookup);
+	printf("%-8s %-6s %12.1f %20.2f\n", "missing", "map", mapMisses.nsPerLookup, mapMisses.allocationsPerLookup);
+	printf("%-8s %-6s %12.1f %20.2f\n", "missing", "cache", cacheMisses.nsPerLookup, cacheMisses.allocationsPerLookup);
+
+	int failures = 0;
+	unsigned long failedCount = mapHits.failedCount + cacheHits.failedCount + mapMisses.failedCount + cacheMisses.failedCount;
+	if (cache.size() != PACKAGE_COUNT * PRIVACY_COUNT || failedCount != 0)
+	{
+		printf("FAIL %zu policies cached, %lu lookups found wrong\n", cache.size(), failedCount);
+		++failures;
+	}
+	if (cacheHits.allocationsPerLookup != 0.0 || cacheMisses.allocationsPerLookup != 0.0)
+	{
+		printf("FAIL a lookup in the cache allocates\n");
+		++failures;
+	}
+	return failures == 0 ? 0 : 1;
+}
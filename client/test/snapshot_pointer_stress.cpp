@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// Many readers and one writer on a SnapshotPointer, next to the same load on a mutex.
+// Each reader checks that the value it reads is whole and not freed, the program fails
+// when one isn't. The lookups per second of each reader should stay flat as readers are
+// added on a multi-core device, readers sharing a cache line don't.
+//
+// usage : snapshot-pointer-stress [reader count] [duration in ms]
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include "SnapshotPointer.h"
+
+#define ENTRY_COUNT 64
+#define VALUE_MAGIC 0x50475350UL
+
+struct Value
+{
+	unsigned long magic;
+	unsigned long generation;
+	// generation of every entry, a torn copy doesn't match
+	std::map < std::string, unsigned long > entries;
+
+	explicit Value(unsigned long generation)
+		: magic(VALUE_MAGIC)
+		, generation(generation)
+	{
+		for (int i = 0; i < ENTRY_COUNT; ++i)
+			entries["http://tizen.org/privacy/item" + std::to_string(i)] = generation;
+	}
+
+	~Value(void)
+	{
+		// a reader of a freed value finds it out
+		magic = 0;
+	}
+
+	bool isValid(const std::string& key) const
+	{
+		std::map < std::string, unsigned long >::const_iterator iter = entries.find(key);
+		return magic == VALUE_MAGIC && iter != entries.end() && iter->second == generation;
+	}
+};
+
+struct Result
+{
+	double lookupsPerSecond;
+	unsigned long writeCount;
+	unsigned long badCount;
+};
+
+static std::vector < std::string > keys;
+
+static Result
+run(const bool bSnapshot, const int readerCount, const int durationMs)
+{
+	SnapshotPointer < Value > snapshot(new Value(0));
+	std::mutex valueMutex;
+	Value* pLockedValue = new Value(0);
+
+	std::atomic < bool > bStop(false);
+	std::atomic < unsigned long > lookupCount(0);
+	std::atomic < unsigned long > badCount(0);
+	unsigned long writeCount = 0;
+
+	std::vector < std::thread > readers;
+	for (int reader = 0; reader < readerCount; ++reader)
+	{
+		readers.push_back(std::thread([&, reader]() {
+			unsigned long lookups = 0;
+			unsigned long bad = 0;
+			const std::string& key = keys[reader % keys.size()];
+			while (bStop.load(std::memory_order_relaxed) == false)
+			{
+				if (bSnapshot == true)
+				{
+					SnapshotPointer < Value >::ReadGuard value(snapshot);
+					if (value->isValid(key) == false)
+						++bad;
+				}
+				else
+				{
+					std::lock_guard < std::mutex > guard(valueMutex);
+					if (pLockedValue->isValid(key) == false)
+						++bad;
+				}
+				++lookups;
+			}
+			lookupCount += lookups;
+			badCount += bad;
+		}));
+	}
+
+	// the writer replaces the whole value as fast as it can, like a burst of policy changes
+	std::thread writer([&]() {
+		unsigned long generation = 1;
+		while (bStop.load(std::memory_order_relaxed) == false)
+		{
+			Value* pValue = new Value(generation++);
+			if (bSnapshot == true)
+			{
+				snapshot.publish(pValue);
+			}
+			else
+			{
+				std::lock_guard < std::mutex > guard(valueMutex);
+				delete pLockedValue;
+				pLockedValue = pValue;
+			}
+			++writeCount;
+		}
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+	bStop = true;
+	writer.join();
+	for (size_t i = 0; i < readers.size(); ++i)
+		readers[i].join();
+	delete pLockedValue;
+
+	Result result;
+	result.lookupsPerSecond = lookupCount * 1000.0 / durationMs;
+	result.writeCount = writeCount;
+	result.badCount = badCount;
+	return result;
+}
+
+int
+main(int argc, char* argv[])
+{
+	int readerCount = argc > 1 ? atoi(argv[1]) : 2 * (int)std::thread::hardware_concurrency();
+	int durationMs = argc > 2 ? atoi(argv[2]) : 1000;
+	if (readerCount < 1)
+		readerCount = 1;
+
+	for (int i = 0; i < ENTRY_COUNT; ++i)
+		keys.push_back("http://tizen.org/privacy/item" + std::to_string(i));
+
+	printf("%u cpus, %d ms a run\n", std::thread::hardware_concurrency(), durationMs);
+
+	unsigned long badCount = 0;
+	const int readerCounts[] = { 1, readerCount };
+	for (int i = 0; i < 2; ++i)
+	{
+		for (int mode = 0; mode < 2; ++mode)
+		{
+			Result result = run(mode == 1, readerCounts[i], durationMs);
+			printf("%-8s %3d readers : %8.2f M lookups/s, %6.2f M a reader, %8lu writes, %lu bad\n",
+				mode == 1 ? "snapshot" : "mutex", readerCounts[i], result.lookupsPerSecond / 1e6,
+				result.lookupsPerSecond / 1e6 / readerCounts[i], result.writeCount, result.badCount);
+			badCount += result.badCount;
+		}
+	}
+
+	return badCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef _ACCESSLOGRING_H_
+#define _ACCESSLOGRING_H_
+
+#include <string>
+#include <time.h>
+#include "PrivacyGuardTypes.h"
+
+/*
+ * Shared memory ring of the access logs of one client process, one writer and one reader.
+ * The client writes fixed size records and moves the head, the server reads them
+ * and moves the tail; none of them locks or makes a system call in the common case.
+ * The ring is a sealed memfd passed to the server with SCM_RIGHTS, together with
+ * an eventfd for the client to wake the server up and the read end of a pipe
+ * whose hang up tells the server that the client is gone.
+ * The server waits on the eventfd only once it found the ring empty, the client
+ * signals it at the first log of a burst.
+ * A log that doesn't fit in a record, or finds the ring full, goes over the socket.
+ * The server trusts nothing of the shared memory, each record is copied and checked.
+ */
+class EXTERN_API AccessLogRing
+{
+public:
+	AccessLogRing(void);
+	~AccessLogRing(void);
+
+	// client side : makes the ring, the fds to pass are then given by get*Fd()
+	int create(void);
+	// the client doesn't need the memfd and the read end of the pipe once they are passed
+	void closePassedFds(void);
+	// false when the ring is full or the log is too long for a record
+	bool push(const int userId, const std::string& packageId, const std::string& privacyId);
+	// the server closed its end, a new server doesn't know the ring
+	bool isReaderGone(void) const;
+
+	// server side : the fds passed by the client, owned by the ring from now on
+	int attach(int memoryFd, int eventFd, int hangupFd);
+	// takes the oldest record, false when there is none
+	bool pop(int* pUserId, std::string* pPackageId, std::string* pPrivacyId, time_t* pUseDate);
+	// the ring is empty and the next push signals the eventfd, else the caller reads on
+	bool waitForPush(void);
+	// resets the eventfd after a wake up
+	void clearWakeUp(void);
+	// the client broke the ring, its records can't be read any more
+	bool isBroken(void) const
+	{
+		return m_bBroken;
+	}
+
+	int getMemoryFd(void) const
+	{
+		return m_memoryFd;
+	}
+	int getEventFd(void) const
+	{
+		return m_eventFd;
+	}
+	int getHangupFd(void) const
+	{
+		return m_hangupFd;
+	}
+
+private:
+	struct Header;
+	struct Record;
+	struct Shared;
+
+	void release(void);
+
+	Shared* m_pShared;
+	int m_memoryFd;
+	int m_eventFd;
+	// the read end of the pipe, the client keeps it only until it is passed
+	int m_hangupFd;
+	// the write end of the pipe, closed by the end of the client process
+	int m_hangupWriteFd;
+	// the index this side moves, the shared one is only written
+	unsigned int m_index;
+	bool m_bBroken;
+};
+
+#endif // _ACCESSLOGRING_H_
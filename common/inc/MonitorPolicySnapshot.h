@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef _MONITORPOLICYSNAPSHOT_H_
+#define _MONITORPOLICYSNAPSHOT_H_
+
+#include <list>
+#include <string>
+#include <sys/types.h>
+#include "PrivacyGuardTypes.h"
+
+/*
+ * All the monitor policies in one read-only file, published by the server and
+ * mapped by the clients, which look the policies up in it without IPC.
+ * The records are sorted by (user, package, privacy) and found by binary search,
+ * their ids point into a table of the distinct strings.
+ * The server writes each version to a new file and renames it over the old one,
+ * then flags the old one as replaced. A client finds the flag in the file it
+ * maps and maps the new one, it needs no signal to see the change.
+ * A server that fails to write a version removes the file before it flags the old
+ * one, the clients then ask the server the policies.
+ * The client trusts only what it checks: the header when it maps the file and
+ * each string offset when it reads it.
+ */
+class EXTERN_API MonitorPolicySnapshot
+{
+public:
+	struct Policy
+	{
+		int userId;
+		std::string packageId;
+		std::string privacyId;
+		int monitorPolicy;
+	};
+
+	MonitorPolicySnapshot(void);
+	~MonitorPolicySnapshot(void);
+
+	// client side : maps the file read-only
+	int open(const std::string& path);
+	bool find(const int userId, const std::string& packageId, const std::string& privacyId, int& monitorPolicy) const;
+	// a newer file took the path, this one won't change any more
+	bool isReplaced(void) const;
+	unsigned int getGeneration(void) const;
+	unsigned int size(void) const;
+
+	// server side : writes the policies to a new file, in any order, and replaces the one at the path
+	// a failure withdraws the file in place, the clients then ask the server
+	static int publish(const std::string& path, std::list < Policy >& policyList);
+	// removes the file and flags it, for a server that can't tell the policies
+	static void withdraw(const std::string& path);
+
+private:
+	struct Header;
+	struct Record;
+
+	MonitorPolicySnapshot(const MonitorPolicySnapshot&);
+	MonitorPolicySnapshot& operator=(const MonitorPolicySnapshot&);
+
+	// a writable mapping of the header of the file at the path, NULL without one
+	static Header* mapHeader(const std::string& path);
+	// unmaps the header too
+	static void setReplaced(Header* pHeader);
+
+	const char* getString(const unsigned int offset) const;
+	int compare(const Record& record, const int userId, const std::string& packageId, const std::string& privacyId) const;
+
+	const Header* m_pHeader;
+	const Record* m_pRecords;
+	const char* m_pStrings;
+	size_t m_mappedSize;
+};
+
+#endif // _MONITORPOLICYSNAPSHOT_H_
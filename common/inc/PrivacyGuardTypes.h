@@ -23,6 +23,7 @@
 
 #define PRIVACY_DB_PATH         tzplatform_mkpath(TZ_SYS_DB,".privacy_guard.db")
 #define PRIVACY_INFO_DB_PATH    tzplatform_mkpath(TZ_SYS_DB,".privacy_guard_privacylist.db")
+#define MONITOR_POLICY_SNAPSHOT_PATH    tzplatform_mkpath(TZ_SYS_DB,".privacy_guard_monitor_policy.snapshot")
 
 typedef struct _privacy_data_s {
 	char* privacy_id;
@@ -34,5 +35,9 @@ static const std::string DBUS_PATH("/privacy_guard/dbus_notification");
 static const std::string DBUS_SIGNAL_INTERFACE("org.tizen.privacy_guard.signal");
 static const std::string DBUS_SIGNAL_SETTING_CHANGED("privacy_setting_changed");
 static const std::string DBUS_SIGNAL_PKG_REMOVED("privacy_pkg_removed");
+// (userId, packageId, privacyId, monitorPolicy) of a monitor policy added or updated
+static const std::string DBUS_SIGNAL_MONITOR_POLICY_CHANGED("privacy_monitor_policy_changed");
+// (userId, packageId) of the monitor policies removed, a userId of -1 is all the users, an empty packageId all the packages
+static const std::string DBUS_SIGNAL_MONITOR_POLICY_REMOVED("privacy_monitor_policy_removed");
 
 #endif // _PRIVACYGUARDTYPES_H_
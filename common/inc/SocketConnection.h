@@ -18,12 +18,15 @@
 #define _SOCKETCONNECTION_H_
 
 #include <dlog.h>
+#include <limits.h>
 #include <new>
 #include <list>
 #include <utility>
+#include <functional>
 #include <iostream>
 #include "Utils.h"
 #include "SocketStream.h"
+#include "WireFormat.h"
 #include "PrivacyGuardTypes.h"
 
 /*
@@ -36,15 +39,34 @@
  * exception occurs during read.
  */
 
+/*
+ * The fields are encoded by their WireType, see WireFormat.h.
+ * A list is sent in chunks, each chunk in a message of its own :
+ * the number of its items, the items and whether another chunk follows.
+ * The reader takes the chunks one after the other, so a list is not limited
+ * by the size of a message. A ListReceiver gets the items one by one as they
+ * are read, instead of the whole list at the end; it returns false when it
+ * wants no more items, the rest of the list is then skipped.
+ */
+template < typename T >
+using ListReceiver = std::function < bool (T&) >;
+
 class EXTERN_API SocketConnection
 {
 
 public:
 
-	explicit SocketConnection(int socket_fd) : m_socketStream(socket_fd){
+	explicit SocketConnection(int socket_fd) : m_socketStream(socket_fd), m_bListStreaming(false){
 		LOGI("Created");
 	}
 
+	// the chunks of a long list are sent while it is written instead of gathered in the output buffer.
+	// Only for responses, a request must stay unsent until it is complete to be sent once more.
+	void setListStreaming(bool bListStreaming)
+	{
+		m_bListStreaming = bListStreaming;
+	}
+
 	template<typename T, typename ...Args>
 	int read(T* out, const Args&... args )
 	{
@@ -57,161 +79,42 @@ public:
 	}
 
 	template<typename T>
-	int read(T* out)
-	{
-		int length = 0;
-		int res = m_socketStream.readStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readStream : %d", res);
-		char* pBuf = new (std::nothrow) char[length + 1];
-		TryReturn(pBuf != NULL, PRIV_FLTR_ERROR_OUT_OF_MEMORY, , "new : %d", PRIV_FLTR_ERROR_OUT_OF_MEMORY);
-
-		res = m_socketStream.readStream(length, pBuf);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, delete[] pBuf, "readStream : %d", res);
-
-		pBuf[length] = 0;
-
-		out = T(pBuf);
-
-		delete[] pBuf;
-
-		return PRIV_FLTR_ERROR_SUCCESS;
-	}
-	
-	int read(bool* pB)
-	{
-		int length = 0;
-		int res = m_socketStream.readStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readStream : %d", res);
-
-		char* pBuf = new (std::nothrow) char[length + 1];
-		TryReturn(pBuf != NULL, PRIV_FLTR_ERROR_OUT_OF_MEMORY, , "new : %d", PRIV_FLTR_ERROR_OUT_OF_MEMORY);
-
-		res = m_socketStream.readStream(length, pBuf);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, delete[] pBuf, "readStream : %d", res);
-
-		pBuf[length] = 0;
-
-		*pB = * reinterpret_cast <bool* > (pBuf);
-
-		delete[] pBuf;
-
-		return PRIV_FLTR_ERROR_SUCCESS;
-	}
-
-	int read(bool& b)
-	{
-		return read(&b);
-	}
-	
-	int read(int& i)
+	int read(T* pOut)
 	{
-		return read(&i);
-	}
-
-	int read(int* pI)
-	{
-		int length = 0;
-		int res = m_socketStream.readStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readStream : %d", res);
-
-		char* pBuf = new (std::nothrow) char[length + 1];
-		TryReturn(pBuf != NULL, PRIV_FLTR_ERROR_OUT_OF_MEMORY, , "new : %d", PRIV_FLTR_ERROR_OUT_OF_MEMORY);
-
-		res = m_socketStream.readStream(length, pBuf);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, delete[] pBuf, "readStream : %d", res);
-
-		pBuf[length] = 0;
-
-		*pI = * reinterpret_cast <int* > (pBuf);
-
-		delete[] pBuf;
-
-		return PRIV_FLTR_ERROR_SUCCESS;
+		return WireType < T >::read(m_socketStream, *pOut);
 	}
 
-	int read(unsigned int* pUi)
+	template<typename T>
+	int read(T& out)
 	{
-		int length = 0;
-		int res = m_socketStream.readStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readStream : %d", res);
-
-		char* pBuf = new (std::nothrow) char[length + 1];
-		TryReturn(pBuf != NULL, PRIV_FLTR_ERROR_OUT_OF_MEMORY, , "new : %d", PRIV_FLTR_ERROR_OUT_OF_MEMORY);
-
-		res = m_socketStream.readStream(length, pBuf);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, delete[] pBuf, "readStream : %d", res);
-
-		pBuf[length] = 0;
-
-		*pUi = * reinterpret_cast <unsigned int* > (pBuf);
-
-		delete[] pBuf;
-
-		return PRIV_FLTR_ERROR_SUCCESS;
+		return WireType < T >::read(m_socketStream, out);
 	}
-	int read(std::string* pStr)
-	{
-		int length = 0;
-		int res = m_socketStream.readStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readStream : %d", res);
-
-		char* pBuf = new (std::nothrow) char[length + 1];
-		TryReturn(pBuf != NULL, PRIV_FLTR_ERROR_OUT_OF_MEMORY, , "new : %d", PRIV_FLTR_ERROR_OUT_OF_MEMORY);
-
-		m_socketStream.readStream(length, pBuf);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, delete[] pBuf, "readStream : %d", res);
 
-		pBuf[length] = 0;
-
-		*pStr = std::string(pBuf);
-		delete[] pBuf;
-
-		return PRIV_FLTR_ERROR_SUCCESS;
-	}
-	
-	int read(std::string& str)
+	template < typename T >
+	int read (std::list<T>& list)
 	{
-		return read(&str);
+		return readList([this, &list]() {
+				// decoded in place, the element is not copied into the list
+				list.push_back(T());
+				int res = read(list.back());
+				if (res != PRIV_FLTR_ERROR_SUCCESS)
+					list.pop_back();
+				return res;
+			});
 	}
 
-	int read(privacy_data_s& out)
-	{
-		int length = 0;
-		int res = 0;
-		char* pBuf;
-		// privacy id
-		res = m_socketStream.readStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readStream : %d", res);
-		pBuf = new (std::nothrow) char[length + 1];
-		TryReturn(pBuf != NULL, PRIV_FLTR_ERROR_OUT_OF_MEMORY, , "new : %d", PRIV_FLTR_ERROR_OUT_OF_MEMORY);
-		m_socketStream.readStream(length, pBuf);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, delete[] pBuf, "readStream : %d", res);
-		pBuf[length] = 0;
-		out.privacy_id = strdup(pBuf);
-		delete[] pBuf;
-
-		// monitor policy
-		res = read(&(out.monitor_policy));
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readStream : %d", res);
-
-		return PRIV_FLTR_ERROR_SUCCESS;
-	}
+	// one item at a time is decoded, the list is never held whole
 	template < typename T >
-	int  read (std::list<T>& list)
+	int read (ListReceiver<T>* pReceiver)
 	{
-		int length = 0;
-		int res = read(length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "read : %d", res);
-
-		for (int i = 0; i < length; ++i) 
-		{
-			T obj;
-			res = read (obj);
-			TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "read : %d", res);
-			list.push_back(obj);
-		}
-
-		return PRIV_FLTR_ERROR_SUCCESS;
+		T item;
+		bool bWanted = true;
+		return readList([this, pReceiver, &item, &bWanted]() {
+				int res = read(item);
+				if (res == PRIV_FLTR_ERROR_SUCCESS && bWanted == true)
+					bWanted = (*pReceiver)(item);
+				return res;
+			});
 	}
 
 	template < typename T >
@@ -220,25 +123,30 @@ public:
 		return read(*pList);
 	}
 
-	template < typename K, typename P >
-	int read (std::pair<K, P>& pair)
+	template<typename T, typename ...Args>
+	int write(const T& in, const Args&... args)
 	{
-		int res = read( pair.first);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "read : %d", res);
-		res = read( pair.second);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "read : %d", res);
+		int res = write(in);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
+		res = write(args...);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
 
 		return PRIV_FLTR_ERROR_SUCCESS;
 	}
 
-	template < typename K, typename P >
-	int read (std::pair<K, P>* pPair)
+	template<typename T>
+	int write(const T& in)
 	{
-		return read( *pPair);
+		return WireType < T >::write(m_socketStream, in);
+	}
+
+	int write(const char* in)
+	{
+		return WireType < const char* >::write(m_socketStream, in);
 	}
 
 	template<typename T, typename ...Args>
-	int write(const T& in, const Args&... args)
+	int write(const T* in, const Args&... args)
 	{
 		int res = write(in);
 		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
@@ -248,151 +156,151 @@ public:
 		return PRIV_FLTR_ERROR_SUCCESS;
 	}
 
-	int write(const std::string& in)
+	template<typename T>
+	int write(const T* pIn)
 	{
-		int length = in.size();
-		int res = m_socketStream.writeStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-		res = m_socketStream.writeStream(length, in.c_str());
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-
-		return PRIV_FLTR_ERROR_SUCCESS;
+		return write(*pIn);
 	}
-	
-	int write(const unsigned int& in)
+
+	template<typename T>
+	int write(const std::list <T>& list)
 	{
-		int length = sizeof(in);
-		int res = m_socketStream.writeStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-		res = m_socketStream.writeStream(length, &in);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
+		typename std::list <T>::const_iterator iter = list.begin();
+		while (1)
+		{
+			// the item count of the chunk is a fixed 16 bit number, filled in once the chunk is full
+			unsigned short length = 0;
+			int res = m_socketStream.writeStream(sizeof(length), &length);
+			TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
+			size_t lengthOffset = m_socketStream.getOutputSize() - sizeof(length);
+
+			for (; iter != list.end() && m_socketStream.getMessageSize() < LIST_CHUNK_SIZE && length < USHRT_MAX; ++iter, ++length) {
+				res = write(*iter);
+				TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
+			}
+			res = m_socketStream.rewriteStream(lengthOffset, sizeof(length), &length);
+			TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "rewriteStream : %d", res);
+
+			bool bMore = (iter != list.end());
+			res = write(bMore);
+			TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
+			if (bMore == false)
+				break;
+
+			// the next chunk is read as part of the same request
+			m_socketStream.endMessage(true);
+			if (m_bListStreaming == true && m_socketStream.getOutputSize() >= LIST_FLUSH_SIZE) {
+				// every chunk gets the whole timeout, a long list is not cut by the request deadline
+				m_socketStream.renewDeadline();
+				res = m_socketStream.flush();
+				TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "flush : %d", res);
+			}
+		}
 
 		return PRIV_FLTR_ERROR_SUCCESS;
 	}
 
-	int write(const int& in)
+	template<typename T>
+	int write(const std::list <T>* pList)
 	{
-		int length = sizeof(in);
-		int res = m_socketStream.writeStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-		res = m_socketStream.writeStream(length, &in);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-
-		return PRIV_FLTR_ERROR_SUCCESS;
+		return write(*pList);
 	}
 
-	int write(const bool& in)
+	// the reads and writes of a request wait for the peer at most timeoutMs altogether
+	void setTimeout(int timeoutMs)
 	{
-		int length = sizeof(in);
-		int res = m_socketStream.writeStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-		res = m_socketStream.writeStream(length, &in);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-
-		return PRIV_FLTR_ERROR_SUCCESS;
+		m_socketStream.setTimeout(timeoutMs);
 	}
 
-	int write(const char*& in)
+	void clearDeadline(void)
 	{
-		int length = strlen(in);
-		int res = m_socketStream.writeStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-		res = m_socketStream.writeStream(length, in);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-
-		return PRIV_FLTR_ERROR_SUCCESS;
+		m_socketStream.clearDeadline();
 	}
 
-	int write(const char* in_str, const int in_int1, const int in_int2)
+	// a readable cancelFd ends the waits of the connection
+	void setCancelFd(int cancelFd)
 	{
-		int res = 0;
-		res = write(in_str);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
-		res = write(in_int1);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
-		res = write(in_int2);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
-		return PRIV_FLTR_ERROR_SUCCESS;
+		m_socketStream.setCancelFd(cancelFd);
 	}
 
-	int write(const privacy_data_s& in)
+	// the process at the other end, from SO_PEERCRED
+	int getPeerCredentials(struct ucred* pCredentials) const
 	{
-		// privacy id
-		int length = strlen(in.privacy_id);
-		int res = 0;
-		res = m_socketStream.writeStream(sizeof(length), &length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-		res = m_socketStream.writeStream(length, in.privacy_id);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "writeStream : %d", res);
-
-		// monitor policy
-		res = write(in.monitor_policy);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
-
-		return PRIV_FLTR_ERROR_SUCCESS;
+		return m_socketStream.getPeerCredentials(pCredentials);
 	}
-	template<typename T, typename ...Args>
-	int write(const T* in, const Args&... args)
-	{
-		int res = write(in);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
-		res = write(args...);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
 
-		return PRIV_FLTR_ERROR_SUCCESS;
+	// receives the next message, the reads take their fields from it
+	int readMessage(void)
+	{
+		return m_socketStream.readMessage();
 	}
 
-	template<typename K, typename T>
-	int write(const std::pair<K, T> p)
+	// never waits, *pWholeRequest tells whether the next request is buffered
+	int receiveAvailable(bool* pWholeRequest)
 	{
-		int res = write(p.first);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
-		res = write(p.second);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
+		return m_socketStream.receiveAvailable(pWholeRequest);
+	}
 
-		return PRIV_FLTR_ERROR_SUCCESS;
+	// the next write starts a new message
+	void endMessage(void)
+	{
+		m_socketStream.endMessage();
 	}
 
-	template<typename K, typename T>
-	int write(const std::pair<K, T&> p)
+	// sends the messages written since the last flush, an open message is ended first
+	int flush(size_t* pSentBytes = NULL)
 	{
-		int res = write(p.first);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
-		res = write(p.second);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
+		return m_socketStream.flush(pSentBytes);
+	}
 
-		return PRIV_FLTR_ERROR_SUCCESS;
+	size_t getOutputSize(void) const
+	{
+		return m_socketStream.getOutputSize();
 	}
 
-	template<typename K, typename T>
-	int write(const std::pair<K, T&>* pPair)
+	bool hasBufferedMessage(void) const
 	{
-		return write(*pPair);
+		return m_socketStream.hasBufferedMessage();
 	}
 
-	template<typename T>
-	int write(const std::list <T> list)
+private:
+	template < typename F >
+	int readList(F readItem)
 	{
-		int length = list.size();
-		int res = write(length);
-		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
-		for (typename std::list <T>::const_iterator iter = list.begin(); iter != list.end(); iter++) {
-			res = write(*iter);
-			TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
+		bool bMore = true;
+		while (bMore == true)
+		{
+			const char* pLengthBytes = NULL;
+			int res = m_socketStream.readStream(sizeof(unsigned short), &pLengthBytes);
+			TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readStream : %d", res);
+			unsigned short length = 0;
+			memcpy(&length, pLengthBytes, sizeof(length));
+
+			for (unsigned short i = 0; i < length; ++i)
+			{
+				res = readItem();
+				TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "read : %d", res);
+			}
+
+			res = read(bMore);
+			TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "read : %d", res);
+
+			// the next chunk is the next message
+			if (bMore == true)
+			{
+				m_socketStream.renewDeadline();
+				res = readMessage();
+				TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "readMessage : %d", res);
+			}
 		}
 
 		return PRIV_FLTR_ERROR_SUCCESS;
 	}
 
-	template<typename T>
-	int write(const std::list <T>* pList)
-	{
-		return write(*pList);
-	}
-
-
-private:
+	static const size_t LIST_CHUNK_SIZE;
+	static const size_t LIST_FLUSH_SIZE;
 	SocketStream m_socketStream;
+	bool m_bListStreaming;
 };
 
 #endif // _SOCKETCONNECTION_H_
@@ -18,26 +18,169 @@
 #define _SOCKETSTREAM_H_
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <atomic>
+#include <chrono>
+#include <sys/types.h>
 #include "PrivacyGuardTypes.h"
 
+/*
+ * Messages are framed : a 4 byte length, the version of the wire format and the payload.
+ * A whole message is received into a reusable buffer, usually with one recv(),
+ * and its fields are read in place from there. A message of an unknown version
+ * is rejected before its payload is read. The top bit of the length is set when
+ * a list of the request goes on in the next message, so receiveAvailable() knows
+ * when a whole request is buffered without reading its fields.
+ * Written fields are gathered in an output buffer. endMessage() closes a message,
+ * flush() sends every message of the buffer with one send().
+ * The socket is non-blocking. When it isn't ready, reads and writes wait with poll()
+ * until the deadline of the request, which holds for all the waits together, and
+ * stop early when the cancel fd becomes readable. Without a deadline they wait
+ * as long as it takes.
+ * File descriptors passed with passFd() go with the next flush as SCM_RIGHTS, the
+ * received ones are kept in order until takeFd() and closed with the stream.
+ * A message is limited to MAX_BUFFER bytes, longer data is split over several
+ * messages by SocketConnection.
+ *
+ * Fields are encoded compactly, see WireFormat.h :
+ * - numbers are varints, 7 bits a byte with the low bits first
+ * - a string starts with a varint tag, (length << 1) followed by the bytes the first time
+ *   it is written in a message, (index << 1) | 1 when it is repeated, where index counts
+ *   the strings sent in full in the message before
+ */
+
+struct msghdr;
+struct ucred;
+
 class EXTERN_API SocketStream
 {
 public:
 	explicit SocketStream(int socket_fd)
 		: m_socketFd(socket_fd)
-		, m_bytesRead(0)
-		,m_bytesWrote(0)
+		, m_readOffset(0)
+		, m_messageEnd(0)
+		, m_dataEnd(0)
+		, m_messageStart(0)
+		, m_bMessageOpen(false)
+		, m_stringGeneration(0)
+		, m_writtenStringCount(0)
+		, m_internedStringCount(0)
+		, m_timeout(0)
+		, m_bDeadlineSet(false)
+		, m_cancelFd(-1)
 	{
 		LOGI("Created");
 	}
+	~SocketStream(void);
 
-	int readStream(size_t num, void * bytes);
+	// the waits from now on end after timeoutMs altogether
+	void setTimeout(int timeoutMs);
+	// a new timeout from now, for the next step of a long transfer
+	void renewDeadline(void);
+	void clearDeadline(void);
+	void setCancelFd(int cancelFd)
+	{
+		m_cancelFd = cancelFd;
+	}
+	// counted over all the streams of the process
+	static unsigned long getWaitCount(void)
+	{
+		return m_waitCount.load();
+	}
+	static unsigned long getExpiredDeadlineCount(void)
+	{
+		return m_expiredDeadlineCount.load();
+	}
+	static unsigned long getCancelledWaitCount(void)
+	{
+		return m_cancelledWaitCount.load();
+	}
+
+	// the fd stays open and owned by the caller, it is passed with the next flush
+	int passFd(int fd);
+	// the fd taken belongs to the caller
+	int takeFd(int* pFd);
+	int getPeerCredentials(struct ucred* pCredentials) const;
+
+	int readMessage(void);
+	// never waits : takes what the socket has until a whole request is buffered,
+	// or a request too long to buffer has started
+	int receiveAvailable(bool* pWholeRequest);
+	int readStream(size_t num, const char** ppBytes);
 	int writeStream(size_t num, const void * bytes);
+	// overwrites bytes written before, offset counts from the start of the output buffer
+	int rewriteStream(size_t offset, size_t num, const void* pBytes);
+	// bContinued : the request goes on in the next message
+	void endMessage(bool bContinued = false);
+	int writeVarint(unsigned long long value);
+	int readVarint(unsigned long long* pValue);
+	int writeString(const char* pChars, size_t length);
+	// ppChars points into the received message
+	int readString(const char** ppChars, size_t* pLength);
+	// pSentBytes tells how much reached the socket when the flush fails
+	int flush(size_t* pSentBytes = NULL);
+	size_t getOutputSize(void) const
+	{
+		return m_outputBuffer.size();
+	}
+	// the payload written so far to the open message
+	size_t getMessageSize(void) const
+	{
+		return m_bMessageOpen ? m_outputBuffer.size() - m_messageStart - MESSAGE_HEADER_SIZE : 0;
+	}
+	// a part of the next message has been received already
+	bool hasBufferedMessage(void) const
+	{
+		return m_dataEnd > m_messageEnd;
+	}
 private:
+	// a string written to the open message, for the later writes to refer to
+	struct StringSlot
+	{
+		unsigned int generation;
+		unsigned int hash;
+		unsigned int index;
+		size_t offset;
+		size_t length;
+	};
+
+	static const size_t MESSAGE_HEADER_SIZE;
+	static const size_t STRING_TABLE_SIZE;
+	static const size_t MIN_INTERNED_LENGTH;
+	static const size_t MAX_PASSED_FDS;
 	int throwWithErrnoMessage(std::string specificInfo);
+	void openMessage(void);
+	int receive(size_t num);
+	// one recvmsg() : the bytes received, 0 when the socket has none, -1 when it is closed
+	ssize_t receiveSome(void);
+	int send(size_t num, const void* pBytes, size_t* pSentBytes);
+	int waitFor(short events);
+	void keepPassedFds(struct msghdr* pMessage);
 	int m_socketFd;
-	int m_bytesRead;
-	int m_bytesWrote;
+	std::vector < char > m_inputBuffer;
+	size_t m_readOffset;
+	size_t m_messageEnd;
+	size_t m_dataEnd;
+	std::vector < char > m_outputBuffer;
+	size_t m_messageStart;
+	bool m_bMessageOpen;
+	// open addressing table, a slot of an older generation is free
+	std::vector < StringSlot > m_stringSlots;
+	unsigned int m_stringGeneration;
+	unsigned int m_writtenStringCount;
+	size_t m_internedStringCount;
+	std::vector < std::pair < const char*, size_t > > m_readStrings;
+	std::chrono::steady_clock::time_point m_deadline;
+	std::chrono::milliseconds m_timeout;
+	bool m_bDeadlineSet;
+	int m_cancelFd;
+	std::vector < int > m_fdsToPass;
+	std::deque < int > m_receivedFds;
+	static std::atomic < unsigned long > m_waitCount;
+	static std::atomic < unsigned long > m_expiredDeadlineCount;
+	static std::atomic < unsigned long > m_cancelledWaitCount;
 };
 
 #endif //_SOCKETSTREAM_H_
\ No newline at end of file
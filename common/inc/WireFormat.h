@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef _WIREFORMAT_H_
+#define _WIREFORMAT_H_
+
+#include <limits.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <dlog.h>
+#include "Utils.h"
+#include "SocketStream.h"
+#include "PrivacyGuardTypes.h"
+
+/*
+ * Type descriptors of the IPC fields. WireType<T> writes and reads a T with
+ * the primitives of SocketStream :
+ * - unsigned int is a varint
+ * - int is a zigzag encoded varint, small negative numbers stay short
+ * - bool is a varint of 0 or 1
+ * - std::string and char* are strings, repeated ones are sent as a reference
+ * - a structure is its fields in order, described with WireStruct and WireField
+ * - a FileDescriptor is passed beside the bytes, see SocketStream::passFd()
+ * A type without a descriptor doesn't compile when it is sent.
+ */
+
+template < typename T >
+struct WireType;
+
+template < >
+struct WireType < unsigned int >
+{
+	static int write(SocketStream& stream, const unsigned int& value)
+	{
+		return stream.writeVarint(value);
+	}
+
+	static int read(SocketStream& stream, unsigned int& value)
+	{
+		unsigned long long encoded = 0;
+		int res = stream.readVarint(&encoded);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, PRIV_FLTR_ERROR_IPC_ERROR, , "readVarint : %d", res);
+		TryReturn(encoded <= UINT_MAX, PRIV_FLTR_ERROR_IPC_ERROR, , "Invalid unsigned int : %llu", encoded);
+
+		value = (unsigned int)encoded;
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+};
+
+template < >
+struct WireType < int >
+{
+	static int write(SocketStream& stream, const int& value)
+	{
+		unsigned int zigzag = ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+		return stream.writeVarint(zigzag);
+	}
+
+	static int read(SocketStream& stream, int& value)
+	{
+		unsigned int zigzag = 0;
+		int res = WireType < unsigned int >::read(stream, zigzag);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "read : %d", res);
+
+		value = (int)((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+};
+
+template < >
+struct WireType < bool >
+{
+	static int write(SocketStream& stream, const bool& value)
+	{
+		return stream.writeVarint(value ? 1 : 0);
+	}
+
+	static int read(SocketStream& stream, bool& value)
+	{
+		unsigned long long encoded = 0;
+		int res = stream.readVarint(&encoded);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, PRIV_FLTR_ERROR_IPC_ERROR, , "readVarint : %d", res);
+		TryReturn(encoded <= 1, PRIV_FLTR_ERROR_IPC_ERROR, , "Invalid bool : %llu", encoded);
+
+		value = (encoded == 1);
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+};
+
+template < >
+struct WireType < std::string >
+{
+	static int write(SocketStream& stream, const std::string& value)
+	{
+		return stream.writeString(value.data(), value.size());
+	}
+
+	static int read(SocketStream& stream, std::string& value)
+	{
+		const char* pChars = NULL;
+		size_t length = 0;
+		int res = stream.readString(&pChars, &length);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, PRIV_FLTR_ERROR_IPC_ERROR, , "readString : %d", res);
+
+		value.assign(pChars, length);
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+};
+
+template < >
+struct WireType < const char* >
+{
+	static int write(SocketStream& stream, const char* const& value)
+	{
+		return stream.writeString(value, strlen(value));
+	}
+};
+
+// the string read is allocated with strndup(), the reader frees it
+template < >
+struct WireType < char* >
+{
+	static int write(SocketStream& stream, char* const& value)
+	{
+		return stream.writeString(value, strlen(value));
+	}
+
+	static int read(SocketStream& stream, char*& value)
+	{
+		const char* pChars = NULL;
+		size_t length = 0;
+		int res = stream.readString(&pChars, &length);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, PRIV_FLTR_ERROR_IPC_ERROR, , "readString : %d", res);
+
+		value = strndup(pChars, length);
+		TryReturn(value != NULL, PRIV_FLTR_ERROR_OUT_OF_MEMORY, , "strndup : %d", PRIV_FLTR_ERROR_OUT_OF_MEMORY);
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+};
+
+// a file descriptor passed to the peer, the message only holds a mark in its place.
+// The fd read is a new descriptor of the reader, who closes it.
+struct FileDescriptor
+{
+	int fd;
+};
+
+template < >
+struct WireType < FileDescriptor >
+{
+	static int write(SocketStream& stream, const FileDescriptor& value)
+	{
+		int res = stream.passFd(value.fd);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, PRIV_FLTR_ERROR_IPC_ERROR, , "passFd : %d", res);
+
+		return stream.writeVarint(1);
+	}
+
+	static int read(SocketStream& stream, FileDescriptor& value)
+	{
+		unsigned long long mark = 0;
+		int res = stream.readVarint(&mark);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS && mark == 1, PRIV_FLTR_ERROR_IPC_ERROR, , "Invalid file descriptor mark");
+
+		res = stream.takeFd(&value.fd);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, PRIV_FLTR_ERROR_IPC_ERROR, , "takeFd : %d", res);
+
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+};
+
+// a member of a structure, pMember is the pointer to it
+template < typename S, typename T, T S::*pMember >
+struct WireField
+{
+	static int write(SocketStream& stream, const S& value)
+	{
+		return WireType < T >::write(stream, value.*pMember);
+	}
+
+	static int read(SocketStream& stream, S& value)
+	{
+		return WireType < T >::read(stream, value.*pMember);
+	}
+};
+
+template < typename S, typename ...Fields >
+struct WireStruct;
+
+template < typename S >
+struct WireStruct < S >
+{
+	static int write(SocketStream& stream, const S& value)
+	{
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	static int read(SocketStream& stream, S& value)
+	{
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+};
+
+template < typename S, typename Field, typename ...Fields >
+struct WireStruct < S, Field, Fields... >
+{
+	static int write(SocketStream& stream, const S& value)
+	{
+		int res = Field::write(stream, value);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "write : %d", res);
+
+		return WireStruct < S, Fields... >::write(stream, value);
+	}
+
+	static int read(SocketStream& stream, S& value)
+	{
+		int res = Field::read(stream, value);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "read : %d", res);
+
+		return WireStruct < S, Fields... >::read(stream, value);
+	}
+};
+
+template < typename K, typename V >
+struct WireType < std::pair < K, V > >
+	: WireStruct < std::pair < K, V >,
+		WireField < std::pair < K, V >, K, &std::pair < K, V >::first >,
+		WireField < std::pair < K, V >, V, &std::pair < K, V >::second > >
+{
+};
+
+// the same encoding as std::pair < std::string, int >
+template < >
+struct WireType < privacy_data_s >
+	: WireStruct < privacy_data_s,
+		WireField < privacy_data_s, char*, &privacy_data_s::privacy_id >,
+		WireField < privacy_data_s, int, &privacy_data_s::monitor_policy > >
+{
+};
+
+#endif // _WIREFORMAT_H_
@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <dlog.h>
+#include "Utils.h"
+#include "AccessLogRing.h"
+
+// older C libraries know the system call but not its flags
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (1024 + 9)
+#define F_GET_SEALS (1024 + 10)
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+#define RING_MAGIC 0x50474c52
+#define RING_VERSION 1
+// a power of 2, 64 KB a client process
+#define RING_RECORD_COUNT 256
+#define RECORD_PACKAGE_ID_SIZE 160
+#define RECORD_PRIVACY_ID_SIZE 80
+#define CACHE_LINE_SIZE 64
+
+struct AccessLogRing::Header
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int recordCount;
+	unsigned int recordSize;
+	// moved by the client only
+	alignas(CACHE_LINE_SIZE) std::atomic < unsigned int > head;
+	// moved by the server only
+	alignas(CACHE_LINE_SIZE) std::atomic < unsigned int > tail;
+	// set by the server before it waits on the eventfd, cleared by the client that signals it
+	std::atomic < unsigned int > serverWaiting;
+};
+
+struct AccessLogRing::Record
+{
+	int userId;
+	int reserved;
+	long long useDate;
+	char packageId[RECORD_PACKAGE_ID_SIZE];
+	char privacyId[RECORD_PRIVACY_ID_SIZE];
+};
+
+struct AccessLogRing::Shared
+{
+	Header header;
+	Record records[RING_RECORD_COUNT];
+};
+
+// the indexes are shared with another process, they must not hide a lock
+static_assert(sizeof(std::atomic < unsigned int >) == sizeof(unsigned int), "atomic index is not lock-free");
+
+AccessLogRing::AccessLogRing(void)
+	: m_pShared(NULL)
+	, m_memoryFd(-1)
+	, m_eventFd(-1)
+	, m_hangupFd(-1)
+	, m_hangupWriteFd(-1)
+	, m_index(0)
+	, m_bBroken(false)
+{
+
+}
+
+AccessLogRing::~AccessLogRing(void)
+{
+	release();
+}
+
+void
+AccessLogRing::release(void)
+{
+	if (m_pShared != NULL)
+		munmap(m_pShared, sizeof(Shared));
+	m_pShared = NULL;
+
+	closePassedFds();
+	if (m_eventFd != -1)
+		close(m_eventFd);
+	m_eventFd = -1;
+	if (m_hangupWriteFd != -1)
+		close(m_hangupWriteFd);
+	m_hangupWriteFd = -1;
+}
+
+int
+AccessLogRing::create(void)
+{
+#ifdef __NR_memfd_create
+	m_memoryFd = syscall(__NR_memfd_create, "privacy_guard_access_log", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	TryReturn(m_memoryFd != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, , "memfd_create : %s", strerror(errno));
+#else
+	LOGI("memfd_create is not available");
+	return PRIV_FLTR_ERROR_SYSTEM_ERROR;
+#endif
+
+	int res = ftruncate(m_memoryFd, sizeof(Shared));
+	TryReturn(res == 0, PRIV_FLTR_ERROR_SYSTEM_ERROR, release(), "ftruncate : %s", strerror(errno));
+
+	// a file shrunk under the mapping of the server would fault it
+	res = fcntl(m_memoryFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+	TryReturn(res == 0, PRIV_FLTR_ERROR_SYSTEM_ERROR, release(), "fcntl : %s", strerror(errno));
+
+	void* pMemory = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, m_memoryFd, 0);
+	TryReturn(pMemory != MAP_FAILED, PRIV_FLTR_ERROR_SYSTEM_ERROR, release(), "mmap : %s", strerror(errno));
+	m_pShared = static_cast < Shared* > (pMemory);
+
+	// a new memfd is filled with zeros, the indexes and the flag start at 0
+	m_pShared->header.magic = RING_MAGIC;
+	m_pShared->header.version = RING_VERSION;
+	m_pShared->header.recordCount = RING_RECORD_COUNT;
+	m_pShared->header.recordSize = sizeof(Record);
+
+	m_eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	TryReturn(m_eventFd != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, release(), "eventfd : %s", strerror(errno));
+
+	int pipeFds[2];
+	res = pipe2(pipeFds, O_CLOEXEC);
+	TryReturn(res == 0, PRIV_FLTR_ERROR_SYSTEM_ERROR, release(), "pipe2 : %s", strerror(errno));
+	m_hangupFd = pipeFds[0];
+	m_hangupWriteFd = pipeFds[1];
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+void
+AccessLogRing::closePassedFds(void)
+{
+	if (m_memoryFd != -1)
+		close(m_memoryFd);
+	m_memoryFd = -1;
+	if (m_hangupFd != -1)
+		close(m_hangupFd);
+	m_hangupFd = -1;
+}
+
+bool
+AccessLogRing::push(const int userId, const std::string& packageId, const std::string& privacyId)
+{
+	if (m_pShared == NULL || packageId.size() >= RECORD_PACKAGE_ID_SIZE || privacyId.size() >= RECORD_PRIVACY_ID_SIZE)
+		return false;
+
+	Header& header = m_pShared->header;
+	unsigned int usedCount = m_index - header.tail.load(std::memory_order_acquire);
+	if (usedCount >= RING_RECORD_COUNT)
+		return false;
+
+	Record& record = m_pShared->records[m_index & (RING_RECORD_COUNT - 1)];
+	record.userId = userId;
+	record.useDate = time(NULL);
+	memcpy(record.packageId, packageId.c_str(), packageId.size() + 1);
+	memcpy(record.privacyId, privacyId.c_str(), privacyId.size() + 1);
+
+	// the record is published before the flag is read, see waitForPush()
+	++m_index;
+	header.head.store(m_index, std::memory_order_seq_cst);
+	// a ring half full wakes the server before its next round, a burst doesn't fill it
+	if ((header.serverWaiting.load(std::memory_order_seq_cst) != 0 && header.serverWaiting.exchange(0) != 0)
+			|| usedCount + 1 == RING_RECORD_COUNT / 2)
+	{
+		uint64_t wakeUp = 1;
+		if (write(m_eventFd, &wakeUp, sizeof(wakeUp)) == -1)
+			LOGE("write : %s", strerror(errno));
+	}
+
+	return true;
+}
+
+bool
+AccessLogRing::isReaderGone(void) const
+{
+	// the write end of a pipe without a reader polls as an error
+	pollfd hangupPollFd;
+	hangupPollFd.fd = m_hangupWriteFd;
+	hangupPollFd.events = 0;
+	hangupPollFd.revents = 0;
+
+	return poll(&hangupPollFd, 1, 0) == 1 && (hangupPollFd.revents & POLLERR) != 0;
+}
+
+int
+AccessLogRing::attach(int memoryFd, int eventFd, int hangupFd)
+{
+	m_memoryFd = memoryFd;
+	m_eventFd = eventFd;
+	m_hangupFd = hangupFd;
+
+	struct stat memoryStat;
+	int res = fstat(m_memoryFd, &memoryStat);
+	TryReturn(res == 0, PRIV_FLTR_ERROR_SYSTEM_ERROR, release(), "fstat : %s", strerror(errno));
+	TryReturn(memoryStat.st_size == (off_t)sizeof(Shared), PRIV_FLTR_ERROR_INVALID_PARAMETER, release(), "Invalid ring size : %lld", (long long)memoryStat.st_size);
+
+	// without the seal the client could still shrink the file
+	int seals = fcntl(m_memoryFd, F_GET_SEALS);
+	TryReturn(seals != -1 && (seals & F_SEAL_SHRINK) != 0, PRIV_FLTR_ERROR_INVALID_PARAMETER, release(), "The ring is not sealed");
+
+	void* pMemory = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED, m_memoryFd, 0);
+	TryReturn(pMemory != MAP_FAILED, PRIV_FLTR_ERROR_SYSTEM_ERROR, release(), "mmap : %s", strerror(errno));
+	m_pShared = static_cast < Shared* > (pMemory);
+
+	Header& header = m_pShared->header;
+	TryReturn(header.magic == RING_MAGIC && header.version == RING_VERSION && header.recordCount == RING_RECORD_COUNT
+			&& header.recordSize == sizeof(Record), PRIV_FLTR_ERROR_INVALID_PARAMETER, release(), "Unknown ring version : %u", header.version);
+
+	// the mapping is all the server needs of the memfd
+	close(m_memoryFd);
+	m_memoryFd = -1;
+	m_index = header.tail.load(std::memory_order_acquire);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+bool
+AccessLogRing::pop(int* pUserId, std::string* pPackageId, std::string* pPrivacyId, time_t* pUseDate)
+{
+	if (m_pShared == NULL || m_bBroken == true)
+		return false;
+
+	Header& header = m_pShared->header;
+	while (1)
+	{
+		unsigned int head = header.head.load(std::memory_order_acquire);
+		if (head == m_index)
+			return false;
+		if (head - m_index > RING_RECORD_COUNT)
+		{
+			LOGE("Broken ring, head : %u, tail : %u", head, m_index);
+			m_bBroken = true;
+			return false;
+		}
+
+		// the client may write to the slot meanwhile, only the copy is checked and read
+		Record record;
+		memcpy(&record, &m_pShared->records[m_index & (RING_RECORD_COUNT - 1)], sizeof(record));
+		++m_index;
+		header.tail.store(m_index, std::memory_order_release);
+
+		if (strnlen(record.packageId, sizeof(record.packageId)) == sizeof(record.packageId)
+				|| strnlen(record.privacyId, sizeof(record.privacyId)) == sizeof(record.privacyId) || record.useDate <= 0)
+		{
+			LOGE("Invalid record skipped");
+			continue;
+		}
+
+		*pUserId = record.userId;
+		pPackageId->assign(record.packageId);
+		pPrivacyId->assign(record.privacyId);
+		*pUseDate = (time_t)record.useDate;
+		return true;
+	}
+}
+
+bool
+AccessLogRing::waitForPush(void)
+{
+	if (m_pShared == NULL || m_bBroken == true)
+		return true;
+
+	Header& header = m_pShared->header;
+	header.serverWaiting.store(1, std::memory_order_seq_cst);
+	// a record pushed before the client could see the flag is not signalled
+	if (header.head.load(std::memory_order_seq_cst) != m_index)
+	{
+		header.serverWaiting.store(0, std::memory_order_relaxed);
+		return false;
+	}
+
+	return true;
+}
+
+void
+AccessLogRing::clearWakeUp(void)
+{
+	uint64_t wakeUpCount = 0;
+	if (read(m_eventFd, &wakeUpCount, sizeof(wakeUpCount)) == -1 && errno != EAGAIN)
+		LOGE("read : %s", strerror(errno));
+}
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <map>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dlog.h>
+#include "Utils.h"
+#include "MonitorPolicySnapshot.h"
+
+#define SNAPSHOT_MAGIC 0x5047504d
+#define SNAPSHOT_VERSION 1
+
+struct MonitorPolicySnapshot::Header
+{
+	unsigned int magic;
+	unsigned int version;
+	// one more than the file it replaced
+	unsigned int generation;
+	unsigned int recordCount;
+	unsigned int stringsSize;
+	// set by the server once a newer file took the path
+	std::atomic < unsigned int > replaced;
+};
+
+struct MonitorPolicySnapshot::Record
+{
+	int userId;
+	// offsets in the strings, which follow the records
+	unsigned int packageIdOffset;
+	unsigned int privacyIdOffset;
+	int monitorPolicy;
+};
+
+// the flag is shared with other processes, it must not hide a lock
+static_assert(sizeof(std::atomic < unsigned int >) == sizeof(unsigned int), "atomic flag is not lock-free");
+
+static int
+writeAll(int fd, const void* pData, size_t size)
+{
+	const char* pBuffer = static_cast < const char* > (pData);
+	while (size > 0)
+	{
+		ssize_t written = write(fd, pBuffer, size);
+		if (written == -1 && errno == EINTR)
+			continue;
+		TryReturn(written > 0, PRIV_FLTR_ERROR_IO_ERROR, , "write : %s", strerror(errno));
+		pBuffer += written;
+		size -= written;
+	}
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+MonitorPolicySnapshot::MonitorPolicySnapshot(void)
+	: m_pHeader(NULL)
+	, m_pRecords(NULL)
+	, m_pStrings(NULL)
+	, m_mappedSize(0)
+{
+
+}
+
+MonitorPolicySnapshot::~MonitorPolicySnapshot(void)
+{
+	if (m_pHeader != NULL)
+		munmap(const_cast < Header* > (m_pHeader), m_mappedSize);
+}
+
+int
+MonitorPolicySnapshot::open(const std::string& path)
+{
+	TryReturn(m_pHeader == NULL, PRIV_FLTR_ERROR_INVALID_STATE, , "already open");
+
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	TryReturn(fd != -1, PRIV_FLTR_ERROR_IO_ERROR, , "open : %s", strerror(errno));
+
+	struct stat fileStat;
+	int res = fstat(fd, &fileStat);
+	TryReturn(res == 0, PRIV_FLTR_ERROR_IO_ERROR, close(fd), "fstat : %s", strerror(errno));
+	TryReturn(fileStat.st_size >= (off_t)sizeof(Header), PRIV_FLTR_ERROR_INVALID_STATE, close(fd), "too short : %lld", (long long)fileStat.st_size);
+
+	// the server never changes a published file but for its flag, the mapping stays valid
+	size_t size = fileStat.st_size;
+	void* pMemory = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	TryReturn(pMemory != MAP_FAILED, PRIV_FLTR_ERROR_SYSTEM_ERROR, , "mmap : %s", strerror(errno));
+
+	const Header* pHeader = static_cast < const Header* > (pMemory);
+	// a count too large for the file fails the size check
+	size_t recordsSize = (size - sizeof(Header)) / sizeof(Record) < pHeader->recordCount ? size : (size_t)pHeader->recordCount * sizeof(Record);
+	bool bValid = pHeader->magic == SNAPSHOT_MAGIC && pHeader->version == SNAPSHOT_VERSION
+		&& sizeof(Header) + recordsSize + pHeader->stringsSize == size
+		// strcmp() stops at the last byte at worst
+		&& (pHeader->stringsSize == 0 ? pHeader->recordCount == 0 : static_cast < const char* > (pMemory)[size - 1] == '\0');
+	TryReturn(bValid, PRIV_FLTR_ERROR_INVALID_STATE, munmap(pMemory, size), "invalid snapshot : %s", path.c_str());
+
+	m_pHeader = pHeader;
+	m_pRecords = reinterpret_cast < const Record* > (pHeader + 1);
+	m_pStrings = reinterpret_cast < const char* > (m_pRecords + pHeader->recordCount);
+	m_mappedSize = size;
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+const char*
+MonitorPolicySnapshot::getString(const unsigned int offset) const
+{
+	// a bad offset only makes the lookup miss
+	if (offset >= m_pHeader->stringsSize)
+		return "";
+	return m_pStrings + offset;
+}
+
+int
+MonitorPolicySnapshot::compare(const Record& record, const int userId, const std::string& packageId, const std::string& privacyId) const
+{
+	if (record.userId != userId)
+		return record.userId < userId ? -1 : 1;
+	int res = strcmp(getString(record.packageIdOffset), packageId.c_str());
+	if (res != 0)
+		return res;
+	return strcmp(getString(record.privacyIdOffset), privacyId.c_str());
+}
+
+bool
+MonitorPolicySnapshot::find(const int userId, const std::string& packageId, const std::string& privacyId, int& monitorPolicy) const
+{
+	if (m_pHeader == NULL)
+		return false;
+
+	unsigned int low = 0;
+	unsigned int high = m_pHeader->recordCount;
+	while (low < high)
+	{
+		unsigned int middle = low + (high - low) / 2;
+		int res = compare(m_pRecords[middle], userId, packageId, privacyId);
+		if (res < 0)
+			low = middle + 1;
+		else if (res > 0)
+			high = middle;
+		else
+		{
+			monitorPolicy = m_pRecords[middle].monitorPolicy;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+MonitorPolicySnapshot::isReplaced(void) const
+{
+	return m_pHeader != NULL && m_pHeader->replaced.load(std::memory_order_acquire) != 0;
+}
+
+unsigned int
+MonitorPolicySnapshot::getGeneration(void) const
+{
+	return m_pHeader != NULL ? m_pHeader->generation : 0;
+}
+
+unsigned int
+MonitorPolicySnapshot::size(void) const
+{
+	return m_pHeader != NULL ? m_pHeader->recordCount : 0;
+}
+
+int
+MonitorPolicySnapshot::publish(const std::string& path, std::list < Policy >& policyList)
+{
+	// the order of find(), strcmp() orders the bytes as unsigned like std::string
+	policyList.sort([](const Policy& left, const Policy& right) {
+		if (left.userId != right.userId)
+			return left.userId < right.userId;
+		int res = left.packageId.compare(right.packageId);
+		if (res != 0)
+			return res < 0;
+		return left.privacyId.compare(right.privacyId) < 0;
+	});
+
+	// each distinct id is written once
+	std::vector < Record > records;
+	records.reserve(policyList.size());
+	std::map < std::string, unsigned int > stringOffsets;
+	std::string strings;
+	auto intern = [&stringOffsets, &strings](const std::string& value) {
+		std::map < std::string, unsigned int >::const_iterator iter = stringOffsets.find(value);
+		if (iter != stringOffsets.end())
+			return iter->second;
+		unsigned int offset = strings.size();
+		strings.append(value.c_str(), value.size() + 1);
+		stringOffsets[value] = offset;
+		return offset;
+	};
+	for (std::list < Policy >::const_iterator iter = policyList.begin(); iter != policyList.end(); ++iter)
+	{
+		// the same key twice would be found at random
+		if (!records.empty() && records.back().userId == iter->userId
+				&& strcmp(strings.c_str() + records.back().packageIdOffset, iter->packageId.c_str()) == 0
+				&& strcmp(strings.c_str() + records.back().privacyIdOffset, iter->privacyId.c_str()) == 0)
+			continue;
+		Record record;
+		record.userId = iter->userId;
+		record.packageIdOffset = intern(iter->packageId);
+		record.privacyIdOffset = intern(iter->privacyId);
+		record.monitorPolicy = iter->monitorPolicy;
+		records.push_back(record);
+	}
+
+	Header* pOldHeader = mapHeader(path);
+	unsigned int generation = 1;
+	if (pOldHeader != NULL && pOldHeader->magic == SNAPSHOT_MAGIC)
+		generation = pOldHeader->generation + 1;
+	// the clients must not keep the old policies, without a new file they ask the server
+	auto withdrawOld = [&path, &pOldHeader]() {
+		unlink(path.c_str());
+		setReplaced(pOldHeader);
+	};
+
+	Header header;
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.generation = generation;
+	header.recordCount = records.size();
+	header.stringsSize = strings.size();
+	header.replaced.store(0);
+
+	// a client maps either the old file or the whole new one, never a part
+	std::string newPath = path + ".new";
+	int fd = ::open(newPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	TryReturn(fd != -1, PRIV_FLTR_ERROR_IO_ERROR, withdrawOld(), "open : %s", strerror(errno));
+
+	int res = writeAll(fd, &header, sizeof(header));
+	if (res == PRIV_FLTR_ERROR_SUCCESS && !records.empty())
+		res = writeAll(fd, records.data(), records.size() * sizeof(Record));
+	if (res == PRIV_FLTR_ERROR_SUCCESS)
+		res = writeAll(fd, strings.data(), strings.size());
+	close(fd);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, unlink(newPath.c_str()); withdrawOld(), "writeAll : %d", res);
+
+	res = rename(newPath.c_str(), path.c_str());
+	TryReturn(res == 0, PRIV_FLTR_ERROR_IO_ERROR, unlink(newPath.c_str()); withdrawOld(), "rename : %s", strerror(errno));
+
+	// the path leads to the new file before a client sees the flag
+	setReplaced(pOldHeader);
+
+	PF_LOGD("monitor policy snapshot %u : %u policies", generation, header.recordCount);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+void
+MonitorPolicySnapshot::withdraw(const std::string& path)
+{
+	Header* pOldHeader = mapHeader(path);
+	// the path leads to no file before a client sees the flag
+	unlink(path.c_str());
+	setReplaced(pOldHeader);
+}
+
+MonitorPolicySnapshot::Header*
+MonitorPolicySnapshot::mapHeader(const std::string& path)
+{
+	// the file in place is flagged through a mapping of its own, the clients map the same pages
+	int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+	if (fd == -1)
+		return NULL;
+
+	void* pMemory = MAP_FAILED;
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) == 0 && fileStat.st_size >= (off_t)sizeof(Header))
+		pMemory = mmap(NULL, sizeof(Header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	return pMemory != MAP_FAILED ? static_cast < Header* > (pMemory) : NULL;
+}
+
+void
+MonitorPolicySnapshot::setReplaced(Header* pHeader)
+{
+	if (pHeader == NULL)
+		return;
+	pHeader->replaced.store(1, std::memory_order_release);
+	munmap(pHeader, sizeof(Header));
+}
@@ -16,10 +16,16 @@
 
 #include "SocketConnection.h"
 
+// a chunk of a list is closed once its message holds this many bytes, an item of up to
+// MAX_BUFFER - LIST_CHUNK_SIZE bytes still fits
+const size_t SocketConnection::LIST_CHUNK_SIZE = 4096;
+// a streamed list is sent whenever this much is written
+const size_t SocketConnection::LIST_FLUSH_SIZE = 16384;
+
 //
 // Note:
 //
-// The file here is left blank to enable precompilation
-// of templates in corresponding header file.
+// Apart from the constants, the file here is left blank to enable
+// precompilation of templates in corresponding header file.
 // Do not remove this file.
 //
@@ -16,7 +16,7 @@
 
 
 #include <sys/socket.h>
-#include <sys/select.h>
+#include <poll.h>
 #include <errno.h>
 #include <cstring>
 #include <unistd.h>
@@ -24,11 +24,138 @@
 #include "Utils.h"
 #include "SocketStream.h"
 
-#define READ_TIEMOUT_SEC 1
-#define READ_TIMEUOT_NSEC 0
-#define WRITE_TIMEOUT_SEC 0
-#define WRITE_TIMEOUT_NSEC 100000000
 #define MAX_BUFFER 10240
+// a whole message of the usual size fits in one recv()
+#define READ_BUFFER_SIZE 4096
+// the first byte of a message of the old format, with its length prefixed fields, is 4
+#define WIRE_FORMAT_VERSION 3
+// set in the length of a message when the request goes on in the next message
+#define MESSAGE_CONTINUED 0x80000000u
+// the bytes of a request buffered before a worker takes it, a longer one is read by the worker as it comes
+#define MAX_BUFFERED_REQUEST (64 * MAX_BUFFER)
+
+// the length and the version
+const size_t SocketStream::MESSAGE_HEADER_SIZE = sizeof(unsigned int) + 1;
+// at most half of it is used, a message of a few KB has fewer distinct strings
+const size_t SocketStream::STRING_TABLE_SIZE = 512;
+// a shorter string costs about as much as the reference to it
+const size_t SocketStream::MIN_INTERNED_LENGTH = 4;
+// file descriptors a stream passes with one flush, or holds unread
+const size_t SocketStream::MAX_PASSED_FDS = 4;
+
+static unsigned int
+hashString(const char* pChars, size_t length)
+{
+	// 8 bytes a step, the strings are mostly long package and privacy ids
+	unsigned long long hash = length;
+	size_t i = 0;
+	for (; i + sizeof(unsigned long long) <= length; i += sizeof(unsigned long long))
+	{
+		unsigned long long word = 0;
+		memcpy(&word, pChars + i, sizeof(word));
+		hash = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+		hash ^= hash >> 29;
+	}
+	for (; i < length; ++i)
+	{
+		hash = (hash ^ (unsigned char)pChars[i]) * 0x100000001b3ull;
+	}
+	hash ^= hash >> 32;
+	return (unsigned int)hash;
+}
+
+std::atomic < unsigned long > SocketStream::m_waitCount(0);
+std::atomic < unsigned long > SocketStream::m_expiredDeadlineCount(0);
+std::atomic < unsigned long > SocketStream::m_cancelledWaitCount(0);
+
+SocketStream::~SocketStream(void)
+{
+	// the passed file descriptors nobody took
+	for (std::deque < int >::iterator iter = m_receivedFds.begin(); iter != m_receivedFds.end(); ++iter)
+		close(*iter);
+}
+
+int
+SocketStream::passFd(int fd)
+{
+	TryReturn(m_fdsToPass.size() < MAX_PASSED_FDS, -1, , "Too many file descriptors to pass");
+
+	m_fdsToPass.push_back(fd);
+
+	return 0;
+}
+
+int
+SocketStream::takeFd(int* pFd)
+{
+	TryReturn(m_receivedFds.empty() == false, -1, , "No file descriptor passed");
+
+	*pFd = m_receivedFds.front();
+	m_receivedFds.pop_front();
+
+	return 0;
+}
+
+void
+SocketStream::keepPassedFds(struct msghdr* pMessage)
+{
+	if (pMessage->msg_flags & MSG_CTRUNC)
+		LOGE("Too many file descriptors passed, the kernel dropped some");
+
+	for (struct cmsghdr* pControl = CMSG_FIRSTHDR(pMessage); pControl != NULL; pControl = CMSG_NXTHDR(pMessage, pControl))
+	{
+		if (pControl->cmsg_level != SOL_SOCKET || pControl->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		size_t fdCount = (pControl->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (size_t i = 0; i < fdCount; ++i)
+		{
+			int fd = -1;
+			memcpy(&fd, CMSG_DATA(pControl) + i * sizeof(int), sizeof(fd));
+			// a peer can't make the process hold any number of descriptors
+			if (m_receivedFds.size() < MAX_PASSED_FDS)
+			{
+				m_receivedFds.push_back(fd);
+			}
+			else
+			{
+				LOGE("Too many file descriptors passed, %d is closed", fd);
+				close(fd);
+			}
+		}
+	}
+}
+
+int
+SocketStream::getPeerCredentials(struct ucred* pCredentials) const
+{
+	socklen_t length = sizeof(*pCredentials);
+	int res = getsockopt(m_socketFd, SOL_SOCKET, SO_PEERCRED, pCredentials, &length);
+	TryReturn(res == 0, -1, , "getsockopt : %s", strerror(errno));
+
+	return 0;
+}
+
+void
+SocketStream::setTimeout(int timeoutMs)
+{
+	m_timeout = std::chrono::milliseconds(timeoutMs);
+	m_deadline = std::chrono::steady_clock::now() + m_timeout;
+	m_bDeadlineSet = true;
+}
+
+void
+SocketStream::renewDeadline(void)
+{
+	if (m_bDeadlineSet == true)
+		m_deadline = std::chrono::steady_clock::now() + m_timeout;
+}
+
+void
+SocketStream::clearDeadline(void)
+{
+	m_bDeadlineSet = false;
+}
 
 int
 SocketStream::throwWithErrnoMessage(std::string function_name)
@@ -38,136 +165,504 @@ SocketStream::throwWithErrnoMessage(std::string function_name)
 }
 
 int
-SocketStream::readStream(size_t num, void* pBytes)
+SocketStream::readMessage(void)
 {
-	TryReturn(pBytes != NULL, -1, , "Null pointer to buffer");
+	// whatever the reader left of the previous message is skipped
+	m_readOffset = m_messageEnd;
+	if (m_readOffset == m_dataEnd)
+	{
+		m_readOffset = 0;
+		m_messageEnd = 0;
+		m_dataEnd = 0;
+	}
+
+	unsigned int length = 0;
+	int res = receive(sizeof(length));
+	TryReturn(res == 0, -1, , "receive : %d", res);
+
+	memcpy(&length, &m_inputBuffer[m_readOffset], sizeof(length));
+	length &= ~MESSAGE_CONTINUED;
+	TryReturn(length <= MAX_BUFFER, -1, , "Too big buffer requested!");
+	TryReturn(length >= MESSAGE_HEADER_SIZE - sizeof(length), -1, , "Invalid message length : %u", length);
 
-	m_bytesRead += num;
-	
-	TryReturn(m_bytesRead <= MAX_BUFFER, -1, , "Too big buffer requested!");
+	// the version follows the length, a peer of another format is dropped before its payload is read
+	res = receive(MESSAGE_HEADER_SIZE);
+	TryReturn(res == 0, -1, , "receive : %d", res);
 
-	char partBuffer[MAX_BUFFER];
-	std::string wholeBuffer;
+	unsigned char version = m_inputBuffer[m_readOffset + sizeof(length)];
+	TryReturn(version == WIRE_FORMAT_VERSION, -1, , "Unknown wire format version : %d", version);
 
-	fd_set rset, allset;
-	int maxFd;
-	ssize_t bytesRead = 0;
-	ssize_t bytesToRead = (ssize_t) num;
+	res = receive(sizeof(length) + length);
+	TryReturn(res == 0, -1, , "receive : %d", res);
 
-	timespec timeout;
+	m_messageEnd = m_readOffset + sizeof(length) + length;
+	m_readOffset += MESSAGE_HEADER_SIZE;
+	m_readStrings.clear();
 
-	maxFd = m_socketFd;
-	++maxFd;
+	return 0;
+}
+
+int
+SocketStream::readStream(size_t num, const char** ppBytes)
+{
+	TryReturn(ppBytes != NULL, -1, , "Null pointer to buffer");
+	TryReturn(num <= m_messageEnd - m_readOffset, -1, , "Couldn't read whole data");
 
-	FD_ZERO(&allset);
-	FD_SET(m_socketFd, &allset);
+	*ppBytes = &m_inputBuffer[0] + m_readOffset;
+	m_readOffset += num;
 
-	int ret = -1;
+	return 0;
+}
 
-	while(bytesToRead != 0)
+int
+SocketStream::receive(size_t num)
+{
+	// move the unread bytes to the front instead of growing the buffer
+	if (m_readOffset > 0 && m_readOffset + num > m_inputBuffer.size())
+	{
+		memmove(&m_inputBuffer[0], &m_inputBuffer[m_readOffset], m_dataEnd - m_readOffset);
+		m_dataEnd -= m_readOffset;
+		m_readOffset = 0;
+		m_messageEnd = 0;
+	}
+	if (m_readOffset + num > m_inputBuffer.size())
 	{
-		timeout.tv_sec = READ_TIEMOUT_SEC;
-		timeout.tv_nsec = READ_TIMEUOT_NSEC;
-		rset = allset;
+		m_inputBuffer.resize(m_readOffset + num > READ_BUFFER_SIZE ? m_readOffset + num : READ_BUFFER_SIZE);
+	}
 
-		if ( (ret = pselect(maxFd, &rset, NULL, NULL, &timeout, NULL)) == -1 )
-		{
-			if (errno == EINTR)
-				continue;
-			LOGD("pselect : %s", strerror(errno));
+	while(m_dataEnd - m_readOffset < num)
+	{
+		ssize_t bytesRead = receiveSome();
+		if (bytesRead == -1)
 			return -1;
-		}
-		//This means pselect got timedout
-		//This is not a proper behavior in reading data from UDS
-		//And could mean we got corrupted connection
-		TryReturn(ret != 0, -1, , "Couldn't read whole data");
+		if (bytesRead > 0)
+			continue;
+
+		int res = waitFor(POLLIN);
+		TryReturn(res == 0, -1, , "Couldn't read whole data");
+	}
+
+	return 0;
+}
 
-		if ( FD_ISSET(m_socketFd, &rset) )
+int
+SocketStream::receiveAvailable(bool* pWholeRequest)
+{
+	*pWholeRequest = false;
+
+	// the message read last is done with, what follows it moves to the front
+	if (m_messageEnd > 0)
+	{
+		memmove(&m_inputBuffer[0], &m_inputBuffer[m_messageEnd], m_dataEnd - m_messageEnd);
+		m_dataEnd -= m_messageEnd;
+		m_readOffset = 0;
+		m_messageEnd = 0;
+	}
+
+	while (1)
+	{
+		// walk the buffered messages up to the one that ends the request
+		size_t offset = 0;
+		size_t needed = MESSAGE_HEADER_SIZE;
+		while (m_dataEnd - offset >= MESSAGE_HEADER_SIZE)
 		{
-			bytesRead = read(m_socketFd, partBuffer, num);
-			if ( bytesRead <= 0 )
+			unsigned int length = 0;
+			memcpy(&length, &m_inputBuffer[offset], sizeof(length));
+			bool bContinued = (length & MESSAGE_CONTINUED) != 0;
+			length &= ~MESSAGE_CONTINUED;
+			TryReturn(length <= MAX_BUFFER && length >= MESSAGE_HEADER_SIZE - sizeof(length), -1, , "Invalid message length : %u", length);
+
+			unsigned char version = m_inputBuffer[offset + sizeof(length)];
+			TryReturn(version == WIRE_FORMAT_VERSION, -1, , "Unknown wire format version : %d", version);
+
+			if (m_dataEnd - offset < sizeof(length) + length)
+			{
+				needed = offset + sizeof(length) + length;
+				break;
+			}
+
+			offset += sizeof(length) + length;
+			if (bContinued == false)
 			{
-				if(errno == ECONNRESET || errno == ENOTCONN || errno == ETIMEDOUT)
-				{
-					LOGI("Connection closed : %s", strerror(errno));
-					return -1;
-				}
-				else if (errno != EAGAIN && errno != EWOULDBLOCK){
-					LOGI("read()");
-					return -1;
-				}
+				*pWholeRequest = true;
+				return 0;
 			}
+			needed = offset + MESSAGE_HEADER_SIZE;
+		}
+
+		if (m_dataEnd >= MAX_BUFFERED_REQUEST)
+		{
+			*pWholeRequest = true;
+			return 0;
+		}
+
+		if (needed > m_inputBuffer.size())
+		{
+			m_inputBuffer.resize(needed > READ_BUFFER_SIZE ? needed : READ_BUFFER_SIZE);
+		}
+
+		ssize_t bytesRead = receiveSome();
+		// a client closing between two requests is left to the hang up event
+		if (bytesRead == -1)
+			return m_dataEnd == 0 ? 0 : -1;
+		if (bytesRead == 0)
+			return 0;
+	}
+}
 
-			wholeBuffer.append(partBuffer, bytesRead);
-			bytesToRead -= bytesRead;
-			bytesRead = 0;
+ssize_t
+SocketStream::receiveSome(void)
+{
+	while (1)
+	{
+		// take everything the socket has, the following messages are kept for the next reads
+		struct iovec inputVector;
+		inputVector.iov_base = &m_inputBuffer[m_dataEnd];
+		inputVector.iov_len = m_inputBuffer.size() - m_dataEnd;
+		// file descriptors passed by the peer come as a control message
+		char control[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)];
+		struct msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = &inputVector;
+		message.msg_iovlen = 1;
+		message.msg_control = control;
+		message.msg_controllen = sizeof(control);
+		ssize_t bytesRead = recvmsg(m_socketFd, &message, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+		if ( bytesRead > 0 )
+		{
+			if (message.msg_controllen > 0)
+				keepPassedFds(&message);
+			m_dataEnd += bytesRead;
+			return bytesRead;
+		}
+		if ( bytesRead == 0 )
+		{
+			LOGI("Connection closed by peer");
+			return -1;
+		}
+		if(errno == ECONNRESET || errno == ENOTCONN || errno == ETIMEDOUT)
+		{
+			LOGI("Connection closed : %s", strerror(errno));
+			return -1;
+		}
+		else if (errno == EINTR)
+		{
 			continue;
 		}
+		else if (errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			LOGI("recv()");
+			return -1;
+		}
 
+		return 0;
 	}
-	memcpy(pBytes, wholeBuffer.c_str(), num);
-	
-	return 0;
+}
+
+void
+SocketStream::openMessage(void)
+{
+	// room for the length of the message, filled in by endMessage()
+	m_messageStart = m_outputBuffer.size();
+	m_outputBuffer.resize(m_messageStart + MESSAGE_HEADER_SIZE);
+	m_outputBuffer[m_messageStart + sizeof(unsigned int)] = WIRE_FORMAT_VERSION;
+	m_bMessageOpen = true;
+
+	// the strings of the previous messages can't be referred to
+	if (++m_stringGeneration == 0)
+	{
+		m_stringSlots.assign(m_stringSlots.size(), StringSlot());
+		m_stringGeneration = 1;
+	}
+	m_writtenStringCount = 0;
+	m_internedStringCount = 0;
 }
 
 int
 SocketStream::writeStream(size_t num, const void* pBytes)
 {
 	TryReturn(pBytes != NULL, -1, , "Null pointer to buffer");
-	
-	m_bytesWrote += num;
-	
-	TryReturn(m_bytesRead <= MAX_BUFFER, -1, , "Too big buffer requested!");
 
-	fd_set wset, allset;
-	int maxFd;
+	if (m_bMessageOpen == false)
+		openMessage();
 
-	timespec timeout;
+	TryReturn(m_outputBuffer.size() - m_messageStart - sizeof(unsigned int) + num <= MAX_BUFFER, -1, , "Too big buffer requested!");
 
-	maxFd = m_socketFd;
-	++maxFd;
+	const char* pChars = reinterpret_cast<const char *>(pBytes);
+	m_outputBuffer.insert(m_outputBuffer.end(), pChars, pChars + num);
 
-	FD_ZERO(&allset);
-	FD_SET(m_socketFd, &allset);
-
-	int res;
-	int writeRes;
-	int bytesToWrite = num;
-	unsigned int currentOffset = 0;
+	return 0;
+}
 
-	while(currentOffset != num)
+int
+SocketStream::writeVarint(unsigned long long value)
+{
+	char bytes[10];
+	size_t num = 0;
+	while (value >= 0x80)
 	{
-		timeout.tv_sec = WRITE_TIMEOUT_SEC;
-		timeout.tv_nsec = WRITE_TIMEOUT_NSEC;
-		wset = allset;
+		bytes[num++] = (char)(value | 0x80);
+		value >>= 7;
+	}
+	bytes[num++] = (char)value;
+
+	return writeStream(num, bytes);
+}
 
-		if ( (res = pselect(maxFd, NULL, &wset, NULL, &timeout, NULL)) == -1 )
+int
+SocketStream::readVarint(unsigned long long* pValue)
+{
+	unsigned long long value = 0;
+	int shift = 0;
+	for (size_t offset = m_readOffset; offset < m_messageEnd && shift < 64; ++offset, shift += 7)
+	{
+		unsigned char byte = m_inputBuffer[offset];
+		value |= (unsigned long long)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
 		{
-			if(errno == EINTR)
-				continue;
-			LOGD("pselect : %s", strerror(errno));
-			return -1;
+			m_readOffset = offset + 1;
+			*pValue = value;
+			return 0;
 		}
+	}
+
+	LOGE("Invalid varint");
+	return -1;
+}
 
-		if(FD_ISSET(m_socketFd, &wset))
+int
+SocketStream::writeString(const char* pChars, size_t length)
+{
+	TryReturn(pChars != NULL, -1, , "Null pointer to string");
+
+	if (m_bMessageOpen == false)
+		openMessage();
+
+	StringSlot* pFreeSlot = NULL;
+	unsigned int hash = 0;
+	if (length >= MIN_INTERNED_LENGTH && m_internedStringCount < STRING_TABLE_SIZE / 2)
+	{
+		if (m_stringSlots.empty())
+			m_stringSlots.resize(STRING_TABLE_SIZE, StringSlot());
+
+		hash = hashString(pChars, length);
+		for (size_t i = hash & (STRING_TABLE_SIZE - 1); pFreeSlot == NULL; i = (i + 1) & (STRING_TABLE_SIZE - 1))
 		{
-			if ( (writeRes = write(m_socketFd, reinterpret_cast<const char *>(pBytes) + currentOffset, bytesToWrite)) == -1)
+			StringSlot& slot = m_stringSlots[i];
+			if (slot.generation != m_stringGeneration)
+			{
+				pFreeSlot = &slot;
+			}
+			else if (slot.hash == hash && slot.length == length && memcmp(&m_outputBuffer[slot.offset], pChars, length) == 0)
 			{
-				if(errno == ECONNRESET || errno == EPIPE)
-				{
-					LOGI("Connection closed : %s", strerror(errno));
-					return -1;
-
-				}
-				else if(errno != EAGAIN && errno != EWOULDBLOCK)
-				{
-					LOGE("write()");
-					return -1;
-				}
+				return writeVarint(((unsigned long long)slot.index << 1) | 1);
 			}
+		}
+	}
+
+	int res = writeVarint((unsigned long long)length << 1);
+	TryReturn(res == 0, -1, , "writeVarint : %d", res);
+
+	size_t offset = m_outputBuffer.size();
+	res = writeStream(length, pChars);
+	TryReturn(res == 0, -1, , "writeStream : %d", res);
+
+	if (pFreeSlot != NULL)
+	{
+		pFreeSlot->generation = m_stringGeneration;
+		pFreeSlot->hash = hash;
+		pFreeSlot->index = m_writtenStringCount;
+		pFreeSlot->offset = offset;
+		pFreeSlot->length = length;
+		++m_internedStringCount;
+	}
+	++m_writtenStringCount;
+
+	return 0;
+}
+
+int
+SocketStream::readString(const char** ppChars, size_t* pLength)
+{
+	unsigned long long tag = 0;
+	int res = readVarint(&tag);
+	TryReturn(res == 0, -1, , "readVarint : %d", res);
+
+	if (tag & 1)
+	{
+		unsigned long long index = tag >> 1;
+		TryReturn(index < m_readStrings.size(), -1, , "Invalid string reference : %llu", index);
+
+		*ppChars = m_readStrings[index].first;
+		*pLength = m_readStrings[index].second;
+		return 0;
+	}
+
+	unsigned long long length = tag >> 1;
+	TryReturn(length <= m_messageEnd - m_readOffset, -1, , "Couldn't read whole data");
+
+	res = readStream(length, ppChars);
+	TryReturn(res == 0, -1, , "readStream : %d", res);
+
+	*pLength = length;
+	m_readStrings.push_back(std::make_pair(*ppChars, (size_t)length));
+
+	return 0;
+}
+
+int
+SocketStream::rewriteStream(size_t offset, size_t num, const void* pBytes)
+{
+	TryReturn(pBytes != NULL, -1, , "Null pointer to buffer");
+	TryReturn(offset + num <= m_outputBuffer.size(), -1, , "Rewrite out of the output buffer");
+
+	memcpy(&m_outputBuffer[offset], pBytes, num);
+
+	return 0;
+}
+
+void
+SocketStream::endMessage(bool bContinued)
+{
+	if (m_bMessageOpen == false)
+		return;
+
+	// the length covers the version byte
+	unsigned int length = m_outputBuffer.size() - m_messageStart - sizeof(length);
+	if (bContinued == true)
+		length |= MESSAGE_CONTINUED;
+	memcpy(&m_outputBuffer[m_messageStart], &length, sizeof(length));
+	m_bMessageOpen = false;
+}
+
+int
+SocketStream::flush(size_t* pSentBytes)
+{
+	endMessage();
+
+	size_t sentBytes = 0;
+	int res = 0;
+
+	// all the messages written since the last flush go out together
+	if (m_outputBuffer.empty() == false)
+		res = send(m_outputBuffer.size(), &m_outputBuffer[0], &sentBytes);
+
+	if (pSentBytes != NULL)
+		*pSentBytes = sentBytes;
+
+	// the capacity is kept for the next message
+	m_outputBuffer.clear();
+	m_fdsToPass.clear();
+
+	return res;
+}
+
+int
+SocketStream::send(size_t num, const void* pBytes, size_t* pSentBytes)
+{
+	size_t& currentOffset = *pSentBytes;
+	currentOffset = 0;
+
+	while(currentOffset != num)
+	{
+		struct iovec outputVector;
+		outputVector.iov_base = const_cast < char* > (reinterpret_cast<const char *>(pBytes) + currentOffset);
+		outputVector.iov_len = num - currentOffset;
+		char control[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)];
+		struct msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = &outputVector;
+		message.msg_iovlen = 1;
+		// the file descriptors go with the first bytes sent
+		if (m_fdsToPass.empty() == false)
+		{
+			memset(control, 0, sizeof(control));
+			message.msg_control = control;
+			message.msg_controllen = CMSG_SPACE(sizeof(int) * m_fdsToPass.size());
+			struct cmsghdr* pControl = CMSG_FIRSTHDR(&message);
+			pControl->cmsg_level = SOL_SOCKET;
+			pControl->cmsg_type = SCM_RIGHTS;
+			pControl->cmsg_len = CMSG_LEN(sizeof(int) * m_fdsToPass.size());
+			memcpy(CMSG_DATA(pControl), &m_fdsToPass[0], sizeof(int) * m_fdsToPass.size());
+		}
+		ssize_t writeRes = sendmsg(m_socketFd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (writeRes >= 0)
+		{
 			currentOffset += writeRes;
-			bytesToWrite -= writeRes;
+			m_fdsToPass.clear();
+			continue;
+		}
+		if(errno == ECONNRESET || errno == EPIPE)
+		{
+			LOGI("Connection closed : %s", strerror(errno));
+			return -1;
+		}
+		else if (errno == EINTR)
+		{
+			continue;
+		}
+		else if(errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			LOGE("send()");
+			return -1;
 		}
+
+		int res = waitFor(POLLOUT);
+		TryReturn(res == 0, -1, , "Couldn't send whole data");
 	}
 	return 0;
-}
\ No newline at end of file
+}
+
+int
+SocketStream::waitFor(short events)
+{
+	pollfd pollFds[2];
+	pollFds[0].fd = m_socketFd;
+	pollFds[0].events = events;
+	pollFds[1].fd = m_cancelFd;
+	pollFds[1].events = POLLIN;
+	nfds_t pollFdCount = (m_cancelFd != -1) ? 2 : 1;
+
+	++m_waitCount;
+
+	while (1)
+	{
+		// the remaining time is taken again after every wake up, the deadline holds for the whole request
+		int timeoutMs = -1;
+		if (m_bDeadlineSet == true)
+		{
+			std::chrono::steady_clock::duration remaining = m_deadline - std::chrono::steady_clock::now();
+			if (remaining <= std::chrono::steady_clock::duration::zero())
+			{
+				++m_expiredDeadlineCount;
+				LOGE("Deadline expired, %lu deadlines expired so far", m_expiredDeadlineCount.load());
+				return -1;
+			}
+			// rounded up, a wake up before the deadline would only poll again
+			timeoutMs = (std::chrono::duration_cast<std::chrono::microseconds>(remaining).count() + 999) / 1000;
+		}
+
+		pollFds[0].revents = 0;
+		pollFds[1].revents = 0;
+		int ret = poll(pollFds, pollFdCount, timeoutMs);
+		if (ret == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			LOGE("poll : %s", strerror(errno));
+			return -1;
+		}
+		if (ret == 0)
+			continue;
+
+		if (pollFdCount == 2 && pollFds[1].revents != 0)
+		{
+			++m_cancelledWaitCount;
+			LOGI("Wait cancelled");
+			return -1;
+		}
+
+		// a hang up or an error is reported by the next recv() or send()
+		return 0;
+	}
+}
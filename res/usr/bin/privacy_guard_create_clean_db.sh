@@ -18,15 +18,14 @@ for name in privacy_guard
 do
     rm -f ${TZ_SYS_DB}/.$name.db
     rm -f ${TZ_SYS_DB}/.$name.db-journal
-    SQL="PRAGMA journal_mode = PERSIST;"
+    rm -f ${TZ_SYS_DB}/.$name.db-wal
+    rm -f ${TZ_SYS_DB}/.$name.db-shm
+    SQL="PRAGMA auto_vacuum = INCREMENTAL; PRAGMA journal_mode = WAL;"
     sqlite3 ${TZ_SYS_DB}/.$name.db "$SQL"
     SQL=".read ${TZ_SYS_BIN}/"$name"_db.sql"
     sqlite3 ${TZ_SYS_DB}/.$name.db "$SQL"
-    touch ${TZ_SYS_DB}/.$name.db-journal
     chown root:root ${TZ_SYS_DB}/.$name.db
-    chown root:root ${TZ_SYS_DB}/.$name.db-journal
     chmod 666 ${TZ_SYS_DB}/.$name.db
-    chmod 666 ${TZ_SYS_DB}/.$name.db-journal
 done
 
 
@@ -1,12 +1,44 @@
 PRAGMA foreign_keys = ON; BEGIN TRANSACTION;
 
+CREATE TABLE Package(
+	PKG_KEY INTEGER PRIMARY KEY,
+	PKG_ID TEXT not null UNIQUE
+CHECK(1) );
+
+CREATE TABLE Privacy(
+	PRIVACY_KEY INTEGER PRIMARY KEY,
+	PRIVACY_ID TEXT not null UNIQUE
+CHECK(1) );
+
 CREATE TABLE StatisticsMonitorInfo(
 	USER_ID INTEGER not null,
-	PKG_ID TEXT not null,
-	PRIVACY_ID TEXT not null,
+	PKG_KEY INTEGER not null,
+	PRIVACY_KEY INTEGER not null,
 	USE_DATE INTEGER not null,
 CHECK(1) );
 
+CREATE INDEX StatisticsMonitorInfo_USER_DATE ON StatisticsMonitorInfo(USER_ID, USE_DATE, PKG_KEY, PRIVACY_KEY);
+CREATE INDEX StatisticsMonitorInfo_USER_PKG_DATE ON StatisticsMonitorInfo(USER_ID, PKG_KEY, USE_DATE, PRIVACY_KEY);
+CREATE INDEX StatisticsMonitorInfo_USER_PRIVACY_DATE ON StatisticsMonitorInfo(USER_ID, PRIVACY_KEY, USE_DATE, PKG_KEY);
+
+CREATE TABLE StatisticsDailyCount(
+	USER_ID INTEGER not null,
+	PKG_KEY INTEGER not null,
+	PRIVACY_KEY INTEGER not null,
+	USE_DAY INTEGER not null,
+	USE_COUNT INTEGER not null,
+	PRIMARY KEY(USER_ID, USE_DAY, PKG_KEY, PRIVACY_KEY)
+CHECK(1) ) WITHOUT ROWID;
+
+CREATE INDEX StatisticsDailyCount_USER_PKG_DAY ON StatisticsDailyCount(USER_ID, PKG_KEY, USE_DAY, PRIVACY_KEY, USE_COUNT);
+CREATE INDEX StatisticsDailyCount_USER_PRIVACY_DAY ON StatisticsDailyCount(USER_ID, PRIVACY_KEY, USE_DAY, PKG_KEY, USE_COUNT);
+
+CREATE TRIGGER StatisticsMonitorInfo_DAILY_COUNT AFTER INSERT ON StatisticsMonitorInfo
+BEGIN
+	INSERT OR IGNORE INTO StatisticsDailyCount(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DAY, USE_COUNT) VALUES(NEW.USER_ID, NEW.PKG_KEY, NEW.PRIVACY_KEY, NEW.USE_DATE/86400, 0);
+	UPDATE StatisticsDailyCount SET USE_COUNT=USE_COUNT+1 WHERE USER_ID=NEW.USER_ID AND USE_DAY=NEW.USE_DATE/86400 AND PKG_KEY=NEW.PKG_KEY AND PRIVACY_KEY=NEW.PRIVACY_KEY;
+END;
+
 CREATE TABLE MonitorPolicy(
 	USER_ID INTEGER not null,
 	PKG_ID TEXT not null,
@@ -15,6 +47,8 @@ CREATE TABLE MonitorPolicy(
 	PRIMARY KEY(USER_ID, PKG_ID, PRIVACY_ID)
 CHECK(1) );
 
+CREATE INDEX MonitorPolicy_USER_PRIVACY ON MonitorPolicy(USER_ID, PRIVACY_ID, PKG_ID);
+
 CREATE TABLE MainMonitorPolicy(
 	USER_ID INTEGER not null,
 	MAIN_MONITOR_POLICY BOOLEAN DEFAULT FALSE,
@@ -23,4 +57,5 @@ CHECK(1) );
 
 COMMIT;
 BEGIN TRANSACTION; 
-CREATE TABLE DB_VERSION_0_1 (version INT); COMMIT;
+CREATE TABLE DB_VERSION_0_1 (version INT);
+INSERT INTO DB_VERSION_0_1(version) VALUES(4); COMMIT;
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef _ACCESSLOGQUEUE_H_
+#define _ACCESSLOGQUEUE_H_
+
+#include <string>
+#include <list>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+#include "PrivacyGuardDb.h"
+
+// Write-behind queue of the access logs. IPC threads push the logs and return,
+// a writer thread stores them in large transactions.
+class AccessLogQueue
+{
+private:
+	static const size_t MAX_QUEUE_SIZE;
+	static const size_t WRITE_BATCH_SIZE;
+	static const int WRITE_DELAY_MS;
+	static const int PUSH_TIMEOUT_MS;
+	static std::mutex m_singletonMutex;
+	static AccessLogQueue* m_pInstance;
+	pthread_t m_writerThread;
+	bool m_bStarted;
+	bool m_bStopRequested;
+	std::deque < access_log_s > m_logQueue;
+	std::mutex m_queueMutex;
+	std::condition_variable m_notEmptyCondition;
+	std::condition_variable m_notFullCondition;
+
+private:
+	AccessLogQueue(void);
+	~AccessLogQueue(void);
+	static void* writerThread(void* pData);
+	void mainloop(void);
+
+public:
+	static AccessLogQueue* getInstance(void);
+	int start(void);
+	int stop(void);
+	int push(const int userId, const std::list < std::pair < std::string, std::string > >& logInfoList);
+	// the logs are stamped already
+	int push(const std::list < access_log_s >& logList);
+};
+
+#endif //_ACCESSLOGQUEUE_H_
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef _ACCESSLOGRINGSERVICE_H_
+#define _ACCESSLOGRINGSERVICE_H_
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <sys/types.h>
+#include "AccessLogRing.h"
+#include "PrivacyGuardDb.h"
+
+struct ucred;
+
+// Drains the access log rings of the client processes into the AccessLogQueue.
+// A ring is known by the pid of its client, taken from SO_PEERCRED, and dropped
+// once the client is gone and its last records are read.
+class AccessLogRingService
+{
+private:
+	struct RingInfo
+	{
+		std::unique_ptr < AccessLogRing > pRing;
+		uid_t userId;
+		// the ring gave no record in the last round and waits for a push
+		bool bWaiting;
+	};
+
+	static const size_t MAX_RING_COUNT;
+	static const int MAX_EPOLL_EVENTS;
+	static const int DRAIN_INTERVAL_MS;
+	static const size_t DRAIN_BATCH_SIZE;
+	static const int MAX_RECORD_AGE_S;
+	static std::mutex m_singletonMutex;
+	static AccessLogRingService* m_pInstance;
+	pthread_t m_drainThread;
+	bool m_bStarted;
+	int m_epollFd;
+	int m_stopEventFd;
+	std::map < pid_t, std::shared_ptr < RingInfo > > m_ringMap;
+	std::mutex m_ringMutex;
+
+private:
+	AccessLogRingService(void);
+	~AccessLogRingService(void);
+	static void* drainThread(void* pData);
+	void mainloop(void);
+	size_t drainRing(RingInfo& ringInfo, std::list < access_log_s >& logList);
+	bool drainRings(std::list < access_log_s >& logList);
+	void removeRing(pid_t pid);
+
+public:
+	static AccessLogRingService* getInstance(void);
+	int start(void);
+	int stop(void);
+	// the fds belong to the service from now on, even when it fails
+	int addRing(const struct ucred& credentials, int memoryFd, int eventFd, int hangupFd);
+};
+
+#endif //_ACCESSLOGRINGSERVICE_H_
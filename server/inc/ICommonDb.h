@@ -17,6 +17,7 @@
 #ifndef _ICOMMONDB_H_
 #define _ICOMMONDB_H_
 
+#include <atomic>
 #include "PrivacyGuardCommon.h"
 
 class ICommonDb
@@ -25,12 +26,11 @@ public:
 
 	std::mutex m_dbMutex;
 	sqlite3* m_sqlHandler;
-	sqlite3_stmt* m_stmt;
-	bool m_bDBOpen;
+	// read by the readers without m_dbMutex
+	std::atomic < bool > m_bDBOpen;
 
 	ICommonDb() {
 		m_sqlHandler = NULL;
-		m_stmt = NULL;
 		m_bDBOpen = false;
 	}
 
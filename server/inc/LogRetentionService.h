@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#ifndef _LOGRETENTIONSERVICE_H_
+#define _LOGRETENTIONSERVICE_H_
+
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+
+class LogRetentionService
+{
+private:
+	static const int RETENTION_INTERVAL_SEC;
+	static const int LOG_DELETE_BATCH_SIZE;
+	static const int VACUUM_BATCH_PAGES;
+	pthread_t m_retentionThread;
+	bool m_bStarted;
+	bool m_bStopRequested;
+	std::mutex m_stopMutex;
+	std::condition_variable m_stopCondition;
+
+private:
+	static void* retentionThread(void* pData);
+	void mainloop(void);
+	bool isStopRequested(void);
+	int deleteExpiredLogs(void);
+	int deleteExpiredDailyCounts(void);
+	int compactDb(void);
+
+public:
+	LogRetentionService(void);
+	~LogRetentionService(void);
+	int start(void);
+	int stop(void);
+};
+
+#endif //_LOGRETENTIONSERVICE_H_
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef _MONITORPOLICYPUBLISHER_H_
+#define _MONITORPOLICYPUBLISHER_H_
+
+#include <mutex>
+#include <condition_variable>
+#include <pthread.h>
+
+// Publishes the monitor policy snapshot behind the IPC threads. A change asks for a
+// publish and returns, the changes of a burst are published once after PUBLISH_DELAY_MS.
+class MonitorPolicyPublisher
+{
+private:
+	static const int PUBLISH_DELAY_MS;
+	static std::mutex m_singletonMutex;
+	static MonitorPolicyPublisher* m_pInstance;
+	pthread_t m_publisherThread;
+	bool m_bStarted;
+	bool m_bStopRequested;
+	bool m_bPublishRequested;
+	std::mutex m_requestMutex;
+	std::condition_variable m_requestCondition;
+
+private:
+	MonitorPolicyPublisher(void);
+	~MonitorPolicyPublisher(void);
+	static void* publisherThread(void* pData);
+	void mainloop(void);
+
+public:
+	static MonitorPolicyPublisher* getInstance(void);
+	int start(void);
+	int stop(void);
+	// the snapshot is published on this thread when the publisher doesn't run
+	void requestPublish(void);
+};
+
+#endif //_MONITORPOLICYPUBLISHER_H_
@@ -27,15 +27,24 @@
 class NotificationServer
 {
 private:
+	static std::mutex m_singletonMutex;
+	static NotificationServer* m_pInstance;
 	bool m_initialized;
 	DBusConnection* m_pDBusConnection;
-public:
+	// the services send from their own threads
+	std::mutex m_sendMutex;
 
 	NotificationServer(void);
 	~NotificationServer(void);
+	int sendSignal(DBusMessage* pMessage);
+
+public:
+	static NotificationServer* getInstance(void);
 	int initialize(void);
 	int notifySettingChanged(const std::string pkgId, const std::string privacyId);
 	int notifyPkgRemoved(const std::string pkgId);
+	int notifyMonitorPolicyChanged(const int userId, const std::string packageId, const std::string privacyId, const int monitorPolicy);
+	int notifyMonitorPolicyRemoved(const int userId, const std::string packageId);
 };
 
 
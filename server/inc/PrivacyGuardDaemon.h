@@ -20,6 +20,7 @@
 #include "privacy_guard_client_types.h"
 
 class SocketService;
+class LogRetentionService;
 #if 0
 // [CYNARA]
 class CynaraService;
@@ -30,6 +31,7 @@ class EXTERN_API PrivacyGuardDaemon
 private:
 	static PrivacyGuardDaemon* pInstance;
 	SocketService* pSocketService;
+	LogRetentionService* pLogRetentionService;
 #if 0
 	// [CYNARA]	
 	CynaraService* pCynaraService;
@@ -21,17 +21,35 @@
 #include <memory>
 #include <list>
 #include <mutex>
+#include <map>
+#include <condition_variable>
+#include <pthread.h>
 #include "ICommonDb.h"
 #include "privacy_guard_client_types.h"
 #include "PrivacyGuardTypes.h"
 
-#ifdef __FILTER_LISTED_PKG
-#include <map>
-#endif
+// one access log record, stamped when the server accepted it or when the client wrote it to its ring
+typedef struct _access_log_s {
+	int user_id;
+	std::string package_id;
+	std::string privacy_id;
+	time_t use_date;
+} access_log_s;
 
 class PrivacyGuardDb : public ICommonDb
 {
 private:
+	typedef std::map < std::string, sqlite3_stmt* > StmtCacheMap;
+
+	// a read-only connection of the reader pool with its own prepared statements
+	struct ReaderConnection {
+		sqlite3* pHandler;
+		StmtCacheMap stmtCache;
+	};
+
+	static const int READER_POOL_SIZE;
+	static const int BUSY_TIMEOUT_MS;
+	static const int WAL_CHECKPOINT_PAGES;
 	static std::mutex m_singletonMutex;
 	static PrivacyGuardDb* m_pInstance;
 #ifdef __FILTER_LISTED_PKG
@@ -39,10 +57,69 @@ private:
     const static std::string FILTER_KEY;
     static std::map < std::string, bool > m_filteredPkgList;
 #endif
+	// prepared statements of m_sqlHandler, keyed by query
+	StmtCacheMap m_stmtCache;
+	// idle reader connections, m_readerCount counts the idle and the busy ones
+	std::list < ReaderConnection* > m_readerPool;
+	int m_readerCount;
+	std::mutex m_readerPoolMutex;
+	std::condition_variable m_readerPoolCondition;
+	// shared by the readers and the writer while they use a connection, exclusive to close them
+	pthread_rwlock_t m_connectionLock;
+	// interned keys of the access log, keyed by package id and privacy id
+	std::map < std::string, int > m_packageKeyCache;
+	std::map < std::string, int > m_privacyKeyCache;
 
 private:
 	void createDB(void);
 
+	int migrateDB(void);
+	// converts a db created without incremental vacuum, once at daemon start
+	int enableIncrementalVacuum(void);
+
+	static int prepareCachedStmt(sqlite3* pHandler, StmtCacheMap& stmtCache, const std::string& query, sqlite3_stmt** ppStmt);
+
+	static void finalizeCachedStmts(StmtCacheMap& stmtCache);
+
+	int prepareStmt(const std::string& query, sqlite3_stmt** ppStmt);
+
+	void finalizeStmtCache(void);
+
+	void lockWriter(void);
+
+	void unlockWriter(void);
+
+	ReaderConnection* acquireReader(void);
+
+	void releaseReader(ReaderConnection* pReader);
+
+	void closeReaderPool(void);
+
+	static int walHook(void* pData, sqlite3* pHandler, const char* pDbName, int walPageCount);
+
+	int getDictionaryKey(const std::string& insertQuery, const std::string& selectQuery,
+				std::map < std::string, int >& keyCache, const std::string& value, int& key);
+
+	int getPackageKey(const std::string& packageId, int& pkgKey);
+
+	int getPrivacyKey(const std::string& privacyId, int& privacyKey);
+
+	int setSynchronous(const int level);
+
+	int beginLogTransaction(void);
+
+	int commitLogTransaction(void);
+
+	void rollbackLogTransaction(void);
+
+	int bindDateRange(sqlite3_stmt* pStmt, const int startDate, const int endDate);
+
+	static int getIntCallback(void* pData, int argc, char** argv, char** colName);
+
+	static int getLogExpiryDay(void);
+
+	static int getDailyCountExpiryDay(void);
+
 	PrivacyGuardDb(void);
 
 	~PrivacyGuardDb(void);
@@ -54,11 +131,13 @@ public:
 
 	int PgAddPrivacyAccessLog(const int userId, std::list < std::pair < std::string, std::string > > logInfoList);
 
+	int PgAddPrivacyAccessLogs(const std::list < access_log_s >& logList);
+
 	int PgAddPrivacyAccessLogForCynara(const int userId, const std::string packageId, const std::string privilege, const timespec *timestamp);
 
 	int PgAddPrivacyAccessLogTest(const int userId, const std::string packageId, const std::string privacyId);
 
-	int PgAddMonitorPolicy(const int userId, const std::string packageId, const std::list < std::string > privacyList, bool monitorPolicy);
+	int PgAddMonitorPolicy(const int userId, const std::string packageId, const std::list < std::string > privacyList, const int monitorPolicy);
 
 	int PgCheckPrivacyPackage(const int userId, const std::string packageId, bool &isPrivacyPackage);
 
@@ -99,6 +178,18 @@ public:
 	int PgGetMainMonitorPolicy(const int userId, bool &mainMonitorPolicy);
 
 	int PgDeleteMainMonitorPolicyByUserId(const int userId);
+
+	int PgGetNextLogUserId(const int userId, int& nextUserId);
+
+	int PgDeleteExpiredLogs(const int userId, const int batchSize, int& deletedCount);
+
+	int PgGetNextDailyCountUserId(const int userId, int& nextUserId);
+
+	int PgDeleteExpiredDailyCounts(const int userId, int& deletedCount);
+
+	int PgIncrementalVacuum(const int pageCount, int& freePageCount);
+
+	int PgCheckpoint(void);
 };
 
 
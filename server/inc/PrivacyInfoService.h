@@ -32,6 +32,9 @@ public:
 	{
 		pSocketService->registerServiceCallback(getInterfaceName(), std::string("PgAddPrivacyAccessLog"), PgAddPrivacyAccessLog);
 		pSocketService->registerServiceCallback(getInterfaceName(), std::string("PgAddPrivacyAccessLogTest"), PgAddPrivacyAccessLogTest);
+#ifdef USE_ACCESS_LOG_RING
+		pSocketService->registerServiceCallback(getInterfaceName(), std::string("PgRegisterAccessLogRing"), PgRegisterAccessLogRing);
+#endif
 		pSocketService->registerServiceCallback(getInterfaceName(), std::string("PgAddMonitorPolicy"), PgAddMonitorPolicy);
 		pSocketService->registerServiceCallback(getInterfaceName(), std::string("PgDeleteAllLogsAndMonitorPolicy"), PgDeleteAllLogsAndMonitorPolicy);
 		pSocketService->registerServiceCallback(getInterfaceName(), std::string("PgDeleteLogsByPackageId"), PgDeleteLogsByPackageId);
@@ -52,8 +55,14 @@ public:
 		pSocketService->registerServiceCallback(getInterfaceName(), std::string("PgDeleteMainMonitorPolicyByUserId"), PgDeleteMainMonitorPolicyByUserId);
 	}
 
+	// writes all the monitor policies to the file the clients map, MonitorPolicyPublisher calls it after the changes
+	static void publishMonitorPolicySnapshot(void);
+
 	static void PgAddPrivacyAccessLog(SocketConnection* pConnector);
 	static void PgAddPrivacyAccessLogTest(SocketConnection* pConnector);
+#ifdef USE_ACCESS_LOG_RING
+	static void PgRegisterAccessLogRing(SocketConnection* pConnector);
+#endif
 	static void PgAddMonitorPolicy(SocketConnection* pConnector);
 	static void PgDeleteAllLogsAndMonitorPolicy(SocketConnection* pConnector);
 	static void PgDeleteLogsByPackageId(SocketConnection* pConnector);
@@ -23,6 +23,11 @@
 #include <map>
 #include <memory>
 #include <pthread.h>
+#ifdef USE_IPC_EPOLL
+#include <deque>
+#include <vector>
+#include <condition_variable>
+#endif
 #include "SocketConnection.h"
 
 typedef void(*socketServiceCallback)(SocketConnection* pConnector);
@@ -47,6 +52,8 @@ private:
 	static const int MAX_LISTEN;
 	static const int TIMEOUT_SEC;
 	static const int TIMEOUT_NSEC;
+	static const int REQUEST_TIMEOUT_MS;
+	std::string m_address;
 	int m_listenFd;
 	int m_signalToClose;
 	pthread_t m_mainThread;
@@ -60,10 +67,39 @@ private:
 	std::list < int > m_clientSocketList;
 	std::mutex m_clientSocketListMutex;
 
+#ifdef USE_IPC_EPOLL
+	static const int MAX_EPOLL_EVENTS;
+	static const int MAX_PIPELINED_REQUESTS;
+	static const int WORKER_COUNT;
+	int m_epollFd;
+	int m_stopEventFd;
+	std::vector < pthread_t > m_workerThreads;
+	// client sockets with a pending request, served by the worker threads
+	std::deque < int > m_readyQueue;
+	std::mutex m_readyQueueMutex;
+	std::condition_variable m_readyQueueCondition;
+	bool m_bWorkerStopRequested;
+	// the connection of each client socket, it keeps the received data between the requests.
+	// guarded by m_clientSocketListMutex
+	std::map < int, std::shared_ptr < SocketConnection > > m_connectionMap;
+#endif
+
 private:
 	static void* serverThread(void* );
 	static void* connectionThread(void* pData);
-	int connectionService(int fd);
+#ifdef USE_IPC_EPOLL
+	static void* workerThread(void* pData);
+	void workerLoop(void);
+	int startWorkers(void);
+	void stopWorkers(void);
+	int watchClientSocket(int clientFd);
+	int rearmClientSocket(int clientFd);
+	int receiveRequest(int clientFd);
+	void queueClientSocket(int clientFd);
+	std::shared_ptr < SocketConnection > findConnection(int clientFd);
+	int acceptConnections(void);
+#endif
+	int connectionService(SocketConnection* pConnector);
 	int mainloop(void);
 	void closeConnections(void);
 
@@ -72,7 +108,8 @@ private:
 	bool popClientSocket(int* pClientSocket);
 
 public:
-	SocketService(void);
+	// address is the path of the socket, another one than SERVER_ADDRESS is for tests
+	explicit SocketService(const std::string& address = SERVER_ADDRESS);
 	~SocketService(void);
 	int initialize(void);
 	int registerServiceCallback(const std::string &interfaceName, const std::string &methodName, socketServiceCallback callbackMethod);
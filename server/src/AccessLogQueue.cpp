@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include <chrono>
+#include <dlog.h>
+#include "PrivacyGuardTypes.h"
+#include "Utils.h"
+#include "AccessLogQueue.h"
+
+std::mutex AccessLogQueue::m_singletonMutex;
+AccessLogQueue* AccessLogQueue::m_pInstance = NULL;
+
+const size_t AccessLogQueue::MAX_QUEUE_SIZE = 8192;
+const size_t AccessLogQueue::WRITE_BATCH_SIZE = 1000;
+// a burst of logs is gathered for this long into one transaction
+const int AccessLogQueue::WRITE_DELAY_MS = 100;
+// a client waits this long for room in a full queue before the logs are written directly
+const int AccessLogQueue::PUSH_TIMEOUT_MS = 2000;
+
+AccessLogQueue::AccessLogQueue(void)
+	: m_writerThread(-1)
+	, m_bStarted(false)
+	, m_bStopRequested(false)
+{
+
+}
+
+AccessLogQueue::~AccessLogQueue(void)
+{
+
+}
+
+AccessLogQueue*
+AccessLogQueue::getInstance(void)
+{
+	std::lock_guard < std::mutex > guard(m_singletonMutex);
+
+	if (m_pInstance == NULL)
+	{
+		m_pInstance = new AccessLogQueue();
+	}
+
+	return m_pInstance;
+}
+
+int
+AccessLogQueue::start(void)
+{
+	LOGI("AccessLogQueue starting");
+
+	std::lock_guard < std::mutex > guard(m_queueMutex);
+
+	if (m_bStarted == true) {
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	m_bStopRequested = false;
+
+	int res = pthread_create(&m_writerThread, NULL, &writerThread, this);
+	TryReturn( res == 0, PRIV_FLTR_ERROR_SYSTEM_ERROR, errno = res, "pthread_create : %s", strerror(res));
+
+	m_bStarted = true;
+
+	LOGI("AccessLogQueue started");
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+AccessLogQueue::stop(void)
+{
+	LOGI("Stopping");
+
+	{
+		std::lock_guard < std::mutex > guard(m_queueMutex);
+		if (m_bStarted == false || m_bStopRequested == true) {
+			return PRIV_FLTR_ERROR_SUCCESS;
+		}
+		m_bStopRequested = true;
+	}
+	m_notEmptyCondition.notify_all();
+	m_notFullCondition.notify_all();
+
+	// the writer thread stores every queued log before it ends
+	pthread_join(m_writerThread, NULL);
+
+	{
+		std::lock_guard < std::mutex > guard(m_queueMutex);
+		m_bStarted = false;
+	}
+
+	LOGI("Stopped");
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+AccessLogQueue::push(const int userId, const std::list < std::pair < std::string, std::string > >& logInfoList)
+{
+	// the access time is the time the server accepted the log, not the time it is written
+	time_t current_date = time(NULL);
+	if(current_date <= 0) {
+		return PRIV_FLTR_ERROR_INVALID_PARAMETER;
+	}
+
+	std::list < access_log_s > logList;
+	for (std::list < std::pair < std::string, std::string > >::const_iterator iter = logInfoList.begin(); iter != logInfoList.end(); ++iter) {
+		access_log_s log;
+		log.user_id = userId;
+		log.package_id = iter->first;
+		log.privacy_id = iter->second;
+		log.use_date = current_date;
+		logList.push_back(log);
+	}
+
+	return push(logList);
+}
+
+int
+AccessLogQueue::push(const std::list < access_log_s >& logList)
+{
+	size_t logCount = logList.size();
+
+	{
+		std::unique_lock < std::mutex > lock(m_queueMutex);
+
+		// back-pressure : a full queue holds the client until the writer catches up
+		bool bQueued = m_notFullCondition.wait_for(lock, std::chrono::milliseconds(PUSH_TIMEOUT_MS), [this, logCount] {
+				return m_bStarted == false || m_bStopRequested == true
+					|| m_logQueue.empty() || m_logQueue.size() + logCount <= MAX_QUEUE_SIZE;
+			});
+
+		if (bQueued == true && m_bStarted == true && m_bStopRequested == false) {
+			m_logQueue.insert(m_logQueue.end(), logList.begin(), logList.end());
+			lock.unlock();
+			m_notEmptyCondition.notify_one();
+			return PRIV_FLTR_ERROR_SUCCESS;
+		}
+	}
+
+	// no writer thread or it is stalled, store the logs on this thread
+	PF_LOGD("AccessLogQueue is not available, write %d logs directly", (int)logCount);
+
+	return PrivacyGuardDb::getInstance()->PgAddPrivacyAccessLogs(logList);
+}
+
+void*
+AccessLogQueue::writerThread(void* pData)
+{
+	AccessLogQueue &t = *static_cast< AccessLogQueue* > (pData);
+	LOGI("Running access log writer thread");
+	t.mainloop();
+	return (void*) 0;
+}
+
+void
+AccessLogQueue::mainloop(void)
+{
+	while (1)
+	{
+		std::list < access_log_s > logList;
+		size_t logCount = 0;
+
+		{
+			std::unique_lock < std::mutex > lock(m_queueMutex);
+
+			m_notEmptyCondition.wait(lock, [this] { return m_bStopRequested == true || m_logQueue.empty() == false; });
+
+			// stop is requested and everything is written
+			if (m_logQueue.empty()) {
+				break;
+			}
+
+			if (m_bStopRequested == false && m_logQueue.size() < WRITE_BATCH_SIZE) {
+				m_notEmptyCondition.wait_for(lock, std::chrono::milliseconds(WRITE_DELAY_MS), [this] {
+						return m_bStopRequested == true || m_logQueue.size() >= WRITE_BATCH_SIZE;
+					});
+			}
+
+			while (m_logQueue.empty() == false && logCount < WRITE_BATCH_SIZE) {
+				logList.push_back(m_logQueue.front());
+				m_logQueue.pop_front();
+				logCount++;
+			}
+		}
+		m_notFullCondition.notify_all();
+
+		int res = PrivacyGuardDb::getInstance()->PgAddPrivacyAccessLogs(logList);
+		if (res != PRIV_FLTR_ERROR_SUCCESS) {
+			LOGE("PgAddPrivacyAccessLogs : %d, %d logs are lost", res, (int)logCount);
+		}
+	}
+
+	LOGI("Access log writer thread finished");
+}
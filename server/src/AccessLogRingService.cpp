@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <dlog.h>
+#include "PrivacyGuardTypes.h"
+#include "Utils.h"
+#include "AccessLogQueue.h"
+#include "AccessLogRingService.h"
+
+// the epoll data of a ring fd is the pid of the client and whether it is the hang up fd
+#define RING_EVENT_DATA(pid, bHangup) (((uint64_t)(pid) << 1) | ((bHangup) ? 1 : 0))
+#define STOP_EVENT_DATA ((uint64_t)-1)
+
+std::mutex AccessLogRingService::m_singletonMutex;
+AccessLogRingService* AccessLogRingService::m_pInstance = NULL;
+
+// a process holds one ring, this bounds the memory mapped for all of them
+const size_t AccessLogRingService::MAX_RING_COUNT = 64;
+const int AccessLogRingService::MAX_EPOLL_EVENTS = 32;
+// a ring in use is read this often, its client signals nothing while it is
+const int AccessLogRingService::DRAIN_INTERVAL_MS = 100;
+const size_t AccessLogRingService::DRAIN_BATCH_SIZE = 1000;
+// a record waits a drain interval or a busy server at most, an older or future date is the server's own
+const int AccessLogRingService::MAX_RECORD_AGE_S = 10;
+
+AccessLogRingService::AccessLogRingService(void)
+	: m_drainThread(-1)
+	, m_bStarted(false)
+	, m_epollFd(-1)
+	, m_stopEventFd(-1)
+{
+
+}
+
+AccessLogRingService::~AccessLogRingService(void)
+{
+
+}
+
+AccessLogRingService*
+AccessLogRingService::getInstance(void)
+{
+	std::lock_guard < std::mutex > guard(m_singletonMutex);
+
+	if (m_pInstance == NULL)
+	{
+		m_pInstance = new AccessLogRingService();
+	}
+
+	return m_pInstance;
+}
+
+int
+AccessLogRingService::start(void)
+{
+	LOGI("AccessLogRingService starting");
+
+	std::lock_guard < std::mutex > guard(m_ringMutex);
+
+	if (m_bStarted == true) {
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	TryReturn( m_epollFd != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, , "epoll_create1 : %s", strerror(errno));
+
+	m_stopEventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	TryReturn( m_stopEventFd != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, close(m_epollFd); m_epollFd = -1, "eventfd : %s", strerror(errno));
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u64 = STOP_EVENT_DATA;
+	int res = epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_stopEventFd, &event);
+	TryReturn( res != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, close(m_stopEventFd); close(m_epollFd); m_stopEventFd = -1; m_epollFd = -1,
+			"epoll_ctl : %s", strerror(errno));
+
+	res = pthread_create(&m_drainThread, NULL, &drainThread, this);
+	TryReturn( res == 0, PRIV_FLTR_ERROR_SYSTEM_ERROR, close(m_stopEventFd); close(m_epollFd); m_stopEventFd = -1; m_epollFd = -1,
+			"pthread_create : %s", strerror(res));
+
+	m_bStarted = true;
+
+	LOGI("AccessLogRingService started");
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+AccessLogRingService::stop(void)
+{
+	LOGI("Stopping");
+
+	{
+		std::lock_guard < std::mutex > guard(m_ringMutex);
+		if (m_bStarted == false) {
+			return PRIV_FLTR_ERROR_SUCCESS;
+		}
+	}
+
+	// the drain thread reads every ring once more before it ends
+	uint64_t stopValue = 1;
+	if (write(m_stopEventFd, &stopValue, sizeof(stopValue)) == -1)
+	{
+		LOGE("write : %s", strerror(errno));
+		return PRIV_FLTR_ERROR_SYSTEM_ERROR;
+	}
+	pthread_join(m_drainThread, NULL);
+
+	{
+		std::lock_guard < std::mutex > guard(m_ringMutex);
+		m_ringMap.clear();
+		close(m_stopEventFd);
+		close(m_epollFd);
+		m_stopEventFd = -1;
+		m_epollFd = -1;
+		m_bStarted = false;
+	}
+
+	LOGI("Stopped");
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+AccessLogRingService::addRing(const struct ucred& credentials, int memoryFd, int eventFd, int hangupFd)
+{
+	std::shared_ptr < RingInfo > pRingInfo = std::make_shared < RingInfo > ();
+	pRingInfo->pRing.reset(new AccessLogRing());
+	pRingInfo->userId = credentials.uid;
+
+	int res = pRingInfo->pRing->attach(memoryFd, eventFd, hangupFd);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "attach : %d", res);
+	// the client writes nothing before it has the answer, it signals its first record
+	pRingInfo->bWaiting = pRingInfo->pRing->waitForPush();
+
+	std::list < access_log_s > logList;
+	std::unique_lock < std::mutex > lock(m_ringMutex);
+
+	TryReturn(m_bStarted == true, PRIV_FLTR_ERROR_INVALID_STATE, , "AccessLogRingService is not running");
+
+	// a pid used again belongs to a new process, the old one is gone
+	std::map < pid_t, std::shared_ptr < RingInfo > >::iterator iter = m_ringMap.find(credentials.pid);
+	if (iter != m_ringMap.end())
+	{
+		drainRing(*iter->second, logList);
+		removeRing(credentials.pid);
+	}
+
+	TryReturn(m_ringMap.size() < MAX_RING_COUNT, PRIV_FLTR_ERROR_INVALID_STATE, , "Too many access log rings : %d", (int)m_ringMap.size());
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.u64 = RING_EVENT_DATA(credentials.pid, false);
+	res = epoll_ctl(m_epollFd, EPOLL_CTL_ADD, pRingInfo->pRing->getEventFd(), &event);
+	TryReturn(res != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, , "epoll_ctl : %s", strerror(errno));
+
+	event.data.u64 = RING_EVENT_DATA(credentials.pid, true);
+	res = epoll_ctl(m_epollFd, EPOLL_CTL_ADD, pRingInfo->pRing->getHangupFd(), &event);
+	TryReturn(res != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, epoll_ctl(m_epollFd, EPOLL_CTL_DEL, pRingInfo->pRing->getEventFd(), NULL),
+			"epoll_ctl : %s", strerror(errno));
+
+	m_ringMap[credentials.pid] = pRingInfo;
+
+	LOGI("Access log ring of %d added, %d rings", (int)credentials.pid, (int)m_ringMap.size());
+
+	lock.unlock();
+	if (logList.empty() == false)
+		AccessLogQueue::getInstance()->push(logList);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+void
+AccessLogRingService::removeRing(pid_t pid)
+{
+	std::map < pid_t, std::shared_ptr < RingInfo > >::iterator iter = m_ringMap.find(pid);
+	if (iter == m_ringMap.end())
+		return;
+
+	// the fds are closed with the ring, which takes them out of the epoll set
+	m_ringMap.erase(iter);
+
+	LOGI("Access log ring of %d removed, %d rings", (int)pid, (int)m_ringMap.size());
+}
+
+size_t
+AccessLogRingService::drainRing(RingInfo& ringInfo, std::list < access_log_s >& logList)
+{
+	size_t logCount = 0;
+	access_log_s log;
+	time_t now = time(NULL);
+	while (logCount < DRAIN_BATCH_SIZE && ringInfo.pRing->pop(&log.user_id, &log.package_id, &log.privacy_id, &log.use_date) == true)
+	{
+		logCount++;
+		// a process logs for its own user only, the client checks it before it writes to the ring
+		if ((uid_t)log.user_id != ringInfo.userId)
+		{
+			LOGE("Log of user %d in the ring of user %d dropped", log.user_id, (int)ringInfo.userId);
+			continue;
+		}
+		// the client writes the date, a log dated in the future would outlive the retention
+		if (log.use_date > now || log.use_date < now - MAX_RECORD_AGE_S)
+			log.use_date = now;
+		logList.push_back(log);
+	}
+
+	return logCount;
+}
+
+bool
+AccessLogRingService::drainRings(std::list < access_log_s >& logList)
+{
+	bool bActive = false;
+
+	std::map < pid_t, std::shared_ptr < RingInfo > >::iterator iter = m_ringMap.begin();
+	while (iter != m_ringMap.end())
+	{
+		RingInfo& ringInfo = *iter->second;
+		size_t logCount = drainRing(ringInfo, logList);
+
+		if (ringInfo.pRing->isBroken() == true)
+		{
+			pid_t pid = iter->first;
+			++iter;
+			removeRing(pid);
+			continue;
+		}
+
+		// a ring that had nothing this round waits for the eventfd instead of the interval
+		ringInfo.bWaiting = (logCount == 0 && ringInfo.pRing->waitForPush() == true);
+		if (ringInfo.bWaiting == false)
+			bActive = true;
+		++iter;
+	}
+
+	return bActive;
+}
+
+void*
+AccessLogRingService::drainThread(void* pData)
+{
+	AccessLogRingService &t = *static_cast< AccessLogRingService* > (pData);
+	LOGI("Running access log ring thread");
+	t.mainloop();
+	return (void*) 0;
+}
+
+void
+AccessLogRingService::mainloop(void)
+{
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+	bool bActive = false;
+	bool bStopRequested = false;
+
+	while (bStopRequested == false)
+	{
+		int eventCount = epoll_wait(m_epollFd, events, MAX_EPOLL_EVENTS, bActive ? DRAIN_INTERVAL_MS : -1);
+		if (eventCount == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			LOGE("epoll_wait : %s", strerror(errno));
+			break;
+		}
+
+		std::list < pid_t > hungUpList;
+		std::list < access_log_s > logList;
+		{
+			std::lock_guard < std::mutex > guard(m_ringMutex);
+
+			for (int i = 0; i < eventCount; ++i)
+			{
+				uint64_t data = events[i].data.u64;
+				if (data == STOP_EVENT_DATA)
+				{
+					bStopRequested = true;
+					continue;
+				}
+
+				pid_t pid = (pid_t)(data >> 1);
+				if ((data & 1) != 0)
+				{
+					hungUpList.push_back(pid);
+					continue;
+				}
+
+				std::map < pid_t, std::shared_ptr < RingInfo > >::iterator iter = m_ringMap.find(pid);
+				if (iter != m_ringMap.end())
+					iter->second->pRing->clearWakeUp();
+			}
+
+			bActive = drainRings(logList);
+
+			// the client is gone, what it wrote before is read by now
+			for (std::list < pid_t >::iterator iter = hungUpList.begin(); iter != hungUpList.end(); ++iter)
+			{
+				std::map < pid_t, std::shared_ptr < RingInfo > >::iterator ringIter = m_ringMap.find(*iter);
+				if (ringIter == m_ringMap.end())
+					continue;
+				// a ring with more than a batch left is read on before it is dropped
+				if (ringIter->second->bWaiting == true || bStopRequested == true)
+					removeRing(*iter);
+			}
+		}
+
+		// the queue may hold this thread when it is full, no client waits for it meanwhile
+		if (logList.empty() == false)
+		{
+			int res = AccessLogQueue::getInstance()->push(logList);
+			if (res != PRIV_FLTR_ERROR_SUCCESS)
+				LOGE("push : %d, %d logs are lost", res, (int)logList.size());
+		}
+	}
+
+	LOGI("Access log ring thread finished");
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+
+#include <chrono>
+#include <dlog.h>
+#include "PrivacyGuardTypes.h"
+#include "Utils.h"
+#include "PrivacyGuardDb.h"
+#include "LogRetentionService.h"
+
+const int LogRetentionService::RETENTION_INTERVAL_SEC = 6 * 60 * 60;
+// each batch holds the db lock for one short statement only
+const int LogRetentionService::LOG_DELETE_BATCH_SIZE = 500;
+const int LogRetentionService::VACUUM_BATCH_PAGES = 256;
+
+LogRetentionService::LogRetentionService(void)
+	: m_retentionThread(-1)
+	, m_bStarted(false)
+	, m_bStopRequested(false)
+{
+
+}
+
+LogRetentionService::~LogRetentionService(void)
+{
+
+}
+
+int
+LogRetentionService::start(void)
+{
+	LOGI("LogRetentionService starting");
+
+	m_bStopRequested = false;
+
+	int res = pthread_create(&m_retentionThread, NULL, &retentionThread, this);
+	TryReturn( res == 0, PRIV_FLTR_ERROR_SYSTEM_ERROR, errno = res, "pthread_create : %s", strerror(res));
+
+	m_bStarted = true;
+
+	LOGI("LogRetentionService started");
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+LogRetentionService::stop(void)
+{
+	LOGI("Stopping");
+
+	if (m_bStarted == false) {
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	{
+		std::lock_guard < std::mutex > guard(m_stopMutex);
+		m_bStopRequested = true;
+	}
+	m_stopCondition.notify_all();
+
+	pthread_join(m_retentionThread, NULL);
+	m_bStarted = false;
+
+	LOGI("Stopped");
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+void*
+LogRetentionService::retentionThread(void* pData)
+{
+	LogRetentionService &t = *static_cast< LogRetentionService* > (pData);
+	LOGI("Running retention thread");
+	t.mainloop();
+	return (void*) 0;
+}
+
+bool
+LogRetentionService::isStopRequested(void)
+{
+	std::lock_guard < std::mutex > guard(m_stopMutex);
+	return m_bStopRequested;
+}
+
+void
+LogRetentionService::mainloop(void)
+{
+	while (1)
+	{
+		int res = deleteExpiredLogs();
+		if (res == PRIV_FLTR_ERROR_SUCCESS) {
+			res = deleteExpiredDailyCounts();
+		}
+		if (res == PRIV_FLTR_ERROR_SUCCESS) {
+			res = compactDb();
+		}
+		if (res == PRIV_FLTR_ERROR_SUCCESS) {
+			// copy the retention deletions back into the db file
+			res = PrivacyGuardDb::getInstance()->PgCheckpoint();
+		}
+		if (res != PRIV_FLTR_ERROR_SUCCESS) {
+			LOGE("retention pass failed : %d", res);
+		}
+
+		std::unique_lock < std::mutex > lock(m_stopMutex);
+		if (m_stopCondition.wait_for(lock, std::chrono::seconds(RETENTION_INTERVAL_SEC), [this] { return m_bStopRequested; })) {
+			break;
+		}
+	}
+
+	LOGI("Retention thread finished");
+}
+
+int
+LogRetentionService::deleteExpiredLogs(void)
+{
+	PrivacyGuardDb* pDb = PrivacyGuardDb::getInstance();
+	int userId = -1;
+	int deletedCount = 0;
+	int totalCount = 0;
+
+	// walk the users in USER_ID order so that each batch is a range search of one user
+	while (pDb->PgGetNextLogUserId(userId, userId) == PRIV_FLTR_ERROR_SUCCESS) {
+		do {
+			if (isStopRequested()) {
+				return PRIV_FLTR_ERROR_SUCCESS;
+			}
+
+			int res = pDb->PgDeleteExpiredLogs(userId, LOG_DELETE_BATCH_SIZE, deletedCount);
+			TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "PgDeleteExpiredLogs : %d", res);
+
+			totalCount += deletedCount;
+		} while (deletedCount == LOG_DELETE_BATCH_SIZE);
+	}
+
+	LOGI("expired logs deleted : %d", totalCount);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+LogRetentionService::deleteExpiredDailyCounts(void)
+{
+	PrivacyGuardDb* pDb = PrivacyGuardDb::getInstance();
+	int userId = -1;
+	int deletedCount = 0;
+	int totalCount = 0;
+
+	while (pDb->PgGetNextDailyCountUserId(userId, userId) == PRIV_FLTR_ERROR_SUCCESS) {
+		do {
+			if (isStopRequested()) {
+				return PRIV_FLTR_ERROR_SUCCESS;
+			}
+
+			int res = pDb->PgDeleteExpiredDailyCounts(userId, deletedCount);
+			TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "PgDeleteExpiredDailyCounts : %d", res);
+
+			totalCount += deletedCount;
+		} while (deletedCount > 0);
+	}
+
+	LOGI("expired daily counts deleted : %d", totalCount);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+LogRetentionService::compactDb(void)
+{
+	PrivacyGuardDb* pDb = PrivacyGuardDb::getInstance();
+	int freePageCount = 0;
+	int prevFreePageCount = -1;
+
+	// give the free pages back to the file system a few at a time,
+	// until none are left or the db does not release them (auto_vacuum is off)
+	while (freePageCount != prevFreePageCount) {
+		if (isStopRequested()) {
+			return PRIV_FLTR_ERROR_SUCCESS;
+		}
+
+		prevFreePageCount = freePageCount;
+
+		int res = pDb->PgIncrementalVacuum(VACUUM_BATCH_PAGES, freePageCount);
+		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "PgIncrementalVacuum : %d", res);
+
+		if (freePageCount == 0) {
+			break;
+		}
+	}
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include <chrono>
+#include <dlog.h>
+#include "PrivacyGuardTypes.h"
+#include "Utils.h"
+#include "PrivacyInfoService.h"
+#include "MonitorPolicyPublisher.h"
+
+std::mutex MonitorPolicyPublisher::m_singletonMutex;
+MonitorPolicyPublisher* MonitorPolicyPublisher::m_pInstance = NULL;
+
+// the policies of a package being installed come in several calls, one publish follows them all
+const int MonitorPolicyPublisher::PUBLISH_DELAY_MS = 100;
+
+MonitorPolicyPublisher::MonitorPolicyPublisher(void)
+	: m_publisherThread(-1)
+	, m_bStarted(false)
+	, m_bStopRequested(false)
+	, m_bPublishRequested(false)
+{
+
+}
+
+MonitorPolicyPublisher::~MonitorPolicyPublisher(void)
+{
+
+}
+
+MonitorPolicyPublisher*
+MonitorPolicyPublisher::getInstance(void)
+{
+	std::lock_guard < std::mutex > guard(m_singletonMutex);
+
+	if (m_pInstance == NULL)
+	{
+		m_pInstance = new MonitorPolicyPublisher();
+	}
+
+	return m_pInstance;
+}
+
+int
+MonitorPolicyPublisher::start(void)
+{
+	LOGI("MonitorPolicyPublisher starting");
+
+	std::lock_guard < std::mutex > guard(m_requestMutex);
+
+	if (m_bStarted == true) {
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	m_bStopRequested = false;
+
+	int res = pthread_create(&m_publisherThread, NULL, &publisherThread, this);
+	TryReturn( res == 0, PRIV_FLTR_ERROR_SYSTEM_ERROR, errno = res, "pthread_create : %s", strerror(res));
+
+	m_bStarted = true;
+
+	LOGI("MonitorPolicyPublisher started");
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+MonitorPolicyPublisher::stop(void)
+{
+	LOGI("Stopping");
+
+	{
+		std::lock_guard < std::mutex > guard(m_requestMutex);
+		if (m_bStarted == false || m_bStopRequested == true) {
+			return PRIV_FLTR_ERROR_SUCCESS;
+		}
+		m_bStopRequested = true;
+	}
+	m_requestCondition.notify_all();
+
+	// a publish still asked for is done before the thread ends
+	pthread_join(m_publisherThread, NULL);
+
+	{
+		std::lock_guard < std::mutex > guard(m_requestMutex);
+		m_bStarted = false;
+	}
+
+	LOGI("Stopped");
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+void
+MonitorPolicyPublisher::requestPublish(void)
+{
+	{
+		std::lock_guard < std::mutex > guard(m_requestMutex);
+		if (m_bStarted == true && m_bStopRequested == false) {
+			m_bPublishRequested = true;
+			m_requestCondition.notify_one();
+			return;
+		}
+	}
+
+	// no publisher thread, the caller waits for the publish as before
+	PrivacyInfoService::publishMonitorPolicySnapshot();
+}
+
+void*
+MonitorPolicyPublisher::publisherThread(void* pData)
+{
+	MonitorPolicyPublisher &t = *static_cast< MonitorPolicyPublisher* > (pData);
+	LOGI("Running monitor policy publisher thread");
+	t.mainloop();
+	return (void*) 0;
+}
+
+void
+MonitorPolicyPublisher::mainloop(void)
+{
+	while (1)
+	{
+		{
+			std::unique_lock < std::mutex > lock(m_requestMutex);
+
+			m_requestCondition.wait(lock, [this] { return m_bStopRequested == true || m_bPublishRequested == true; });
+
+			// stop is requested and the snapshot is up to date
+			if (m_bPublishRequested == false) {
+				break;
+			}
+
+			// the changes asked for meanwhile are in the same publish
+			if (m_bStopRequested == false) {
+				m_requestCondition.wait_for(lock, std::chrono::milliseconds(PUBLISH_DELAY_MS), [this] { return m_bStopRequested == true; });
+			}
+
+			// a change committed from now on asks for the next publish, none is lost
+			m_bPublishRequested = false;
+		}
+
+		// the whole table is read once for all the changes of the burst
+		PrivacyInfoService::publishMonitorPolicySnapshot();
+	}
+
+	LOGI("Monitor policy publisher thread finished");
+}
@@ -23,6 +23,9 @@
 auto DBusConnectionDeleter = [&](DBusConnection* pPtr) { dbus_connection_close(pPtr); pPtr = NULL;};
 const int MAX_LOCAL_BUF_SIZE = 128;
 
+std::mutex NotificationServer::m_singletonMutex;
+NotificationServer* NotificationServer::m_pInstance = NULL;
+
 NotificationServer::NotificationServer(void)
 	: m_initialized(false)
 	, m_pDBusConnection(NULL)
@@ -39,6 +42,19 @@ NotificationServer::~NotificationServer(void)
 	}
 }
 
+NotificationServer*
+NotificationServer::getInstance(void)
+{
+	std::lock_guard < std::mutex > guard(m_singletonMutex);
+
+	if (m_pInstance == NULL)
+	{
+		m_pInstance = new NotificationServer();
+	}
+
+	return m_pInstance;
+}
+
 int
 NotificationServer::initialize(void)
 {
@@ -80,15 +96,9 @@ NotificationServer::notifySettingChanged(const std::string pkgId, const std::str
 		DBUS_TYPE_STRING, &pPkgId,
 		DBUS_TYPE_STRING, &pPrivacyId,
 		DBUS_TYPE_INVALID);
-	TryReturn(r, PRIV_FLTR_ERROR_IPC_ERROR, , "dbus_message_append_args");
-
-	r = dbus_connection_send(m_pDBusConnection, pMessage, NULL);
-	TryReturn(r, PRIV_FLTR_ERROR_IPC_ERROR, dbus_message_unref(pMessage);, "dbus_connection_send");
-
-	dbus_connection_flush(m_pDBusConnection);
-	dbus_message_unref(pMessage);
+	TryReturn(r, PRIV_FLTR_ERROR_IPC_ERROR, dbus_message_unref(pMessage);, "dbus_message_append_args");
 
-	return PRIV_FLTR_ERROR_SUCCESS;
+	return sendSignal(pMessage);
 }
 
 int
@@ -106,9 +116,65 @@ NotificationServer::notifyPkgRemoved(const std::string pkgId)
 	r = dbus_message_append_args(pMessage,
 		DBUS_TYPE_STRING, &pPkgId,
 		DBUS_TYPE_INVALID);
-	TryReturn(r, PRIV_FLTR_ERROR_IPC_ERROR, , "dbus_message_append_args");
+	TryReturn(r, PRIV_FLTR_ERROR_IPC_ERROR, dbus_message_unref(pMessage);, "dbus_message_append_args");
+
+	return sendSignal(pMessage);
+}
+
+int
+NotificationServer::notifyMonitorPolicyChanged(const int userId, const std::string packageId, const std::string privacyId, const int monitorPolicy)
+{
+	if (!m_initialized)
+		return PRIV_FLTR_ERROR_INVALID_STATE;
+
+	dbus_int32_t dbusUserId = userId;
+	char* pPkgId = const_cast <char*> (packageId.c_str());
+	char* pPrivacyId = const_cast <char*> (privacyId.c_str());
+	dbus_int32_t dbusMonitorPolicy = monitorPolicy;
+
+	DBusMessage* pMessage = dbus_message_new_signal(DBUS_PATH.c_str(), DBUS_SIGNAL_INTERFACE.c_str(), DBUS_SIGNAL_MONITOR_POLICY_CHANGED.c_str());
+	TryReturn(pMessage != NULL, PRIV_FLTR_ERROR_IPC_ERROR, , "dbus_message_new_signal");
+
+	dbus_bool_t r;
+	r = dbus_message_append_args(pMessage,
+		DBUS_TYPE_INT32, &dbusUserId,
+		DBUS_TYPE_STRING, &pPkgId,
+		DBUS_TYPE_STRING, &pPrivacyId,
+		DBUS_TYPE_INT32, &dbusMonitorPolicy,
+		DBUS_TYPE_INVALID);
+	TryReturn(r, PRIV_FLTR_ERROR_IPC_ERROR, dbus_message_unref(pMessage);, "dbus_message_append_args");
+
+	return sendSignal(pMessage);
+}
+
+int
+NotificationServer::notifyMonitorPolicyRemoved(const int userId, const std::string packageId)
+{
+	if (!m_initialized)
+		return PRIV_FLTR_ERROR_INVALID_STATE;
+
+	dbus_int32_t dbusUserId = userId;
+	char* pPkgId = const_cast <char*> (packageId.c_str());
+
+	DBusMessage* pMessage = dbus_message_new_signal(DBUS_PATH.c_str(), DBUS_SIGNAL_INTERFACE.c_str(), DBUS_SIGNAL_MONITOR_POLICY_REMOVED.c_str());
+	TryReturn(pMessage != NULL, PRIV_FLTR_ERROR_IPC_ERROR, , "dbus_message_new_signal");
+
+	dbus_bool_t r;
+	r = dbus_message_append_args(pMessage,
+		DBUS_TYPE_INT32, &dbusUserId,
+		DBUS_TYPE_STRING, &pPkgId,
+		DBUS_TYPE_INVALID);
+	TryReturn(r, PRIV_FLTR_ERROR_IPC_ERROR, dbus_message_unref(pMessage);, "dbus_message_append_args");
+
+	return sendSignal(pMessage);
+}
+
+int
+NotificationServer::sendSignal(DBusMessage* pMessage)
+{
+	std::lock_guard < std::mutex > guard(m_sendMutex);
 
-	r = dbus_connection_send(m_pDBusConnection, pMessage, NULL);
+	dbus_bool_t r = dbus_connection_send(m_pDBusConnection, pMessage, NULL);
 	TryReturn(r, PRIV_FLTR_ERROR_IPC_ERROR, dbus_message_unref(pMessage);, "dbus_connection_send");
 
 	dbus_connection_flush(m_pDBusConnection);
@@ -18,6 +18,14 @@
 #include "PrivacyGuardDaemon.h"
 #include "PrivacyInfoService.h"
 #include "SocketService.h"
+#include "PrivacyGuardDb.h"
+#include "LogRetentionService.h"
+#include "AccessLogQueue.h"
+#include "MonitorPolicyPublisher.h"
+#include "NotificationServer.h"
+#ifdef USE_ACCESS_LOG_RING
+#include "AccessLogRingService.h"
+#endif
 #if 0
 // [CYNARA]
 #include <CynaraService.h>
@@ -27,6 +35,7 @@ PrivacyGuardDaemon* PrivacyGuardDaemon::pInstance = NULL;
 
 PrivacyGuardDaemon::PrivacyGuardDaemon(void)
 	: pSocketService(NULL)
+	, pLogRetentionService(NULL)
 {
 }
 
@@ -47,6 +56,8 @@ PrivacyGuardDaemon::initialize(void)
 {
 	if (pSocketService == NULL)
 		pSocketService = new SocketService();
+	if (pLogRetentionService == NULL)
+		pLogRetentionService = new LogRetentionService();
 #if 0
 	// [CYNARA]
 	if (pCynaraService == NULL)
@@ -60,6 +71,16 @@ PrivacyGuardDaemon::initialize(void)
 
 	PrivacyInfoService::registerCallbacks(pSocketService);
 
+	// open the monitor db now so that schema upgrades run at daemon start
+	PrivacyGuardDb::getInstance();
+	// the clients look the monitor policies up in it, it may be missing or from an older db
+	PrivacyInfoService::publishMonitorPolicySnapshot();
+
+	// without it the clients keep the monitor policies they loaded
+	if (NotificationServer::getInstance()->initialize() != PRIV_FLTR_ERROR_SUCCESS) {
+		PF_LOGE("NotificationServer initialize FAIL");
+	}
+
 	return 0;
 }
 
@@ -70,10 +91,29 @@ PrivacyGuardDaemon::start(void)
 	
 	if (pSocketService == NULL)
 		return PRIV_FLTR_ERROR_NOT_INITIALIZED;
+	// the log writer runs before the first client is accepted
+	if (AccessLogQueue::getInstance()->start() != PRIV_FLTR_ERROR_SUCCESS) {
+		PF_LOGE("AccessLogQueue start FAIL");
+	}
+	// without it each change publishes the snapshot before it is answered
+	if (MonitorPolicyPublisher::getInstance()->start() != PRIV_FLTR_ERROR_SUCCESS) {
+		PF_LOGE("MonitorPolicyPublisher start FAIL");
+	}
+#ifdef USE_ACCESS_LOG_RING
+	// without it the clients log over the socket
+	if (AccessLogRingService::getInstance()->start() != PRIV_FLTR_ERROR_SUCCESS) {
+		PF_LOGE("AccessLogRingService start FAIL");
+	}
+#endif
 	res = pSocketService->start();
 	if(res != PRIV_FLTR_ERROR_SUCCESS){
 		PF_LOGE("FAIL");
 	}
+	if (pLogRetentionService != NULL) {
+		if (pLogRetentionService->start() != PRIV_FLTR_ERROR_SUCCESS) {
+			PF_LOGE("LogRetentionService start FAIL");
+		}
+	}
 #if 0
 	// [CYNARA]
 	if (pCynaraService == NULL)
@@ -90,6 +130,16 @@ int
 PrivacyGuardDaemon::stop(void)
 {
 	pSocketService->stop();
+#ifdef USE_ACCESS_LOG_RING
+	// the last records of the rings go to the queue before it stops
+	AccessLogRingService::getInstance()->stop();
+#endif
+	// no client pushes logs any more, write out the queued ones
+	AccessLogQueue::getInstance()->stop();
+	if (pLogRetentionService != NULL)
+		pLogRetentionService->stop();
+	// the changes of the last calls are in the snapshot before the server ends
+	MonitorPolicyPublisher::getInstance()->stop();
 #if 0
 	// [CYNARA]	
 	pCynaraService->stop();
@@ -102,5 +152,10 @@ int
 PrivacyGuardDaemon::shutdown(void)
 {
 	pSocketService->shutdown();
+#ifdef USE_ACCESS_LOG_RING
+	AccessLogRingService::getInstance()->stop();
+#endif
+	AccessLogQueue::getInstance()->stop();
+	MonitorPolicyPublisher::getInstance()->stop();
 	return 0;
 }
@@ -32,7 +32,19 @@ static cynara_monitor *p_cynara_monitor;
 static cynara_monitor_entry **monitor_entries;
 #endif
 
+// the statement is reset first, a step left in progress would keep the rollback from ending it
+static void
+rollbackTransaction(sqlite3* pHandler, sqlite3_stmt* pStmt)
+{
+	sqlite3_reset(pStmt);
+	sqlite3_exec(pHandler, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+}
+
 std::mutex PrivacyGuardDb::m_singletonMutex;
+
+const int PrivacyGuardDb::READER_POOL_SIZE = 4;
+const int PrivacyGuardDb::BUSY_TIMEOUT_MS = 1000;
+const int PrivacyGuardDb::WAL_CHECKPOINT_PAGES = 1000;
 PrivacyGuardDb* PrivacyGuardDb::m_pInstance = NULL;
 
 static const char* privacy_list[5] = { "http://tizen.org/privacy/location",
@@ -41,6 +53,62 @@ static const char* privacy_list[5] = { "http://tizen.org/privacy/location",
 								 "http://tizen.org/privacy/messaging",
 								 "http://tizen.org/privacy/callhistory" };
 
+#define SECONDS_PER_DAY	86400
+
+// retention of the raw access log (days) and of the daily counts (months), set by cmake
+#ifndef LOG_RETENTION_DAYS
+#define LOG_RETENTION_DAYS	30
+#endif
+#ifndef DAILY_COUNT_RETENTION_MONTHS
+#define DAILY_COUNT_RETENTION_MONTHS	12
+#endif
+
+// PRAGMA synchronous levels (0:OFF 1:NORMAL 2:FULL), the one of the access log writes is set by cmake
+#define DB_SYNCHRONOUS	2
+#ifndef LOG_SYNCHRONOUS
+#define LOG_SYNCHRONOUS	1
+#endif
+
+// Schema upgrades, applied in order on top of the version recorded in DB_VERSION_0_1.
+// A database without a recorded version is the one created by privacy_guard_db.sql 0.1 (version 1).
+typedef struct _db_migration_s {
+	int version;
+	const char* query;
+} db_migration_s;
+
+static const db_migration_s db_migration_list[] = {
+	{ 2,	"CREATE INDEX IF NOT EXISTS StatisticsMonitorInfo_USER_DATE ON StatisticsMonitorInfo(USER_ID, USE_DATE, PKG_ID, PRIVACY_ID);"
+			"CREATE INDEX IF NOT EXISTS StatisticsMonitorInfo_USER_PKG_DATE ON StatisticsMonitorInfo(USER_ID, PKG_ID, USE_DATE, PRIVACY_ID);"
+			"CREATE INDEX IF NOT EXISTS StatisticsMonitorInfo_USER_PRIVACY_DATE ON StatisticsMonitorInfo(USER_ID, PRIVACY_ID, USE_DATE, PKG_ID);"
+			"CREATE INDEX IF NOT EXISTS MonitorPolicy_USER_PRIVACY ON MonitorPolicy(USER_ID, PRIVACY_ID, PKG_ID);" },
+	// the access log keeps integer keys of the interned package and privacy ids
+	{ 3,	"CREATE TABLE IF NOT EXISTS Package(PKG_KEY INTEGER PRIMARY KEY, PKG_ID TEXT not null UNIQUE CHECK(1));"
+			"CREATE TABLE IF NOT EXISTS Privacy(PRIVACY_KEY INTEGER PRIMARY KEY, PRIVACY_ID TEXT not null UNIQUE CHECK(1));"
+			"INSERT OR IGNORE INTO Package(PKG_ID) SELECT DISTINCT PKG_ID FROM StatisticsMonitorInfo;"
+			"INSERT OR IGNORE INTO Privacy(PRIVACY_ID) SELECT DISTINCT PRIVACY_ID FROM StatisticsMonitorInfo;"
+			"CREATE TABLE StatisticsMonitorInfo_new(USER_ID INTEGER not null, PKG_KEY INTEGER not null, PRIVACY_KEY INTEGER not null, USE_DATE INTEGER not null, CHECK(1));"
+			"INSERT INTO StatisticsMonitorInfo_new(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DATE) "
+				"SELECT S.USER_ID, P.PKG_KEY, V.PRIVACY_KEY, S.USE_DATE FROM StatisticsMonitorInfo S "
+				"JOIN Package P ON P.PKG_ID=S.PKG_ID JOIN Privacy V ON V.PRIVACY_ID=S.PRIVACY_ID ORDER BY S.rowid;"
+			"DROP TABLE StatisticsMonitorInfo;"
+			"ALTER TABLE StatisticsMonitorInfo_new RENAME TO StatisticsMonitorInfo;"
+			"CREATE INDEX StatisticsMonitorInfo_USER_DATE ON StatisticsMonitorInfo(USER_ID, USE_DATE, PKG_KEY, PRIVACY_KEY);"
+			"CREATE INDEX StatisticsMonitorInfo_USER_PKG_DATE ON StatisticsMonitorInfo(USER_ID, PKG_KEY, USE_DATE, PRIVACY_KEY);"
+			"CREATE INDEX StatisticsMonitorInfo_USER_PRIVACY_DATE ON StatisticsMonitorInfo(USER_ID, PRIVACY_KEY, USE_DATE, PKG_KEY);" },
+	// daily access counts, maintained by a trigger on every logged access
+	{ 4,	"CREATE TABLE IF NOT EXISTS StatisticsDailyCount(USER_ID INTEGER not null, PKG_KEY INTEGER not null, PRIVACY_KEY INTEGER not null, "
+				"USE_DAY INTEGER not null, USE_COUNT INTEGER not null, PRIMARY KEY(USER_ID, USE_DAY, PKG_KEY, PRIVACY_KEY) CHECK(1)) WITHOUT ROWID;"
+			"CREATE INDEX IF NOT EXISTS StatisticsDailyCount_USER_PKG_DAY ON StatisticsDailyCount(USER_ID, PKG_KEY, USE_DAY, PRIVACY_KEY, USE_COUNT);"
+			"CREATE INDEX IF NOT EXISTS StatisticsDailyCount_USER_PRIVACY_DAY ON StatisticsDailyCount(USER_ID, PRIVACY_KEY, USE_DAY, PKG_KEY, USE_COUNT);"
+			"DELETE FROM StatisticsDailyCount;"
+			"INSERT INTO StatisticsDailyCount(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DAY, USE_COUNT) "
+				"SELECT USER_ID, PKG_KEY, PRIVACY_KEY, USE_DATE/86400, COUNT(*) FROM StatisticsMonitorInfo GROUP BY USER_ID, USE_DATE/86400, PKG_KEY, PRIVACY_KEY;"
+			"CREATE TRIGGER IF NOT EXISTS StatisticsMonitorInfo_DAILY_COUNT AFTER INSERT ON StatisticsMonitorInfo BEGIN "
+				"INSERT OR IGNORE INTO StatisticsDailyCount(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DAY, USE_COUNT) VALUES(NEW.USER_ID, NEW.PKG_KEY, NEW.PRIVACY_KEY, NEW.USE_DATE/86400, 0);"
+				"UPDATE StatisticsDailyCount SET USE_COUNT=USE_COUNT+1 WHERE USER_ID=NEW.USER_ID AND USE_DAY=NEW.USE_DATE/86400 AND PKG_KEY=NEW.PKG_KEY AND PRIVACY_KEY=NEW.PRIVACY_KEY;"
+			"END;" },
+};
+
 #ifdef __FILTER_LISTED_PKG
 const std::string PrivacyGuardDb::PRIVACY_FILTER_LIST_FILE = std::string("/usr/share/privacy-guard/privacy-guard-list.ini");
 const std::string PrivacyGuardDb::FILTER_KEY = std::string("package_id");
@@ -53,6 +121,433 @@ PrivacyGuardDb::createDB(void)
 
 }
 
+int
+PrivacyGuardDb::prepareCachedStmt(sqlite3* pHandler, StmtCacheMap& stmtCache, const std::string& query, sqlite3_stmt** ppStmt)
+{
+	int res = SQLITE_OK;
+
+	// reuse the statement compiled for this query on the same connection
+	StmtCacheMap::iterator iter = stmtCache.find(query);
+	if (iter != stmtCache.end()) {
+		sqlite3_reset(iter->second);
+		sqlite3_clear_bindings(iter->second);
+		*ppStmt = iter->second;
+		return SQLITE_OK;
+	}
+
+	sqlite3_stmt* pStmt = NULL;
+	res = sqlite3_prepare_v2(pHandler, query.c_str(), -1, &pStmt, NULL);
+	TryReturn(res == SQLITE_OK, res, , "sqlite3_prepare_v2 : %d", res);
+
+	stmtCache.insert(StmtCacheMap::value_type(query, pStmt));
+	*ppStmt = pStmt;
+
+	return SQLITE_OK;
+}
+
+void
+PrivacyGuardDb::finalizeCachedStmts(StmtCacheMap& stmtCache)
+{
+	for (StmtCacheMap::iterator iter = stmtCache.begin(); iter != stmtCache.end(); ++iter) {
+		sqlite3_finalize(iter->second);
+	}
+	stmtCache.clear();
+}
+
+int
+PrivacyGuardDb::prepareStmt(const std::string& query, sqlite3_stmt** ppStmt)
+{
+	return prepareCachedStmt(m_sqlHandler, m_stmtCache, query, ppStmt);
+}
+
+void
+PrivacyGuardDb::finalizeStmtCache(void)
+{
+	finalizeCachedStmts(m_stmtCache);
+}
+
+void
+PrivacyGuardDb::lockWriter(void)
+{
+	// shared on the connection lock like the readers, m_dbMutex serializes the writers on m_sqlHandler
+	pthread_rwlock_rdlock(&m_connectionLock);
+	m_dbMutex.lock();
+}
+
+void
+PrivacyGuardDb::unlockWriter(void)
+{
+	m_dbMutex.unlock();
+	pthread_rwlock_unlock(&m_connectionLock);
+}
+
+PrivacyGuardDb::ReaderConnection*
+PrivacyGuardDb::acquireReader(void)
+{
+	// the readers don't open a db the writer couldn't upgrade
+	if (m_bDBOpen == false) {
+		lockWriter();
+		if (m_bDBOpen == false) {
+			openSqliteDB();
+		}
+		bool bOpen = m_bDBOpen;
+		unlockWriter();
+		TryReturn(bOpen == true, NULL, , "monitor db is not open");
+	}
+
+	// held until releaseReader(), so the pool is not closed under a running query
+	pthread_rwlock_rdlock(&m_connectionLock);
+
+	std::unique_lock < std::mutex > lock(m_readerPoolMutex);
+
+	while (m_readerPool.empty() && m_readerCount >= READER_POOL_SIZE) {
+		m_readerPoolCondition.wait(lock);
+	}
+
+	if (m_readerPool.empty() == false) {
+		ReaderConnection* pReader = m_readerPool.front();
+		m_readerPool.pop_front();
+		return pReader;
+	}
+
+	// open one more reader, the pool grows on demand up to READER_POOL_SIZE
+	sqlite3* pHandler = NULL;
+	int res = sqlite3_open_v2(PRIVACY_DB_PATH, &pHandler, SQLITE_OPEN_READONLY, NULL);
+	if (res != SQLITE_OK) {
+		PF_LOGE("fail : monitor db reader open(%d)", res);
+		sqlite3_close(pHandler);
+		lock.unlock();
+		pthread_rwlock_unlock(&m_connectionLock);
+		return NULL;
+	}
+	sqlite3_busy_timeout(pHandler, BUSY_TIMEOUT_MS);
+
+	ReaderConnection* pReader = new ReaderConnection();
+	pReader->pHandler = pHandler;
+	m_readerCount++;
+
+	return pReader;
+}
+
+void
+PrivacyGuardDb::releaseReader(ReaderConnection* pReader)
+{
+	{
+		std::lock_guard < std::mutex > guard(m_readerPoolMutex);
+		m_readerPool.push_back(pReader);
+	}
+	m_readerPoolCondition.notify_one();
+
+	pthread_rwlock_unlock(&m_connectionLock);
+}
+
+void
+PrivacyGuardDb::closeReaderPool(void)
+{
+	std::lock_guard < std::mutex > guard(m_readerPoolMutex);
+
+	for (std::list < ReaderConnection* >::iterator iter = m_readerPool.begin(); iter != m_readerPool.end(); ++iter) {
+		finalizeCachedStmts((*iter)->stmtCache);
+		sqlite3_close((*iter)->pHandler);
+		delete *iter;
+	}
+	m_readerPool.clear();
+	m_readerCount = 0;
+}
+
+int
+PrivacyGuardDb::walHook(void* pData, sqlite3* pHandler, const char* pDbName, int walPageCount)
+{
+	// size based checkpoint, in place of sqlite's own auto-checkpoint
+	if (walPageCount >= WAL_CHECKPOINT_PAGES) {
+		int logPageCount = 0, checkpointedPageCount = 0;
+		int res = sqlite3_wal_checkpoint_v2(pHandler, pDbName, SQLITE_CHECKPOINT_PASSIVE, &logPageCount, &checkpointedPageCount);
+		if (res != SQLITE_OK) {
+			PF_LOGE("sqlite3_wal_checkpoint_v2 : %d", res);
+		}
+	}
+	return SQLITE_OK;
+}
+
+int
+PrivacyGuardDb::PgCheckpoint(void)
+{
+	int res = -1;
+
+	lockWriter();
+	// open db
+	if(m_bDBOpen == false) {
+		openSqliteDB();
+	}
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	int logPageCount = 0, checkpointedPageCount = 0;
+	res = sqlite3_wal_checkpoint_v2(m_sqlHandler, NULL, SQLITE_CHECKPOINT_PASSIVE, &logPageCount, &checkpointedPageCount);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_wal_checkpoint_v2 : %d", res);
+
+	unlockWriter();
+
+	PF_LOGD("checkpoint : %d of %d pages", checkpointedPageCount, logPageCount);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyGuardDb::getDictionaryKey(const std::string& insertQuery, const std::string& selectQuery,
+		std::map < std::string, int >& keyCache, const std::string& value, int& key)
+{
+	int res = SQLITE_OK;
+
+	std::map < std::string, int >::iterator iter = keyCache.find(value);
+	if (iter != keyCache.end()) {
+		key = iter->second;
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	sqlite3_stmt* pStmt = NULL;
+
+	// insert the value unless it is interned already
+	res = prepareStmt(insertQuery, &pStmt);
+	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "prepareStmt : %d", res);
+
+	res = sqlite3_bind_text(pStmt, 1, value.c_str(), -1, SQLITE_TRANSIENT);
+	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_bind_text : %d", res);
+
+	res = sqlite3_step(pStmt);
+	sqlite3_reset(pStmt);
+	TryReturn(res == SQLITE_DONE, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_step : %d", res);
+
+	// read back its key
+	res = prepareStmt(selectQuery, &pStmt);
+	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "prepareStmt : %d", res);
+
+	res = sqlite3_bind_text(pStmt, 1, value.c_str(), -1, SQLITE_TRANSIENT);
+	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_bind_text : %d", res);
+
+	res = sqlite3_step(pStmt);
+	if (res == SQLITE_ROW) {
+		key = sqlite3_column_int(pStmt, 0);
+	}
+	sqlite3_reset(pStmt);
+	TryReturn(res == SQLITE_ROW, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_step : %d", res);
+
+	keyCache[value] = key;
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyGuardDb::getPackageKey(const std::string& packageId, int& pkgKey)
+{
+	static const std::string PACKAGE_INSERT = std::string("INSERT OR IGNORE INTO Package(PKG_ID) VALUES(?)");
+	static const std::string PACKAGE_SELECT = std::string("SELECT PKG_KEY FROM Package WHERE PKG_ID=?");
+
+	return getDictionaryKey(PACKAGE_INSERT, PACKAGE_SELECT, m_packageKeyCache, packageId, pkgKey);
+}
+
+int
+PrivacyGuardDb::getPrivacyKey(const std::string& privacyId, int& privacyKey)
+{
+	static const std::string PRIVACY_INSERT = std::string("INSERT OR IGNORE INTO Privacy(PRIVACY_ID) VALUES(?)");
+	static const std::string PRIVACY_SELECT = std::string("SELECT PRIVACY_KEY FROM Privacy WHERE PRIVACY_ID=?");
+
+	return getDictionaryKey(PRIVACY_INSERT, PRIVACY_SELECT, m_privacyKeyCache, privacyId, privacyKey);
+}
+
+int
+PrivacyGuardDb::getIntCallback(void* pData, int argc, char** argv, char** colName)
+{
+	if (argc > 0 && argv[0] != NULL) {
+		*static_cast < int* > (pData) = atoi(argv[0]);
+	}
+	return 0;
+}
+
+int
+PrivacyGuardDb::getLogExpiryDay(void)
+{
+	return time(NULL) / SECONDS_PER_DAY - LOG_RETENTION_DAYS;
+}
+
+int
+PrivacyGuardDb::getDailyCountExpiryDay(void)
+{
+	time_t current_date = time(NULL);
+	struct tm expiry_tm;
+	localtime_r(&current_date, &expiry_tm);
+
+	expiry_tm.tm_mon -= DAILY_COUNT_RETENTION_MONTHS;
+
+	return mktime(&expiry_tm) / SECONDS_PER_DAY;
+}
+
+int
+PrivacyGuardDb::setSynchronous(const int level)
+{
+	std::string query = std::string("PRAGMA synchronous = ").append(std::to_string(level));
+
+	int res = sqlite3_exec(m_sqlHandler, query.c_str(), NULL, NULL, NULL);
+	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_exec : %d", res);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyGuardDb::beginLogTransaction(void)
+{
+	// the log level lasts until the transaction ends, the other tables keep DB_SYNCHRONOUS
+	int res = setSynchronous(LOG_SYNCHRONOUS);
+	TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "setSynchronous : %d", res);
+
+	res = sqlite3_exec(m_sqlHandler, "BEGIN IMMEDIATE TRANSACTION", NULL, NULL, NULL);
+	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, setSynchronous(DB_SYNCHRONOUS), "sqlite3_exec : %d", res);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyGuardDb::commitLogTransaction(void)
+{
+	int res = sqlite3_exec(m_sqlHandler, "COMMIT TRANSACTION", NULL, NULL, NULL);
+	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, rollbackLogTransaction(), "sqlite3_exec : %d", res);
+
+	setSynchronous(DB_SYNCHRONOUS);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+void
+PrivacyGuardDb::rollbackLogTransaction(void)
+{
+	sqlite3_exec(m_sqlHandler, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+
+	// keys interned in this transaction are gone with it
+	m_packageKeyCache.clear();
+	m_privacyKeyCache.clear();
+
+	setSynchronous(DB_SYNCHRONOUS);
+}
+
+int
+PrivacyGuardDb::bindDateRange(sqlite3_stmt* pStmt, const int startDate, const int endDate)
+{
+	int res = SQLITE_OK;
+
+	// split [startDate, endDate] into the raw head [?2, ?3], the whole days [?4, ?5] and the raw tail [?6, ?7]
+	sqlite3_int64 firstDay = ((sqlite3_int64)startDate + SECONDS_PER_DAY - 1) / SECONDS_PER_DAY;
+	sqlite3_int64 lastDay = ((sqlite3_int64)endDate + 1) / SECONDS_PER_DAY - 1;
+	sqlite3_int64 headEnd = endDate;
+	sqlite3_int64 tailStart = (sqlite3_int64)endDate + 1;
+
+	// raw rows of expired days are gone, so edge days before the expiry are counted as whole days
+	sqlite3_int64 expiryDay = getLogExpiryDay();
+	if (startDate >= 0 && startDate / SECONDS_PER_DAY < expiryDay) {
+		firstDay = startDate / SECONDS_PER_DAY;
+	}
+	if (endDate >= 0 && endDate / SECONDS_PER_DAY < expiryDay) {
+		lastDay = endDate / SECONDS_PER_DAY;
+	}
+
+	if (startDate < 0 || firstDay > lastDay) {
+		// no whole day in the range, count everything from the raw log
+		firstDay = 1;
+		lastDay = 0;
+	}
+	else {
+		headEnd = firstDay * SECONDS_PER_DAY - 1;
+		tailStart = (lastDay + 1) * SECONDS_PER_DAY;
+	}
+
+	res = sqlite3_bind_int64(pStmt, 2, startDate);
+	TryReturn(res == SQLITE_OK, res, , "sqlite3_bind_int64 : %d", res);
+
+	res = sqlite3_bind_int64(pStmt, 3, headEnd);
+	TryReturn(res == SQLITE_OK, res, , "sqlite3_bind_int64 : %d", res);
+
+	res = sqlite3_bind_int64(pStmt, 4, firstDay);
+	TryReturn(res == SQLITE_OK, res, , "sqlite3_bind_int64 : %d", res);
+
+	res = sqlite3_bind_int64(pStmt, 5, lastDay);
+	TryReturn(res == SQLITE_OK, res, , "sqlite3_bind_int64 : %d", res);
+
+	res = sqlite3_bind_int64(pStmt, 6, tailStart);
+	TryReturn(res == SQLITE_OK, res, , "sqlite3_bind_int64 : %d", res);
+
+	res = sqlite3_bind_int64(pStmt, 7, endDate);
+	TryReturn(res == SQLITE_OK, res, , "sqlite3_bind_int64 : %d", res);
+
+	return SQLITE_OK;
+}
+
+int
+PrivacyGuardDb::migrateDB(void)
+{
+	int res = -1;
+	int version = 1;
+	sqlite3_stmt* pStmt = NULL;
+
+	static const std::string VERSION_SELECT = std::string("SELECT MAX(version) FROM DB_VERSION_0_1");
+
+	res = sqlite3_prepare_v2(m_sqlHandler, VERSION_SELECT.c_str(), -1, &pStmt, NULL);
+	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_prepare_v2 : %d", res);
+
+	if (sqlite3_step(pStmt) == SQLITE_ROW && sqlite3_column_type(pStmt, 0) != SQLITE_NULL) {
+		version = sqlite3_column_int(pStmt, 0);
+	}
+	sqlite3_finalize(pStmt);
+
+	int cnt_migration = sizeof(db_migration_list) / sizeof(db_migration_list[0]);
+
+	for (int i = 0; i < cnt_migration; i++) {
+		if (db_migration_list[i].version <= version) {
+			continue;
+		}
+
+		PF_LOGI("migrate monitor db from version %d to %d", version, db_migration_list[i].version);
+
+		// the upgrade and its version mark are committed together
+		std::string query = std::string("BEGIN IMMEDIATE TRANSACTION;");
+		query.append(db_migration_list[i].query);
+		query.append("DELETE FROM DB_VERSION_0_1;");
+		query.append("INSERT INTO DB_VERSION_0_1(version) VALUES(").append(std::to_string(db_migration_list[i].version)).append(");");
+		query.append("COMMIT;");
+
+		char* pErrMsg = NULL;
+		res = sqlite3_exec(m_sqlHandler, query.c_str(), NULL, NULL, &pErrMsg);
+		if (res != SQLITE_OK) {
+			PF_LOGE("fail : migrate monitor db to version %d (%d) : %s", db_migration_list[i].version, res, pErrMsg);
+			sqlite3_free(pErrMsg);
+			sqlite3_exec(m_sqlHandler, "ROLLBACK;", NULL, NULL, NULL);
+			return PRIV_FLTR_ERROR_DB_ERROR;
+		}
+
+		version = db_migration_list[i].version;
+	}
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyGuardDb::enableIncrementalVacuum(void)
+{
+	int autoVacuum = 0;
+
+	int res = sqlite3_exec(m_sqlHandler, "PRAGMA auto_vacuum", getIntCallback, &autoVacuum, NULL);
+	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_exec : %d", res);
+
+	// 2 : INCREMENTAL
+	if (autoVacuum == 2) {
+		return PRIV_FLTR_ERROR_SUCCESS;
+	}
+
+	// a db created without it needs one full VACUUM to switch the mode, seconds on a large log
+	PF_LOGI("convert monitor db to incremental vacuum");
+	res = sqlite3_exec(m_sqlHandler, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", NULL, NULL, NULL);
+	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_exec : %d", res);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
 void
 PrivacyGuardDb::openSqliteDB(void)
 {
@@ -60,7 +555,26 @@ PrivacyGuardDb::openSqliteDB(void)
 	res = sqlite3_open_v2(PRIVACY_DB_PATH, &m_sqlHandler, SQLITE_OPEN_READWRITE, NULL);
 	if(res == SQLITE_OK)	{
 		PF_LOGI("monitor db is opened successfully");
-//		sqlite3_wal_autocheckpoint(m_sqlHandler, 1);
+
+		// WAL lets the reader pool run next to the writer, checkpoints are done by walHook
+		res = sqlite3_exec(m_sqlHandler, "PRAGMA journal_mode = WAL", NULL, NULL, NULL);
+		if (res != SQLITE_OK) {
+			PF_LOGE("fail : monitor db journal_mode(%d)", res);
+		}
+		setSynchronous(DB_SYNCHRONOUS);
+		sqlite3_busy_timeout(m_sqlHandler, BUSY_TIMEOUT_MS);
+		sqlite3_wal_autocheckpoint(m_sqlHandler, 0);
+		sqlite3_wal_hook(m_sqlHandler, walHook, this);
+
+		// the queries need the schema of the last version, a db that failed to upgrade isn't served
+		res = migrateDB();
+		if (res != PRIV_FLTR_ERROR_SUCCESS) {
+			PF_LOGE("fail : monitor db migration(%d), the next call retries it", res);
+			finalizeStmtCache();
+			sqlite3_close(m_sqlHandler);
+			m_sqlHandler = NULL;
+			return;
+		}
 		m_bDBOpen = true;
 	}
 	else {
@@ -81,43 +595,121 @@ PrivacyGuardDb::PgAddPrivacyAccessLog(const int userId, std::list < std::pair <
 
 	int res = -1;
 
-	static const std::string QUERY_INSERT = std::string("INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_ID, PRIVACY_ID, USE_DATE) VALUES(?, ?, ?, ?)");
+	static const std::string QUERY_INSERT = std::string("INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DATE) VALUES(?, ?, ?, ?)");
 
-	m_dbMutex.lock();
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
 
 	PF_LOGD("addlogToDb m_sqlHandler : %p", m_sqlHandler);
 
+	// one transaction for the whole list, so the rows cost a single commit
+	res = beginLogTransaction();
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, unlockWriter(), res, "beginLogTransaction : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
+
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, QUERY_INSERT.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(QUERY_INSERT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
 	for (std::list <std::pair <std::string, std::string>>::iterator iter = logInfoList.begin(); iter != logInfoList.end(); ++iter) {
 		PF_LOGD("packageID : %s, PrivacyID : %s", iter->first.c_str(), iter->second.c_str());
 
+		int pkgKey = 0, privacyKey = 0;
+		res = getPackageKey(iter->first, pkgKey);
+		TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, rollbackLogTransaction(); unlockWriter(), res, "getPackageKey : %d", res);
+
+		res = getPrivacyKey(iter->second, privacyKey);
+		TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, rollbackLogTransaction(); unlockWriter(), res, "getPrivacyKey : %d", res);
+
 		// bind
-		res = sqlite3_bind_int(m_stmt, 1, userId);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+		res = sqlite3_bind_int(pStmt, 1, userId);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-		res = sqlite3_bind_text(m_stmt, 2, iter->first.c_str(), -1, SQLITE_TRANSIENT);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+		res = sqlite3_bind_int(pStmt, 2, pkgKey);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-		res = sqlite3_bind_text(m_stmt, 3, iter->second.c_str(), -1, SQLITE_TRANSIENT);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+		res = sqlite3_bind_int(pStmt, 3, privacyKey);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-		res = sqlite3_bind_int(m_stmt, 4, current_date);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+		res = sqlite3_bind_int(pStmt, 4, current_date);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-		res = sqlite3_step(m_stmt);
-		TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+		res = sqlite3_step(pStmt);
+		TryCatchResLogReturn(res == SQLITE_DONE, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
 
-		sqlite3_reset(m_stmt);
+		sqlite3_reset(pStmt);
 	}
-	m_dbMutex.unlock();
+
+	res = commitLogTransaction();
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, unlockWriter(), res, "commitLogTransaction : %d", res);
+
+	unlockWriter();
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyGuardDb::PgAddPrivacyAccessLogs(const std::list < access_log_s >& logList)
+{
+	int res = -1;
+
+	static const std::string QUERY_INSERT = std::string("INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DATE) VALUES(?, ?, ?, ?)");
+
+	lockWriter();
+	// open db
+	if(m_bDBOpen == false) {
+		openSqliteDB();
+	}
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	PF_LOGD("addlogToDb m_sqlHandler : %p", m_sqlHandler);
+
+	// records of several users and clients, all in one transaction
+	res = beginLogTransaction();
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, unlockWriter(), res, "beginLogTransaction : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
+
+	// prepare
+	res = prepareStmt(QUERY_INSERT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
+
+	for (std::list < access_log_s >::const_iterator iter = logList.begin(); iter != logList.end(); ++iter) {
+		int pkgKey = 0, privacyKey = 0;
+		res = getPackageKey(iter->package_id, pkgKey);
+		TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, rollbackLogTransaction(); unlockWriter(), res, "getPackageKey : %d", res);
+
+		res = getPrivacyKey(iter->privacy_id, privacyKey);
+		TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, rollbackLogTransaction(); unlockWriter(), res, "getPrivacyKey : %d", res);
+
+		// bind
+		res = sqlite3_bind_int(pStmt, 1, iter->user_id);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+		res = sqlite3_bind_int(pStmt, 2, pkgKey);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+		res = sqlite3_bind_int(pStmt, 3, privacyKey);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+		res = sqlite3_bind_int(pStmt, 4, iter->use_date);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+		res = sqlite3_step(pStmt);
+		TryCatchResLogReturn(res == SQLITE_DONE, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+
+		sqlite3_reset(pStmt);
+	}
+
+	res = commitLogTransaction();
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, unlockWriter(), res, "commitLogTransaction : %d", res);
+
+	unlockWriter();
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -143,40 +735,55 @@ PrivacyGuardDb::PgAddPrivacyAccessLogForCynara(const int userId, const std::stri
 	time_t logging_date;
 	logging_date = timestamp->tv_sec;
 
-	static const std::string QUERY_INSERT = std::string("INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_ID, PRIVACY_ID, USE_DATE) VALUES(?, ?, ?, ?)");
+	static const std::string QUERY_INSERT = std::string("INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DATE) VALUES(?, ?, ?, ?)");
 
-	m_dbMutex.lock();
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
 
 	PF_LOGD("addlogToDb m_sqlHandler : %p", m_sqlHandler);
 
+	res = beginLogTransaction();
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, unlockWriter(), res, "beginLogTransaction : %d", res);
+
+	int pkgKey = 0, privacyKey = 0;
+	res = getPackageKey(packageId, pkgKey);
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, rollbackLogTransaction(); unlockWriter(), res, "getPackageKey : %d", res);
+
+	res = getPrivacyKey(privacyId, privacyKey);
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, rollbackLogTransaction(); unlockWriter(), res, "getPrivacyKey : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
+
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, QUERY_INSERT.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(QUERY_INSERT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_text(m_stmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_int(pStmt, 2, pkgKey);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_text(m_stmt, 3, privacyId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_int(pStmt, 3, privacyKey);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_int(m_stmt, 4, logging_date);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 4, logging_date);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
 
-	sqlite3_reset(m_stmt);
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	res = commitLogTransaction();
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, unlockWriter(), res, "commitLogTransaction : %d", res);
+
+	unlockWriter();
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -194,87 +801,112 @@ PrivacyGuardDb::PgAddPrivacyAccessLogTest(const int userId, const std::string pa
 
 	int res = SQLITE_OK;
 
-	static const std::string QUERY_INSERT = std::string("INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_ID, PRIVACY_ID, USE_DATE) VALUES(?, ?, ?, ?)");
+	static const std::string QUERY_INSERT = std::string("INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DATE) VALUES(?, ?, ?, ?)");
 
-	m_dbMutex.lock();
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	PF_LOGD("addlogToDb m_sqlHandler : %p", m_sqlHandler);
+
+	res = beginLogTransaction();
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, unlockWriter(), res, "beginLogTransaction : %d", res);
 
-	PF_LOGD("addlogToDb m_sqlHandler : %p", m_sqlHandler);
+	int pkgKey = 0, privacyKey = 0;
+	res = getPackageKey(packageId, pkgKey);
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, rollbackLogTransaction(); unlockWriter(), res, "getPackageKey : %d", res);
+
+	res = getPrivacyKey(privacyId, privacyKey);
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, rollbackLogTransaction(); unlockWriter(), res, "getPrivacyKey : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, QUERY_INSERT.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(QUERY_INSERT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_text(m_stmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_int(pStmt, 2, pkgKey);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_text(m_stmt, 3, privacyId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_int(pStmt, 3, privacyKey);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_int(m_stmt, 4, current_date);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 4, current_date);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, rollbackLogTransaction(); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
 
-	sqlite3_reset(m_stmt);
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	res = commitLogTransaction();
+	TryCatchResLogReturn(res == PRIV_FLTR_ERROR_SUCCESS, unlockWriter(), res, "commitLogTransaction : %d", res);
+
+	unlockWriter();
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
 
 
 int
-PrivacyGuardDb::PgAddMonitorPolicy(const int userId, const std::string packageId, const std::list < std::string > privacyList, bool monitorPolicy)
+PrivacyGuardDb::PgAddMonitorPolicy(const int userId, const std::string packageId, const std::list < std::string > privacyList, const int monitorPolicy)
 {
 	int res = -1;
 
 	static const std::string QUERY_INSERT = std::string("INSERT INTO MonitorPolicy(USER_ID, PKG_ID, PRIVACY_ID, MONITOR_POLICY) VALUES(?, ?, ?, ?)");
 
-	m_dbMutex.lock();
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
 
 	PF_LOGD("addlogToDb m_sqlHandler : %p", m_sqlHandler);
 
+	sqlite3_stmt* pStmt = NULL;
+
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, QUERY_INSERT.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(QUERY_INSERT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
+
+	// the list is added whole or not at all, the clients are told of every policy in it
+	res = sqlite3_exec(m_sqlHandler, "BEGIN IMMEDIATE TRANSACTION", NULL, NULL, NULL);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_exec : %d", res);
 
 	for (std::list <std::string>::const_iterator iter = privacyList.begin(); iter != privacyList.end(); ++iter) {
 		PF_LOGD("PrivacyID : %s", iter->c_str());
 
 		// bind
-		res = sqlite3_bind_int(m_stmt, 1, userId);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+		res = sqlite3_bind_int(pStmt, 1, userId);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackTransaction(m_sqlHandler, pStmt); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-		res = sqlite3_bind_text(m_stmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+		res = sqlite3_bind_text(pStmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackTransaction(m_sqlHandler, pStmt); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
-		res = sqlite3_bind_text(m_stmt, 3, iter->c_str(), -1, SQLITE_TRANSIENT);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+		res = sqlite3_bind_text(pStmt, 3, iter->c_str(), -1, SQLITE_TRANSIENT);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackTransaction(m_sqlHandler, pStmt); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
-		res = sqlite3_bind_int(m_stmt, 4, monitorPolicy);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+		res = sqlite3_bind_int(pStmt, 4, monitorPolicy);
+		TryCatchResLogReturn(res == SQLITE_OK, rollbackTransaction(m_sqlHandler, pStmt); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-		res = sqlite3_step(m_stmt);
-		TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+		res = sqlite3_step(pStmt);
+		TryCatchResLogReturn(res == SQLITE_DONE, rollbackTransaction(m_sqlHandler, pStmt); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
 
-		sqlite3_reset(m_stmt);
+		sqlite3_reset(pStmt);
 	}
-	m_dbMutex.unlock();
+
+	res = sqlite3_exec(m_sqlHandler, "COMMIT TRANSACTION", NULL, NULL, NULL);
+	TryCatchResLogReturn(res == SQLITE_OK, rollbackTransaction(m_sqlHandler, pStmt); unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_exec : %d", res);
+
+	unlockWriter();
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -285,31 +917,30 @@ PrivacyGuardDb::PgCheckPrivacyPackage(const int userId, const std::string packag
 	int res = -1;
 	static const std::string query = std::string("SELECT COUNT(*) FROM MonitorPolicy WHERE USER_ID=? AND PKG_ID=?");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
-	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, query.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn( res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, query, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_text(m_stmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_text(pStmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
 	int count = -1;
 
 	// step
-	if ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
-		count = sqlite3_column_int(m_stmt, 0);
+	if ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
+		count = sqlite3_column_int(pStmt, 0);
 	}
-	m_dbMutex.unlock();
+	sqlite3_reset(pStmt);
+	releaseReader(pReader);
 
 	if (count > 0) {
 		isPrivacyPackage = true;
@@ -329,36 +960,49 @@ PrivacyGuardDb::PgDeleteAllLogsAndMonitorPolicy(void)
 	int res = -1;
 
 	static const std::string LOG_DELETE = std::string("DELETE FROM StatisticsMonitorInfo");
+	static const std::string DAILY_COUNT_DELETE = std::string("DELETE FROM StatisticsDailyCount");
 	static const std::string POLICY_DELETE = std::string("DELETE FROM MonitorPolicy");
 	static const std::string MAIN_POLICY_DELETE = std::string("DELETE FROM MainMonitorPolicy");
 
-	m_dbMutex.lock();
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, LOG_DELETE.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(LOG_DELETE, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
 
-	res = sqlite3_prepare_v2(m_sqlHandler, POLICY_DELETE.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(DAILY_COUNT_DELETE, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
 
-	res = sqlite3_prepare_v2(m_sqlHandler, MAIN_POLICY_DELETE.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(POLICY_DELETE, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	res = prepareStmt(MAIN_POLICY_DELETE, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
+
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
+
+	unlockWriter();
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -371,28 +1015,50 @@ PrivacyGuardDb::PgDeleteLogsByPackageId(const std::string packageId)
 
 	int res = -1;
 
-	static const std::string QUERY_DELETE = std::string("DELETE FROM StatisticsMonitorInfo WHERE PKG_ID=?");
-
-	m_dbMutex.lock();
+	// the indexes lead with USER_ID, so the users are walked one MIN(USER_ID) step at a time
+	// and the package is searched per user instead of scanning the whole log
+	static const std::string QUERY_DELETE = std::string("DELETE FROM StatisticsMonitorInfo WHERE USER_ID IN ("
+		"WITH RECURSIVE U(ID) AS (SELECT MIN(USER_ID) FROM StatisticsMonitorInfo "
+		"UNION ALL SELECT (SELECT MIN(USER_ID) FROM StatisticsMonitorInfo WHERE USER_ID>U.ID) FROM U WHERE U.ID IS NOT NULL) SELECT ID FROM U) "
+		"AND PKG_KEY=(SELECT PKG_KEY FROM Package WHERE PKG_ID=?)");
+	static const std::string DAILY_COUNT_DELETE = std::string("DELETE FROM StatisticsDailyCount WHERE USER_ID IN ("
+		"WITH RECURSIVE U(ID) AS (SELECT MIN(USER_ID) FROM StatisticsDailyCount "
+		"UNION ALL SELECT (SELECT MIN(USER_ID) FROM StatisticsDailyCount WHERE USER_ID>U.ID) FROM U WHERE U.ID IS NOT NULL) SELECT ID FROM U) "
+		"AND PKG_KEY=(SELECT PKG_KEY FROM Package WHERE PKG_ID=?)");
+
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, QUERY_DELETE.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(QUERY_DELETE, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_text(m_stmt, 1, packageId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_text(pStmt, 1, packageId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
 	// step
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	res = prepareStmt(DAILY_COUNT_DELETE, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
+
+	res = sqlite3_bind_text(pStmt, 1, packageId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
+
+	unlockWriter();
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -404,28 +1070,35 @@ PrivacyGuardDb::PgDeleteMonitorPolicyByPackageId(const std::string packageId)
 
 	int res = -1;
 
-	static const std::string QUERY_DELETE = std::string("DELETE FROM MonitorPolicy WHERE PKG_ID=?");
+	// walks the users like PgDeleteLogsByPackageId, the primary key leads with USER_ID
+	static const std::string QUERY_DELETE = std::string("DELETE FROM MonitorPolicy WHERE USER_ID IN ("
+		"WITH RECURSIVE U(ID) AS (SELECT MIN(USER_ID) FROM MonitorPolicy "
+		"UNION ALL SELECT (SELECT MIN(USER_ID) FROM MonitorPolicy WHERE USER_ID>U.ID) FROM U WHERE U.ID IS NOT NULL) SELECT ID FROM U) "
+		"AND PKG_ID=?");
 
-	m_dbMutex.lock();
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, QUERY_DELETE.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(QUERY_DELETE, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_text(m_stmt, 1, packageId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_text(pStmt, 1, packageId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
 	// step
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	unlockWriter();
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -459,60 +1132,42 @@ PrivacyGuardDb::PgForeachTotalPrivacyCountOfPackage(const int userId, const int
 	}
 #endif
 
-	static const std::string PKGID_SELECT = std::string("SELECT DISTINCT PKG_ID FROM StatisticsMonitorInfo WHERE USER_ID=? AND USE_DATE>=? AND USE_DATE<=?");
-	static const std::string PKGINFO_SELECT = std::string("SELECT COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=? AND PKG_ID=? AND USE_DATE>=? AND USE_DATE<=?");
-	sqlite3_stmt* infoStmt;
+	// full days are counted from the daily rollup, the partial days at both edges from the raw log.
+	// "GROUP BY +KEY" keeps the planner on the date range index instead of an index sorted by the key.
+	static const std::string PKGINFO_SELECT = std::string("SELECT P.PKG_ID, SUM(S.CNT) FROM ("
+		"SELECT PKG_KEY, COUNT(*) AS CNT FROM StatisticsMonitorInfo WHERE USER_ID=?1 AND USE_DATE>=?2 AND USE_DATE<=?3 GROUP BY +PKG_KEY "
+		"UNION ALL SELECT PKG_KEY, SUM(USE_COUNT) FROM StatisticsDailyCount WHERE USER_ID=?1 AND USE_DAY>=?4 AND USE_DAY<=?5 GROUP BY +PKG_KEY "
+		"UNION ALL SELECT PKG_KEY, COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=?1 AND USE_DATE>=?6 AND USE_DATE<=?7 GROUP BY +PKG_KEY) S "
+		"JOIN Package P ON P.PKG_KEY=S.PKG_KEY GROUP BY S.PKG_KEY");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
-	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	// statistics are read on a pooled reader, next to the log writer
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
 
-	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, PKGID_SELECT.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	sqlite3_stmt* pStmt = NULL;
 
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	// prepare
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, PKGINFO_SELECT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
 
-	res = sqlite3_bind_int(m_stmt, 2, startDate);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	// bind
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_int(m_stmt, 3, endDate);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = bindDateRange(pStmt, startDate, endDate);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "bindDateRange : %d", res);
 
-	while ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
-		const char* packageId = reinterpret_cast < const char* > (sqlite3_column_text(m_stmt, 0));
+	// step : one row per package
+	while ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
+		const char* packageId = reinterpret_cast < const char* > (sqlite3_column_text(pStmt, 0));
 		if(packageId == NULL) {	continue; }
 
-		// prepare
-		res = sqlite3_prepare_v2(m_sqlHandler, PKGINFO_SELECT.c_str(), -1, &infoStmt, NULL);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
-
-		res = sqlite3_bind_int(infoStmt, 1, userId);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
-
-		res = sqlite3_bind_text(infoStmt, 2, packageId, -1, SQLITE_TRANSIENT);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
-
-		res = sqlite3_bind_int(infoStmt, 3, startDate);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
-
-		res = sqlite3_bind_int(infoStmt, 4, endDate);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
-
-		while ((res = sqlite3_step(infoStmt)) == SQLITE_ROW) {
-			int count = sqlite3_column_int(infoStmt, 0);
-			if (count == 0) {
-				continue;
-			}
-			packageInfoList.push_back(std::pair <std::string, int> (std::string(packageId), count));
-		}
-		sqlite3_reset(infoStmt);
+		int count = sqlite3_column_int(pStmt, 1);
+		packageInfoList.push_back(std::pair <std::string, int> (std::string(packageId), count));
 	}
-	m_dbMutex.unlock();
+	sqlite3_reset(pStmt);
+
+	releaseReader(pReader);
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -546,50 +1201,52 @@ PrivacyGuardDb::PgForeachTotalPrivacyCountOfPrivacy(const int userId, const int
 	}
 #endif
 
-	static const std::string PRIVACY_SELECT = std::string("SELECT COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=? AND PRIVACY_ID=? AND USE_DATE>=? AND USE_DATE<=?");
+	static const std::string PRIVACY_SELECT = std::string("SELECT V.PRIVACY_ID, SUM(S.CNT) FROM ("
+		"SELECT PRIVACY_KEY, COUNT(*) AS CNT FROM StatisticsMonitorInfo WHERE USER_ID=?1 AND USE_DATE>=?2 AND USE_DATE<=?3 GROUP BY +PRIVACY_KEY "
+		"UNION ALL SELECT PRIVACY_KEY, SUM(USE_COUNT) FROM StatisticsDailyCount WHERE USER_ID=?1 AND USE_DAY>=?4 AND USE_DAY<=?5 GROUP BY +PRIVACY_KEY "
+		"UNION ALL SELECT PRIVACY_KEY, COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=?1 AND USE_DATE>=?6 AND USE_DATE<=?7 GROUP BY +PRIVACY_KEY) S "
+		"JOIN Privacy V ON V.PRIVACY_KEY=S.PRIVACY_KEY GROUP BY S.PRIVACY_KEY");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
+
+	// prepare
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, PRIVACY_SELECT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
+
+	// bind
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+	res = bindDateRange(pStmt, startDate, endDate);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "bindDateRange : %d", res);
+
+	// step : one row per privacy
+	std::map < std::string, int > privacyCount;
+	while ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
+		const char* privacyId = reinterpret_cast < const char* > (sqlite3_column_text(pStmt, 0));
+		if(privacyId == NULL) {	continue; }
+
+		privacyCount[std::string(privacyId)] = sqlite3_column_int(pStmt, 1);
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	sqlite3_reset(pStmt);
+
+	releaseReader(pReader);
 
+	// report the monitored privacies only, in the order of privacy_list
 	int i;
 	int cnt_privacy = sizeof(privacy_list) / sizeof(privacy_list[0]);
 
 	for (i = 0; i < cnt_privacy; i++) {
-		// prepare
-		res = sqlite3_prepare_v2(m_sqlHandler, PRIVACY_SELECT.c_str(), -1, &m_stmt, NULL);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
-
-		// bind
-		res = sqlite3_bind_int(m_stmt, 1, userId);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
-
-		res = sqlite3_bind_text(m_stmt, 2, privacy_list[i], -1, SQLITE_TRANSIENT);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
-
-		res = sqlite3_bind_int(m_stmt, 3, startDate);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
-
-		res = sqlite3_bind_int(m_stmt, 4, endDate);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
-
-		// step
-		if ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
-			int count = sqlite3_column_int(m_stmt, 0);
-			if (count == 0) {
-				continue;
-			}
-			const char* privacyId = privacy_list[i];
-			privacyInfoList.push_back(std::pair <std::string, int> (std::string(privacyId), count));
+		std::map < std::string, int >::iterator iter = privacyCount.find(std::string(privacy_list[i]));
+		if (iter == privacyCount.end() || iter->second == 0) {
+			continue;
 		}
-		sqlite3_reset(m_stmt);
+		privacyInfoList.push_back(std::pair <std::string, int> (iter->first, iter->second));
 	}
 
-	m_dbMutex.unlock();
-
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
 
@@ -622,69 +1279,42 @@ PrivacyGuardDb::PgForeachPrivacyCountByPrivacyId(const int userId, const int sta
 	}
 #endif
 
-	static const std::string PKGID_SELECT = std::string("SELECT DISTINCT PKG_ID FROM StatisticsMonitorInfo WHERE USER_ID=? AND PRIVACY_ID=? AND USE_DATE>=? AND USE_DATE<=?");
-	static const std::string PKGINFO_SELECT = std::string("SELECT COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=? AND PKG_ID=? AND PRIVACY_ID=? AND USE_DATE>=? AND USE_DATE<=?");
-	sqlite3_stmt* infoStmt;
+	static const std::string PKGINFO_SELECT = std::string("SELECT P.PKG_ID, SUM(S.CNT) FROM ("
+		"SELECT PKG_KEY, COUNT(*) AS CNT FROM StatisticsMonitorInfo WHERE USER_ID=?1 AND PRIVACY_KEY=(SELECT PRIVACY_KEY FROM Privacy WHERE PRIVACY_ID=?8) AND USE_DATE>=?2 AND USE_DATE<=?3 GROUP BY +PKG_KEY "
+		"UNION ALL SELECT PKG_KEY, SUM(USE_COUNT) FROM StatisticsDailyCount WHERE USER_ID=?1 AND PRIVACY_KEY=(SELECT PRIVACY_KEY FROM Privacy WHERE PRIVACY_ID=?8) AND USE_DAY>=?4 AND USE_DAY<=?5 GROUP BY +PKG_KEY "
+		"UNION ALL SELECT PKG_KEY, COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=?1 AND PRIVACY_KEY=(SELECT PRIVACY_KEY FROM Privacy WHERE PRIVACY_ID=?8) AND USE_DATE>=?6 AND USE_DATE<=?7 GROUP BY +PKG_KEY) S "
+		"JOIN Package P ON P.PKG_KEY=S.PKG_KEY GROUP BY S.PKG_KEY");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
-	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, PKGID_SELECT.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, PKGINFO_SELECT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_bind_int : %d", res);
-
-	res = sqlite3_bind_text(m_stmt, 2, privacyId.c_str(), -1, SQLITE_TRANSIENT);
-	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_int(m_stmt, 3, startDate);
-	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_bind_int : %d", res);
+	res = bindDateRange(pStmt, startDate, endDate);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "bindDateRange : %d", res);
 
-	res = sqlite3_bind_int(m_stmt, 4, endDate);
-	TryReturn(res == SQLITE_OK, PRIV_FLTR_ERROR_DB_ERROR, , "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_text(pStmt, 8, privacyId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
-	while ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
-		const char* packageId =  reinterpret_cast < const char* > (sqlite3_column_text(m_stmt, 0));
+	// step : one row per package
+	while ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
+		const char* packageId = reinterpret_cast < const char* > (sqlite3_column_text(pStmt, 0));
 		if(packageId == NULL) {	continue; }
 
-		// prepare
-		res = sqlite3_prepare_v2(m_sqlHandler, PKGINFO_SELECT.c_str(), -1, &infoStmt, NULL);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
-
-		// bind
-		res = sqlite3_bind_int(infoStmt, 1, userId);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
-
-		res = sqlite3_bind_text(infoStmt, 2, packageId, -1, SQLITE_TRANSIENT);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
-
-		res = sqlite3_bind_text(infoStmt, 3, privacyId.c_str(), -1, SQLITE_TRANSIENT);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
-
-		res = sqlite3_bind_int(infoStmt, 4, startDate);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
-
-		res = sqlite3_bind_int(infoStmt, 5, endDate);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
-
-		if ((res = sqlite3_step(infoStmt)) == SQLITE_ROW) {
-			int count = sqlite3_column_int(infoStmt, 0);
-			if (count == 0) {
-				continue;
-			}
-			packageInfoList.push_back(std::pair <std::string, int> (std::string(packageId), count));
-		}
-		sqlite3_reset(infoStmt);
+		int count = sqlite3_column_int(pStmt, 1);
+		packageInfoList.push_back(std::pair <std::string, int> (std::string(packageId), count));
 	}
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	releaseReader(pReader);
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -718,52 +1348,55 @@ PrivacyGuardDb::PgForeachPrivacyCountByPackageId(const int userId, const int sta
 	}
 #endif
 
-	static const std::string PRIVACY_SELECT = std::string("SELECT COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=? AND PKG_ID=? AND PRIVACY_ID=? AND USE_DATE>=? AND USE_DATE<=?");
+	static const std::string PRIVACY_SELECT = std::string("SELECT V.PRIVACY_ID, SUM(S.CNT) FROM ("
+		"SELECT PRIVACY_KEY, COUNT(*) AS CNT FROM StatisticsMonitorInfo WHERE USER_ID=?1 AND PKG_KEY=(SELECT PKG_KEY FROM Package WHERE PKG_ID=?8) AND USE_DATE>=?2 AND USE_DATE<=?3 GROUP BY +PRIVACY_KEY "
+		"UNION ALL SELECT PRIVACY_KEY, SUM(USE_COUNT) FROM StatisticsDailyCount WHERE USER_ID=?1 AND PKG_KEY=(SELECT PKG_KEY FROM Package WHERE PKG_ID=?8) AND USE_DAY>=?4 AND USE_DAY<=?5 GROUP BY +PRIVACY_KEY "
+		"UNION ALL SELECT PRIVACY_KEY, COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=?1 AND PKG_KEY=(SELECT PKG_KEY FROM Package WHERE PKG_ID=?8) AND USE_DATE>=?6 AND USE_DATE<=?7 GROUP BY +PRIVACY_KEY) S "
+		"JOIN Privacy V ON V.PRIVACY_KEY=S.PRIVACY_KEY GROUP BY S.PRIVACY_KEY");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
-	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
 
-	int i;
-	int cnt_privacy = sizeof(privacy_list) / sizeof(privacy_list[0]);
+	sqlite3_stmt* pStmt = NULL;
 
-	for (i = 0; i < cnt_privacy; i++) {
-		// prepare
-		res = sqlite3_prepare_v2(m_sqlHandler, PRIVACY_SELECT.c_str(), -1, &m_stmt, NULL);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	// prepare
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, PRIVACY_SELECT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
+
+	// bind
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+	res = bindDateRange(pStmt, startDate, endDate);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "bindDateRange : %d", res);
 
-		//bind
-		res = sqlite3_bind_int(m_stmt, 1, userId);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_text(pStmt, 8, packageId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
-		res = sqlite3_bind_text(m_stmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	// step : one row per privacy
+	std::map < std::string, int > privacyCount;
+	while ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
+		const char* privacyId = reinterpret_cast < const char* > (sqlite3_column_text(pStmt, 0));
+		if(privacyId == NULL) {	continue; }
 
-		res = sqlite3_bind_text(m_stmt, 3, privacy_list[i], -1, SQLITE_TRANSIENT);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+		privacyCount[std::string(privacyId)] = sqlite3_column_int(pStmt, 1);
+	}
+	sqlite3_reset(pStmt);
 
-		res = sqlite3_bind_int(m_stmt, 4, startDate);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	releaseReader(pReader);
 
-		res = sqlite3_bind_int(m_stmt, 5, endDate);
-		TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	// report the monitored privacies only, in the order of privacy_list
+	int i;
+	int cnt_privacy = sizeof(privacy_list) / sizeof(privacy_list[0]);
 
-		if ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
-			int count = sqlite3_column_int(m_stmt, 0);
-			if (count == 0) {
-				continue;
-			}
-			const char* privacyId = privacy_list[i];
-			privacyInfoList.push_back(std::pair <std::string, int> (std::string(privacyId), count));
+	for (i = 0; i < cnt_privacy; i++) {
+		std::map < std::string, int >::iterator iter = privacyCount.find(std::string(privacy_list[i]));
+		if (iter == privacyCount.end() || iter->second == 0) {
+			continue;
 		}
-		sqlite3_reset(m_stmt);
+		privacyInfoList.push_back(std::pair <std::string, int> (iter->first, iter->second));
 	}
 
-	m_dbMutex.unlock();
-
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
 
@@ -774,33 +1407,32 @@ PrivacyGuardDb::PgGetMonitorPolicy(const int userId, const std::string packageId
 	int res = -1;
 	static const std::string query = std::string("SELECT MONITOR_POLICY FROM MonitorPolicy WHERE USER_ID=? AND PKG_ID=? AND PRIVACY_ID=?");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
-	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, query.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, query, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 	
-	res = sqlite3_bind_text(m_stmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_text(pStmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
-	res = sqlite3_bind_text(m_stmt, 3, privacyId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_text(pStmt, 3, privacyId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
 	// step
 	monitorPolicy = 0;
-	if ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
-		monitorPolicy = sqlite3_column_int(m_stmt, 0);
+	if ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
+		monitorPolicy = sqlite3_column_int(pStmt, 0);
 	}
-	m_dbMutex.unlock();
+	sqlite3_reset(pStmt);
+	releaseReader(pReader);
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -812,34 +1444,35 @@ PrivacyGuardDb::PgGetAllMonitorPolicy(std::list < std::pair < std::string, int >
 
 	static const std::string MONITOR_POLICY_SELECT = std::string("SELECT * FROM MonitorPolicy");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
-	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, MONITOR_POLICY_SELECT.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, MONITOR_POLICY_SELECT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
 
 	// step
 	int monitorPolicy = 0;
-	while ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
-		int userId = sqlite3_column_int(m_stmt, 0);
-		char* tmpPkgId = (char*)sqlite3_column_text(m_stmt, 1);
-		char* tmpPrivacyId = (char*)sqlite3_column_text(m_stmt, 2);
+	while ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
+		int userId = sqlite3_column_int(pStmt, 0);
+		char* tmpPkgId = (char*)sqlite3_column_text(pStmt, 1);
+		char* tmpPrivacyId = (char*)sqlite3_column_text(pStmt, 2);
 		if(tmpPkgId == NULL || tmpPrivacyId == NULL) {
 			continue;
 		}
 		std::string userPkgIdPrivacyId = std::to_string(userId);
 		userPkgIdPrivacyId.append("|").append(std::string(tmpPkgId));
 		userPkgIdPrivacyId.append("|").append(std::string(tmpPrivacyId));
-		monitorPolicy = sqlite3_column_int(m_stmt, 3);
+		monitorPolicy = sqlite3_column_int(pStmt, 3);
 		monitorPolicyList.push_back(std::pair < std::string, int > (userPkgIdPrivacyId, monitorPolicy));
 	}
+	// a step that fails leaves a part of the table, it is not taken for all of it
+	TryCatchResLogReturn(res == SQLITE_DONE, sqlite3_reset(pStmt); releaseReader(pReader); monitorPolicyList.clear(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	releaseReader(pReader);
 	if(monitorPolicyList.size() > 0) {
 		res = PRIV_FLTR_ERROR_SUCCESS;
 	}
@@ -856,38 +1489,37 @@ PrivacyGuardDb::PgForeachMonitorPolicyByPackageId(const int userId, const std::s
 	int res = -1;
 	static const std::string query = std::string("SELECT DISTINCT PRIVACY_ID, MONITOR_POLICY FROM MonitorPolicy WHERE USER_ID=? AND PKG_ID=?");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
-	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, query.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock();, PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, query, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_text(m_stmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_text(pStmt, 2, packageId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
 	// step
-	while ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
+	while ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
 
-		char* tmp_data = (char*)sqlite3_column_text(m_stmt, 0);
+		char* tmp_data = (char*)sqlite3_column_text(pStmt, 0);
 		if(tmp_data == NULL) {
 			continue;
 		}
 		privacy_data_s p_data;
 		p_data.privacy_id = strdup(tmp_data);
-		p_data.monitor_policy= sqlite3_column_int(m_stmt, 1);
+		p_data.monitor_policy= sqlite3_column_int(pStmt, 1);
 
 		privacyInfoList.push_back(p_data);
 	}
-	m_dbMutex.unlock();
+	sqlite3_reset(pStmt);
+	releaseReader(pReader);
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -898,30 +1530,29 @@ PrivacyGuardDb::PgForeachPrivacyPackageId(const int userId, std::list < std::str
 	int res = -1;
 	static const std::string query = std::string("SELECT DISTINCT PKG_ID FROM MonitorPolicy WHERE USER_ID=?");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
-	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, query.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock();, PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, query, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
 	// step
-	while ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
-		char* p_data = (char*)sqlite3_column_text(m_stmt, 0);
+	while ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
+		char* p_data = (char*)sqlite3_column_text(pStmt, 0);
 		if(p_data == NULL) {
 			continue;
 		}
 		packageList.push_back(std::string(p_data));
 	}
-	m_dbMutex.unlock();
+	sqlite3_reset(pStmt);
+	releaseReader(pReader);
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -932,33 +1563,32 @@ PrivacyGuardDb::PgForeachPackageByPrivacyId(const int userId, const std::string
 	int res = -1;
 	static const std::string query = std::string("SELECT DISTINCT PKG_ID FROM MonitorPolicy WHERE USER_ID=? AND PRIVACY_ID=?");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
-	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, query.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock();, PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, query, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_text(m_stmt, 2, privacyId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_text(pStmt, 2, privacyId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
 	// step
-	while ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
-		char* p_data = (char*)sqlite3_column_text(m_stmt, 0);
+	while ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
+		char* p_data = (char*)sqlite3_column_text(pStmt, 0);
 		if(p_data == NULL) {
 			continue;
 		}
 		packageList.push_back(std::string(p_data));
 	}
-	m_dbMutex.unlock();
+	sqlite3_reset(pStmt);
+	releaseReader(pReader);
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -969,35 +1599,38 @@ PrivacyGuardDb::PgUpdateMonitorPolicy(const int userId, const std::string packag
 	int res = -1;
 	static const std::string query = std::string("UPDATE MonitorPolicy SET MONITOR_POLICY=? WHERE USER_ID=? AND PKG_ID=? AND PRIVACY_ID=?");
 
-	m_dbMutex.lock();
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, query.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(query, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, monitorPolicy);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, monitorPolicy);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_int(m_stmt, 2, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 2, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_text(m_stmt, 3, packageId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_text(pStmt, 3, packageId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
-	res = sqlite3_bind_text(m_stmt, 4, privacyId.c_str(), -1, SQLITE_TRANSIENT);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
+	res = sqlite3_bind_text(pStmt, 4, privacyId.c_str(), -1, SQLITE_TRANSIENT);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_text : %d", res);
 
 	// step
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	unlockWriter();
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -1007,30 +1640,33 @@ PrivacyGuardDb::PgAddMainMonitorPolicy(const int userId)
 {
 	int res = -1;
 
-	static const std::string QUERY_INSERT = std::string("INSERT INTO MainMonitorPolicy(USER_ID) VALUES(?)");
+	static const std::string QUERY_INSERT = std::string("INSERT OR IGNORE INTO MainMonitorPolicy(USER_ID) VALUES(?)");
 
-	m_dbMutex.lock();
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
 
 	PF_LOGD("addlogToDb m_sqlHandler : %p", m_sqlHandler);
 
+	sqlite3_stmt* pStmt = NULL;
+
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, QUERY_INSERT.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(QUERY_INSERT, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
 	//bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
 	//step
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	unlockWriter();
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -1041,29 +1677,32 @@ PrivacyGuardDb::PgUpdateMainMonitorPolicy(const int userId, const bool mainMonit
 	int res = -1;
 	static const std::string query = std::string("UPDATE MainMonitorPolicy SET MAIN_MONITOR_POLICY=? WHERE USER_ID=?");
 
-	m_dbMutex.lock();
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, query.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(query, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, mainMonitorPolicy);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, mainMonitorPolicy);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
-	res = sqlite3_bind_int(m_stmt, 2, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 2, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
 	// step
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	unlockWriter();
 
 #if 0
 	// [CYNARA] Set Filter
@@ -1080,29 +1719,29 @@ PrivacyGuardDb::PgGetMainMonitorPolicy(const int userId, bool &mainMonitorPolicy
 	int res = -1;
 	static const std::string query = std::string("SELECT MAIN_MONITOR_POLICY FROM MainMonitorPolicy WHERE USER_ID=?");
 
-	m_dbMutex.lock();
-	// open db
-	if(m_bDBOpen == false) {
-		openSqliteDB();
-	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, query.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, query, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
 	// step
 	mainMonitorPolicy = false;
-	if ((res = sqlite3_step(m_stmt)) == SQLITE_ROW) {
-		mainMonitorPolicy = sqlite3_column_int(m_stmt, 0);
-		m_dbMutex.unlock();
+	if ((res = sqlite3_step(pStmt)) == SQLITE_ROW) {
+		mainMonitorPolicy = sqlite3_column_int(pStmt, 0);
+		sqlite3_reset(pStmt);
+		releaseReader(pReader);
 	}
 	else {
-		m_dbMutex.unlock();
+		sqlite3_reset(pStmt);
+		releaseReader(pReader);
 		res = PgAddMainMonitorPolicy(userId);
 		TryReturn(res == PRIV_FLTR_ERROR_SUCCESS, res, , "PgAddMainMonitorPolicy failed : %d", res);
 	}
@@ -1117,26 +1756,205 @@ PrivacyGuardDb::PgDeleteMainMonitorPolicyByUserId(const int userId)
 
 	static const std::string QUERY_DELETE = std::string("DELETE FROM MainMonitorPolicy WHERE USER_ID=?");
 
-	m_dbMutex.lock();
+	lockWriter();
 	// open db
 	if(m_bDBOpen == false) {
 		openSqliteDB();
 	}
-	TryCatchResLogReturn(m_bDBOpen == true, m_dbMutex.unlock(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
 
 	// prepare
-	res = sqlite3_prepare_v2(m_sqlHandler, QUERY_DELETE.c_str(), -1, &m_stmt, NULL);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_prepare_v2 : %d", res);
+	res = prepareStmt(QUERY_DELETE, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
 
 	// bind
-	res = sqlite3_bind_int(m_stmt, 1, userId);
-	TryCatchResLogReturn(res == SQLITE_OK, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
 
 	// step
-	res = sqlite3_step(m_stmt);
-	TryCatchResLogReturn(res == SQLITE_DONE, m_dbMutex.unlock(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	res = sqlite3_step(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+	sqlite3_reset(pStmt);
 
-	m_dbMutex.unlock();
+	unlockWriter();
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyGuardDb::PgGetNextLogUserId(const int userId, int& nextUserId)
+{
+	int res = -1;
+	static const std::string query = std::string("SELECT MIN(USER_ID) FROM StatisticsMonitorInfo WHERE USER_ID>?");
+
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
+
+	// prepare
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, query, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
+
+	// bind
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+	// step
+	res = PRIV_FLTR_ERROR_NO_DATA;
+	if (sqlite3_step(pStmt) == SQLITE_ROW && sqlite3_column_type(pStmt, 0) != SQLITE_NULL) {
+		nextUserId = sqlite3_column_int(pStmt, 0);
+		res = PRIV_FLTR_ERROR_SUCCESS;
+	}
+	sqlite3_reset(pStmt);
+
+	releaseReader(pReader);
+
+	return res;
+}
+
+int
+PrivacyGuardDb::PgDeleteExpiredLogs(const int userId, const int batchSize, int& deletedCount)
+{
+	int res = -1;
+	static const std::string QUERY_DELETE = std::string("DELETE FROM StatisticsMonitorInfo WHERE rowid IN "
+		"(SELECT rowid FROM StatisticsMonitorInfo WHERE USER_ID=? AND USE_DATE<? LIMIT ?)");
+
+	sqlite3_int64 expiryDate = (sqlite3_int64)getLogExpiryDay() * SECONDS_PER_DAY;
+
+	lockWriter();
+	// open db
+	if(m_bDBOpen == false) {
+		openSqliteDB();
+	}
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
+
+	// prepare
+	res = prepareStmt(QUERY_DELETE, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
+
+	// bind
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+	res = sqlite3_bind_int64(pStmt, 2, expiryDate);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int64 : %d", res);
+
+	res = sqlite3_bind_int(pStmt, 3, batchSize);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+	// step
+	res = sqlite3_step(pStmt);
+	sqlite3_reset(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+
+	deletedCount = sqlite3_changes(m_sqlHandler);
+
+	unlockWriter();
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyGuardDb::PgGetNextDailyCountUserId(const int userId, int& nextUserId)
+{
+	int res = -1;
+	static const std::string query = std::string("SELECT MIN(USER_ID) FROM StatisticsDailyCount WHERE USER_ID>?");
+
+	ReaderConnection* pReader = acquireReader();
+	TryReturn(pReader != NULL, PRIV_FLTR_ERROR_IO_ERROR, , "acquireReader : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
+
+	// prepare
+	res = prepareCachedStmt(pReader->pHandler, pReader->stmtCache, query, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "prepareCachedStmt : %d", res);
+
+	// bind
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, releaseReader(pReader), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+	// step
+	res = PRIV_FLTR_ERROR_NO_DATA;
+	if (sqlite3_step(pStmt) == SQLITE_ROW && sqlite3_column_type(pStmt, 0) != SQLITE_NULL) {
+		nextUserId = sqlite3_column_int(pStmt, 0);
+		res = PRIV_FLTR_ERROR_SUCCESS;
+	}
+	sqlite3_reset(pStmt);
+
+	releaseReader(pReader);
+
+	return res;
+}
+
+int
+PrivacyGuardDb::PgDeleteExpiredDailyCounts(const int userId, int& deletedCount)
+{
+	int res = -1;
+	// one day of one user per call, the oldest one if it is expired
+	static const std::string QUERY_DELETE = std::string("DELETE FROM StatisticsDailyCount WHERE USER_ID=?1 AND USE_DAY<?2 "
+		"AND USE_DAY=(SELECT MIN(USE_DAY) FROM StatisticsDailyCount WHERE USER_ID=?1)");
+
+	int expiryDay = getDailyCountExpiryDay();
+
+	lockWriter();
+	// open db
+	if(m_bDBOpen == false) {
+		openSqliteDB();
+	}
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	sqlite3_stmt* pStmt = NULL;
+
+	// prepare
+	res = prepareStmt(QUERY_DELETE, &pStmt);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "prepareStmt : %d", res);
+
+	// bind
+	res = sqlite3_bind_int(pStmt, 1, userId);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+	res = sqlite3_bind_int(pStmt, 2, expiryDay);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_bind_int : %d", res);
+
+	// step
+	res = sqlite3_step(pStmt);
+	sqlite3_reset(pStmt);
+	TryCatchResLogReturn(res == SQLITE_DONE, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_step : %d", res);
+
+	deletedCount = sqlite3_changes(m_sqlHandler);
+
+	unlockWriter();
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+PrivacyGuardDb::PgIncrementalVacuum(const int pageCount, int& freePageCount)
+{
+	int res = -1;
+
+	std::string query = std::string("PRAGMA incremental_vacuum(").append(std::to_string(pageCount)).append(")");
+
+	lockWriter();
+	// open db
+	if(m_bDBOpen == false) {
+		openSqliteDB();
+	}
+	TryCatchResLogReturn(m_bDBOpen == true, unlockWriter(), PRIV_FLTR_ERROR_IO_ERROR, "openSqliteDB : %d", res);
+
+	res = sqlite3_exec(m_sqlHandler, query.c_str(), NULL, NULL, NULL);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_exec : %d", res);
+
+	freePageCount = 0;
+	res = sqlite3_exec(m_sqlHandler, "PRAGMA freelist_count", getIntCallback, &freePageCount, NULL);
+	TryCatchResLogReturn(res == SQLITE_OK, unlockWriter(), PRIV_FLTR_ERROR_DB_ERROR, "sqlite3_exec : %d", res);
+
+	unlockWriter();
 
 	return PRIV_FLTR_ERROR_SUCCESS;
 }
@@ -1147,22 +1965,29 @@ PrivacyGuardDb::PrivacyGuardDb(void)
 	// open DB
 	m_bDBOpen = false;
 	m_sqlHandler = NULL;
+	m_readerCount = 0;
+	pthread_rwlock_init(&m_connectionLock, NULL);
 	m_dbMutex.lock();
 	openSqliteDB();
+	// the daemon opens the db before it accepts clients, the VACUUM blocks none of them
+	if (m_bDBOpen == true && enableIncrementalVacuum() != PRIV_FLTR_ERROR_SUCCESS) {
+		PF_LOGE("fail : monitor db incremental vacuum, the freed pages stay in the file");
+	}
 	m_dbMutex.unlock();
-	m_stmt = NULL;
 }
 
 PrivacyGuardDb::~PrivacyGuardDb(void)
 {
-	// close DB
+	// close DB, waits for the running readers and writer to finish
+	pthread_rwlock_wrlock(&m_connectionLock);
 	if(m_bDBOpen == true) {
-		m_dbMutex.lock();
-		sqlite3_finalize(m_stmt);
+		closeReaderPool();
+		finalizeStmtCache();
 		sqlite3_close(m_sqlHandler);
 		m_bDBOpen = false;
-		m_dbMutex.unlock();
 	}
+	pthread_rwlock_unlock(&m_connectionLock);
+	pthread_rwlock_destroy(&m_connectionLock);
 }
 
 PrivacyGuardDb*
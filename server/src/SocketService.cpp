@@ -21,9 +21,14 @@
 #include <sys/signalfd.h>
 #include <sys/select.h>
 #include <sys/stat.h>
+#include <poll.h>
 #include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
+#ifdef USE_IPC_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 #include <memory>
 #include <dlog.h>
 #include "PrivacyGuardTypes.h"
@@ -31,12 +36,31 @@
 #include "SocketService.h"
 #include "SocketConnection.h"
 
-const int SocketService::MAX_LISTEN = 5;
-
-SocketService::SocketService(void)
-	: m_listenFd(-1)
+// a burst of clients connecting at once must not overflow the accept backlog
+const int SocketService::MAX_LISTEN = SOMAXCONN;
+// a client that doesn't take its response within this time is dropped, as is one that
+// stalls in a request too long for the event loop to buffer
+const int SocketService::REQUEST_TIMEOUT_MS = 5000;
+#ifdef USE_IPC_EPOLL
+// number of the worker threads serving the requests, set by cmake
+#ifndef IPC_WORKER_COUNT
+#define IPC_WORKER_COUNT	4
+#endif
+const int SocketService::MAX_EPOLL_EVENTS = 64;
+const int SocketService::MAX_PIPELINED_REQUESTS = 64;
+const int SocketService::WORKER_COUNT = IPC_WORKER_COUNT;
+#endif
+
+SocketService::SocketService(const std::string& address)
+	: m_address(address)
+	, m_listenFd(-1)
 	, m_signalToClose(-1)
 	, m_mainThread(-1)
+#ifdef USE_IPC_EPOLL
+	, m_epollFd(-1)
+	, m_stopEventFd(-1)
+	, m_bWorkerStopRequested(false)
+#endif
 {
 
 }
@@ -64,7 +88,8 @@ SocketService::initialize(void)
 	sockaddr_un server_address;
 	bzero(&server_address, sizeof(server_address));
 	server_address.sun_family = AF_UNIX;
-	strcpy(server_address.sun_path, SERVER_ADDRESS.c_str());
+	TryReturn( m_address.size() < sizeof(server_address.sun_path), PRIV_FLTR_ERROR_INVALID_PARAMETER, , "Too long socket path : %s", m_address.c_str());
+	strcpy(server_address.sun_path, m_address.c_str());
 	unlink(server_address.sun_path);
 
 	mode_t socket_umask, original_umask;
@@ -76,6 +101,12 @@ SocketService::initialize(void)
 
 	umask(original_umask);
 
+#ifdef USE_IPC_EPOLL
+	// written by stop() to wake up the event loop
+	m_stopEventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	TryReturn( m_stopEventFd != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, , "eventfd : %s", strerror(errno));
+#endif
+
 	LOGI("SocketService initialized");
 
 	return PRIV_FLTR_ERROR_SUCCESS;
@@ -112,7 +143,9 @@ SocketService::start(void)
 void*
 SocketService::serverThread(void* pData)
 {
+#ifndef USE_IPC_EPOLL
 	pthread_detach(pthread_self());
+#endif
 	SocketService &t = *static_cast< SocketService* > (pData);
 	LOGI("Running main thread");
 	int ret = t.mainloop();
@@ -123,6 +156,304 @@ SocketService::serverThread(void* pData)
 	return (void*) 0;
 }
 
+#ifdef USE_IPC_EPOLL
+int
+SocketService::mainloop(void)
+{
+	if( listen(m_listenFd, MAX_LISTEN) == -1 ){
+		LOGE("listen : %s", strerror(errno));
+		return PRIV_FLTR_ERROR_IPC_ERROR;
+	}
+
+	//this will block SIGPIPE for this thread and the worker threads created in it
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+	TryReturn( m_epollFd != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, , "epoll_create1 : %s", strerror(errno));
+
+	epoll_event event;
+	bzero(&event, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = m_listenFd;
+	int res = epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &event);
+	TryReturn( res != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, close(m_epollFd), "epoll_ctl : %s", strerror(errno));
+
+	event.data.fd = m_stopEventFd;
+	res = epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_stopEventFd, &event);
+	TryReturn( res != -1, PRIV_FLTR_ERROR_SYSTEM_ERROR, close(m_epollFd), "epoll_ctl : %s", strerror(errno));
+
+	res = startWorkers();
+	TryReturn( res == PRIV_FLTR_ERROR_SUCCESS, res, close(m_epollFd), "startWorkers : %d", res);
+
+	std::vector < epoll_event > events(MAX_EPOLL_EVENTS);
+	bool bStopRequested = false;
+
+	// the event loop only takes what the clients have sent, a worker gets a socket once a whole request is buffered.
+	// a worker still waits for a client that doesn't take its response, up to REQUEST_TIMEOUT_MS
+	while (bStopRequested == false)
+	{
+		int eventCount = epoll_wait(m_epollFd, &events[0], MAX_EPOLL_EVENTS, -1);
+		if (eventCount == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			LOGE("epoll_wait : %s", strerror(errno));
+			res = PRIV_FLTR_ERROR_SYSTEM_ERROR;
+			break;
+		}
+
+		for (int i = 0; i < eventCount; ++i)
+		{
+			int fd = events[i].data.fd;
+
+			if (fd == m_stopEventFd)
+			{
+				LOGI("Server thread got signal to close");
+				bStopRequested = true;
+			}
+			else if (fd == m_listenFd)
+			{
+				if (acceptConnections() != PRIV_FLTR_ERROR_SUCCESS)
+				{
+					LOGE("acceptConnections failed");
+				}
+			}
+			else if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+			{
+				// the client closes its connection only between requests
+				LOGI("Client hung up");
+				removeClientSocket(fd);
+				close(fd);
+			}
+			else if (receiveRequest(fd) != PRIV_FLTR_ERROR_SUCCESS)
+			{
+				removeClientSocket(fd);
+				close(fd);
+			}
+		}
+	}
+
+	stopWorkers();
+	closeConnections();
+	close(m_epollFd);
+	m_epollFd = -1;
+
+	return res;
+}
+
+int
+SocketService::acceptConnections(void)
+{
+	// the listen socket is non-blocking, take every pending connection
+	while (1)
+	{
+		int clientFd = accept(m_listenFd, NULL, NULL);
+		if (clientFd == -1)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return PRIV_FLTR_ERROR_SUCCESS;
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			LOGE("accept : %s", strerror(errno));
+			return PRIV_FLTR_ERROR_IPC_ERROR;
+		}
+
+		LOGI("Got incoming connection");
+		addClientSocket(clientFd);
+
+		int res = watchClientSocket(clientFd);
+		if (res != PRIV_FLTR_ERROR_SUCCESS)
+		{
+			removeClientSocket(clientFd);
+			close(clientFd);
+		}
+	}
+}
+
+int
+SocketService::watchClientSocket(int clientFd)
+{
+	epoll_event event;
+	bzero(&event, sizeof(event));
+	event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+	event.data.fd = clientFd;
+
+	int res = epoll_ctl(m_epollFd, EPOLL_CTL_ADD, clientFd, &event);
+	TryReturn( res != -1, PRIV_FLTR_ERROR_IPC_ERROR, , "epoll_ctl : %s", strerror(errno));
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+SocketService::rearmClientSocket(int clientFd)
+{
+	// the connection is kept open and waits in the event loop for the next request
+	epoll_event event;
+	bzero(&event, sizeof(event));
+	event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+	event.data.fd = clientFd;
+
+	int res = epoll_ctl(m_epollFd, EPOLL_CTL_MOD, clientFd, &event);
+	TryReturn( res != -1, PRIV_FLTR_ERROR_IPC_ERROR, , "epoll_ctl : %s", strerror(errno));
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+int
+SocketService::receiveRequest(int clientFd)
+{
+	std::shared_ptr < SocketConnection > pConnector = findConnection(clientFd);
+	TryReturn( pConnector != NULL, PRIV_FLTR_ERROR_IPC_ERROR, , "No connection for socket %d", clientFd);
+
+	// a part of a request stays in the connection until the rest comes
+	bool bWholeRequest = false;
+	int res = pConnector->receiveAvailable(&bWholeRequest);
+	TryReturn( res == PRIV_FLTR_ERROR_SUCCESS, PRIV_FLTR_ERROR_IPC_ERROR, , "receiveAvailable : %d", res);
+
+	if (bWholeRequest == false)
+		return rearmClientSocket(clientFd);
+
+	queueClientSocket(clientFd);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+void
+SocketService::queueClientSocket(int clientFd)
+{
+	// the socket stays disarmed (EPOLLONESHOT) while a worker serves it
+	{
+		std::lock_guard < std::mutex > guard(m_readyQueueMutex);
+		m_readyQueue.push_back(clientFd);
+	}
+	m_readyQueueCondition.notify_one();
+}
+
+int
+SocketService::startWorkers(void)
+{
+	m_bWorkerStopRequested = false;
+
+	for (int i = 0; i < WORKER_COUNT; ++i)
+	{
+		pthread_t workerThreadId;
+		int res = pthread_create(&workerThreadId, NULL, &workerThread, this);
+		TryReturn( res == 0, PRIV_FLTR_ERROR_SYSTEM_ERROR, stopWorkers(); errno = res, "pthread_create : %s", strerror(res));
+
+		m_workerThreads.push_back(workerThreadId);
+	}
+
+	LOGI("%d workers started", WORKER_COUNT);
+
+	return PRIV_FLTR_ERROR_SUCCESS;
+}
+
+void
+SocketService::stopWorkers(void)
+{
+	{
+		std::lock_guard < std::mutex > guard(m_readyQueueMutex);
+		m_bWorkerStopRequested = true;
+	}
+	m_readyQueueCondition.notify_all();
+
+	// a worker finishes the request it is serving
+	for (std::vector < pthread_t >::iterator iter = m_workerThreads.begin(); iter != m_workerThreads.end(); ++iter)
+	{
+		pthread_join(*iter, NULL);
+	}
+	m_workerThreads.clear();
+
+	// the sockets left in the queue are closed by closeConnections()
+	std::lock_guard < std::mutex > guard(m_readyQueueMutex);
+	m_readyQueue.clear();
+}
+
+std::shared_ptr < SocketConnection >
+SocketService::findConnection(int clientFd)
+{
+	std::lock_guard<std::mutex> guard(m_clientSocketListMutex);
+	std::map < int, std::shared_ptr < SocketConnection > >::iterator iter = m_connectionMap.find(clientFd);
+	if (iter == m_connectionMap.end())
+		return std::shared_ptr < SocketConnection > ();
+
+	return iter->second;
+}
+
+void*
+SocketService::workerThread(void* pData)
+{
+	SocketService &t = *static_cast< SocketService* > (pData);
+	LOGI("Starting worker thread");
+	t.workerLoop();
+	return (void*)0;
+}
+
+void
+SocketService::workerLoop(void)
+{
+	while (1)
+	{
+		int fd = -1;
+		{
+			std::unique_lock < std::mutex > lock(m_readyQueueMutex);
+			m_readyQueueCondition.wait(lock, [this] { return m_bWorkerStopRequested == true || m_readyQueue.empty() == false; });
+
+			if (m_bWorkerStopRequested == true)
+				break;
+
+			fd = m_readyQueue.front();
+			m_readyQueue.pop_front();
+		}
+
+		std::shared_ptr < SocketConnection > pConnector = findConnection(fd);
+		if (pConnector == NULL)
+		{
+			LOGE("No connection for socket %d", fd);
+			continue;
+		}
+
+		// pipelined requests received whole are served without a trip through the event loop,
+		// a limit keeps one client from holding the worker
+		int res = PRIV_FLTR_ERROR_SUCCESS;
+		bool bWholeRequest = true;
+		for (int servedCount = 0; res == PRIV_FLTR_ERROR_SUCCESS && bWholeRequest == true && servedCount < MAX_PIPELINED_REQUESTS; ++servedCount)
+		{
+			res = connectionService(pConnector.get());
+			if (res == PRIV_FLTR_ERROR_SUCCESS)
+			{
+				res = pConnector->receiveAvailable(&bWholeRequest);
+			}
+		}
+		// the responses held back for the pipelined requests are sent before the socket is given up
+		if (res == PRIV_FLTR_ERROR_SUCCESS)
+		{
+			res = pConnector->flush();
+		}
+		if (res == PRIV_FLTR_ERROR_SUCCESS && bWholeRequest == true)
+		{
+			// epoll does not know about the requests received already, queue the socket again
+			queueClientSocket(fd);
+		}
+		else if (res == PRIV_FLTR_ERROR_SUCCESS)
+		{
+			// the event loop takes the rest of a request received in part
+			res = rearmClientSocket(fd);
+		}
+		if (res != PRIV_FLTR_ERROR_SUCCESS)
+		{
+			LOGE("Connection error : %d", res);
+			removeClientSocket(fd);
+			close(fd);
+		}
+	}
+
+	LOGI("Worker thread finished");
+}
+#else
 int
 SocketService::mainloop(void)
 {
@@ -213,6 +544,7 @@ SocketService::mainloop(void)
 		}
 	}
 }
+#endif
 
 void*
 SocketService::connectionThread(void* pData)
@@ -221,26 +553,68 @@ SocketService::connectionThread(void* pData)
 	std::unique_ptr<ConnectionInfo> connectionInfo (static_cast<ConnectionInfo *>(pData));
 	SocketService &t = *static_cast<SocketService *>(connectionInfo->pData);
 	LOGI("Starting connection thread");
-	int ret = t.connectionService(connectionInfo->connFd);
-	if (ret < 0)
+
+	// the client keeps its connection open, serve the requests until it hangs up
+	SocketConnection connector(connectionInfo->connFd);
+	// long lists in the responses are sent while they are written
+	connector.setListStreaming(true);
+	pollfd clientPollFd;
+	clientPollFd.fd = connectionInfo->connFd;
+	clientPollFd.events = POLLIN | POLLRDHUP;
+	while (1)
 	{
-		LOGE("Connection thread error");
-		t.removeClientSocket(connectionInfo->connFd);
-		close(connectionInfo->connFd);
-		return (void*)1;
+		clientPollFd.revents = 0;
+		if (connector.hasBufferedMessage())
+		{
+			clientPollFd.revents = POLLIN;
+		}
+		else if (poll(&clientPollFd, 1, -1) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			LOGE("poll : %s", strerror(errno));
+			break;
+		}
+		if (clientPollFd.revents & (POLLRDHUP | POLLHUP | POLLERR | POLLNVAL))
+		{
+			LOGI("Client hung up");
+			break;
+		}
+
+		int ret = t.connectionService(&connector);
+		if (ret != PRIV_FLTR_ERROR_SUCCESS)
+		{
+			LOGE("Connection thread error");
+			t.removeClientSocket(connectionInfo->connFd);
+			close(connectionInfo->connFd);
+			return (void*)1;
+		}
 	}
+
+	t.removeClientSocket(connectionInfo->connFd);
+	close(connectionInfo->connFd);
 	LOGI("Client serviced");
 	return (void*)0;
 }
 
 int
-SocketService::connectionService(int fd)
+SocketService::connectionService(SocketConnection* pConnector)
 {
-
-	SocketConnection connector = SocketConnection(fd);
+	unsigned int requestId = 0;
 	std::string interfaceName, methodName;
 
-	int res = connector.read(&interfaceName, &methodName);
+	// the whole request, from its first byte to the last byte of the response, has REQUEST_TIMEOUT_MS.
+	// with epoll the request is buffered already, unless it is too long for that
+	pConnector->setTimeout(REQUEST_TIMEOUT_MS);
+
+	int res = pConnector->readMessage();
+	if (res != PRIV_FLTR_ERROR_SUCCESS)
+	{
+		LOGE("readMessage : %d", res);
+		return res;
+	}
+
+	res = pConnector->read(&requestId, &interfaceName, &methodName);
 	if (res != PRIV_FLTR_ERROR_SUCCESS)
 	{
 		LOGE("read : %d", res);
@@ -269,12 +643,28 @@ SocketService::connectionService(int fd)
 //		}
 //	}
 
+	// the response starts with the id of the request it answers
+	res = pConnector->write(requestId);
+	if (res != PRIV_FLTR_ERROR_SUCCESS)
+	{
+		LOGE("write : %d", res);
+		return res;
+	}
+
 	LOGI("Calling service");
-	m_callbackMap[interfaceName][methodName]->serviceCallback(&connector);
-   
-	LOGI("Removing client");
-	removeClientSocket(fd);
-	close(fd);
+	m_callbackMap[interfaceName][methodName]->serviceCallback(pConnector);
+
+	// the responses to pipelined requests are sent together once the received ones are served
+	pConnector->endMessage();
+	if (pConnector->hasBufferedMessage() == false)
+	{
+		res = pConnector->flush();
+		if (res != PRIV_FLTR_ERROR_SUCCESS)
+		{
+			LOGE("flush : %d", res);
+			return res;
+		}
+	}
 
 	LOGI("Call served");
 
@@ -292,6 +682,18 @@ SocketService::stop(void)
 			return PRIV_FLTR_ERROR_IPC_ERROR;
 		}
 
+#ifdef USE_IPC_EPOLL
+	uint64_t stopValue = 1;
+	if(write(m_stopEventFd, &stopValue, sizeof(stopValue)) == -1)
+	{
+		LOGE("write() : %s", strerror(errno));
+		return PRIV_FLTR_ERROR_IPC_ERROR;
+	}
+	// the event loop joins the workers and closes the client sockets before it ends
+	pthread_join(m_mainThread, NULL);
+	close(m_stopEventFd);
+	m_stopEventFd = -1;
+#else
 	int returned_value;
 	if((returned_value = pthread_kill(m_mainThread, m_signalToClose)) < 0)
 	{
@@ -300,6 +702,9 @@ SocketService::stop(void)
 		return PRIV_FLTR_ERROR_IPC_ERROR;
 	}
 	pthread_join(m_mainThread, NULL);
+#endif
+	LOGI("Socket waits : %lu, deadlines expired : %lu, waits cancelled : %lu", SocketStream::getWaitCount(),
+			SocketStream::getExpiredDeadlineCount(), SocketStream::getCancelledWaitCount());
 
 	LOGI("Stopped");
 	return PRIV_FLTR_ERROR_SUCCESS;
@@ -336,6 +741,14 @@ SocketService::addClientSocket(int clientSocket)
 {
 	std::lock_guard<std::mutex> guard(m_clientSocketListMutex);
 	m_clientSocketList.push_back(clientSocket);
+#ifdef USE_IPC_EPOLL
+	std::shared_ptr < SocketConnection > pConnection = std::make_shared < SocketConnection > (clientSocket);
+	// long lists in the responses are sent while they are written
+	pConnection->setListStreaming(true);
+	// a worker waiting for a slow client gives up when the service stops
+	pConnection->setCancelFd(m_stopEventFd);
+	m_connectionMap[clientSocket] = pConnection;
+#endif
 }
 
 void
@@ -343,6 +756,9 @@ SocketService::removeClientSocket(int clientSocket)
 {
 	std::lock_guard<std::mutex> guard(m_clientSocketListMutex);
 	m_clientSocketList.remove(clientSocket);
+#ifdef USE_IPC_EPOLL
+	m_connectionMap.erase(clientSocket);
+#endif
 }
 
 bool
@@ -353,6 +769,9 @@ SocketService::popClientSocket(int * pClientSocket)
 		return false;
 	*pClientSocket = m_clientSocketList.front();
 	m_clientSocketList.pop_front();
+#ifdef USE_IPC_EPOLL
+	m_connectionMap.erase(*pClientSocket);
+#endif
 	return true;
 }
 
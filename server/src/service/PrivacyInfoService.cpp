@@ -14,11 +14,58 @@
  *    limitations under the License.
  */
 
+#include <mutex>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
 #include <dlog.h>
 #include "PrivacyInfoService.h"
 #include "PrivacyGuardDb.h"
+#include "AccessLogQueue.h"
+#include "NotificationServer.h"
+#include "MonitorPolicySnapshot.h"
+#include "MonitorPolicyPublisher.h"
+#ifdef USE_ACCESS_LOG_RING
+#include "AccessLogRingService.h"
+#endif
 #include "Utils.h"
 
+void
+PrivacyInfoService::publishMonitorPolicySnapshot(void)
+{
+	// the last one to publish read the db after the last change
+	static std::mutex publishMutex;
+	std::lock_guard < std::mutex > guard(publishMutex);
+
+	std::list < std::pair < std::string, int > > monitorPolicyList;
+	int res = PrivacyGuardDb::getInstance()->PgGetAllMonitorPolicy(monitorPolicyList);
+	if (res != PRIV_FLTR_ERROR_SUCCESS && res != PRIV_FLTR_ERROR_NO_DATA) {
+		// the clients ask the server rather than trust a file that may be behind the db
+		PF_LOGE("PgGetAllMonitorPolicy : %d, the snapshot is withdrawn", res);
+		MonitorPolicySnapshot::withdraw(MONITOR_POLICY_SNAPSHOT_PATH);
+		return;
+	}
+
+	// the key is "userId|packageId|privacyId", a privacy id has no '|'
+	std::list < MonitorPolicySnapshot::Policy > policyList;
+	for (std::list < std::pair < std::string, int > >::const_iterator iter = monitorPolicyList.begin(); iter != monitorPolicyList.end(); ++iter) {
+		size_t userEnd = iter->first.find('|');
+		size_t packageEnd = iter->first.rfind('|');
+		if (userEnd == std::string::npos || packageEnd == userEnd)
+			continue;
+		MonitorPolicySnapshot::Policy policy;
+		policy.userId = atoi(iter->first.c_str());
+		policy.packageId = iter->first.substr(userEnd + 1, packageEnd - userEnd - 1);
+		policy.privacyId = iter->first.substr(packageEnd + 1);
+		policy.monitorPolicy = iter->second;
+		policyList.push_back(policy);
+	}
+
+	res = MonitorPolicySnapshot::publish(MONITOR_POLICY_SNAPSHOT_PATH, policyList);
+	if (res != PRIV_FLTR_ERROR_SUCCESS)
+		PF_LOGE("MonitorPolicySnapshot::publish : %d", res);
+}
+
 void
 PrivacyInfoService::PgAddPrivacyAccessLog(SocketConnection* pConnector)
 {
@@ -27,13 +74,46 @@ PrivacyInfoService::PgAddPrivacyAccessLog(SocketConnection* pConnector)
 	int userId = 0;
 	std::list <std::pair<std::string, std::string>> logInfoList;
 
-	pConnector->read(&userId, &logInfoList);
+	int result = pConnector->read(&userId, &logInfoList);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result), "read : %d", result);
 	PF_LOGD("PrivacyInfoService PgAddPrivacyAccessLog userId : %d", userId);
 
-	int result = PrivacyGuardDb::getInstance()->PgAddPrivacyAccessLog(userId, logInfoList);
+	// acknowledged once queued, the logs are written behind
+	result = AccessLogQueue::getInstance()->push(userId, logInfoList);
+
+	pConnector->write(result);
+}
+
+#ifdef USE_ACCESS_LOG_RING
+void
+PrivacyInfoService::PgRegisterAccessLogRing(SocketConnection* pConnector)
+{
+	LOGI("PRIVACY PrivacyInfoService PgRegisterAccessLogRing");
+
+	FileDescriptor memoryFd = { -1 };
+	FileDescriptor eventFd = { -1 };
+	FileDescriptor hangupFd = { -1 };
+	struct ucred credentials;
+
+	int result = pConnector->read(&memoryFd, &eventFd, &hangupFd);
+	// the ring is known by the process that passed it, not by anything it claims
+	if (result == PRIV_FLTR_ERROR_SUCCESS && pConnector->getPeerCredentials(&credentials) != 0)
+		result = PRIV_FLTR_ERROR_IPC_ERROR;
+
+	if (result == PRIV_FLTR_ERROR_SUCCESS) {
+		result = AccessLogRingService::getInstance()->addRing(credentials, memoryFd.fd, eventFd.fd, hangupFd.fd);
+	} else {
+		if (memoryFd.fd != -1)
+			close(memoryFd.fd);
+		if (eventFd.fd != -1)
+			close(eventFd.fd);
+		if (hangupFd.fd != -1)
+			close(hangupFd.fd);
+	}
 
 	pConnector->write(result);
 }
+#endif
 
 void
 PrivacyInfoService::PgAddPrivacyAccessLogTest(SocketConnection* pConnector)
@@ -44,10 +124,11 @@ PrivacyInfoService::PgAddPrivacyAccessLogTest(SocketConnection* pConnector)
 	std::string packageId;
 	std::string privacyId;
 
-	pConnector->read(&userId, &packageId, &privacyId);
+	int result = pConnector->read(&userId, &packageId, &privacyId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result), "read : %d", result);
 	PF_LOGD("PrivacyInfoService PgAddPrivacyAccessLogTest userId : %d", userId);
 
-	int result = PrivacyGuardDb::getInstance()->PgAddPrivacyAccessLogTest(userId, packageId, privacyId);
+	result = PrivacyGuardDb::getInstance()->PgAddPrivacyAccessLogTest(userId, packageId, privacyId);
 
 	pConnector->write(result);
 }
@@ -58,12 +139,24 @@ PrivacyInfoService::PgAddMonitorPolicy(SocketConnection* pConnector)
 	int userId = 0;
 	std::string pkgId;
 	std::list < std::string > list;
-	bool privacyPopupRequired = true;
-	pConnector->read(&userId, &pkgId, &list, &privacyPopupRequired);
+	int monitorPolicy = 1;
+	int result = pConnector->read(&userId, &pkgId, &list, &monitorPolicy);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result), "read : %d", result);
+
+	result = PrivacyGuardDb::getInstance()->PgAddMonitorPolicy(userId, pkgId, list, monitorPolicy);
 
-	int result = PrivacyGuardDb::getInstance()->PgAddMonitorPolicy(userId, pkgId, list, privacyPopupRequired);
+	// the snapshot follows within MonitorPolicyPublisher::PUBLISH_DELAY_MS, the answer doesn't wait for it.
+	// The list is written whole or not at all, a failed call changed nothing
+	if (result == PRIV_FLTR_ERROR_SUCCESS)
+		MonitorPolicyPublisher::getInstance()->requestPublish();
 
 	pConnector->write(result);
+
+	// the clients add the policies to their caches, they don't reload them
+	if (result == PRIV_FLTR_ERROR_SUCCESS) {
+		for (std::list < std::string >::const_iterator iter = list.begin(); iter != list.end(); ++iter)
+			NotificationServer::getInstance()->notifyMonitorPolicyChanged(userId, pkgId, *iter, monitorPolicy);
+	}
 }
 
 void
@@ -71,16 +164,22 @@ PrivacyInfoService::PgDeleteAllLogsAndMonitorPolicy(SocketConnection* pConnector
 {
 	int result = PrivacyGuardDb::getInstance()->PgDeleteAllLogsAndMonitorPolicy();
 
+	MonitorPolicyPublisher::getInstance()->requestPublish();
+
 	pConnector->write(result);
+
+	if (result == PRIV_FLTR_ERROR_SUCCESS)
+		NotificationServer::getInstance()->notifyMonitorPolicyRemoved(-1, std::string());
 }
 
 void
 PrivacyInfoService::PgDeleteLogsByPackageId(SocketConnection* pConnector)
 {
 	std::string packageId;
-	pConnector->read(&packageId);
+	int result = pConnector->read(&packageId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result), "read : %d", result);
 
-	int result = PrivacyGuardDb::getInstance()->PgDeleteLogsByPackageId(packageId);
+	result = PrivacyGuardDb::getInstance()->PgDeleteLogsByPackageId(packageId);
 
 	pConnector->write(result);
 }
@@ -89,11 +188,17 @@ void
 PrivacyInfoService::PgDeleteMonitorPolicyByPackageId(SocketConnection* pConnector)
 {
 	std::string packageId;
-	pConnector->read(&packageId);
+	int result = pConnector->read(&packageId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result), "read : %d", result);
+
+	result = PrivacyGuardDb::getInstance()->PgDeleteMonitorPolicyByPackageId(packageId);
 
-	int result = PrivacyGuardDb::getInstance()->PgDeleteMonitorPolicyByPackageId(packageId);
+	MonitorPolicyPublisher::getInstance()->requestPublish();
 
 	pConnector->write(result);
+
+	if (result == PRIV_FLTR_ERROR_SUCCESS)
+		NotificationServer::getInstance()->notifyMonitorPolicyRemoved(-1, packageId);
 }
 
 void
@@ -103,10 +208,11 @@ PrivacyInfoService::PgForeachTotalPrivacyCountOfPackage(SocketConnection* pConne
 	int startDate = -1;
 	int endDate = -1;
 	std::list < std::pair < std::string, int > > packageInfoList;
-	pConnector->read(&userId, &startDate, &endDate);
+	int result = pConnector->read(&userId, &startDate, &endDate);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result); pConnector->write(packageInfoList), "read : %d", result);
 
 	PF_LOGD("requested > userId : %d, startDate : %d, endDate : %d", userId, startDate, endDate);
-	int result = PrivacyGuardDb::getInstance()->PgForeachTotalPrivacyCountOfPackage(userId, startDate, endDate, packageInfoList);
+	result = PrivacyGuardDb::getInstance()->PgForeachTotalPrivacyCountOfPackage(userId, startDate, endDate, packageInfoList);
 	PF_LOGD("response > packageInfoList size : %d", packageInfoList.size());
 
 	pConnector->write(result);
@@ -120,10 +226,11 @@ PrivacyInfoService::PgForeachTotalPrivacyCountOfPrivacy(SocketConnection* pConne
 	int startDate = -1;
 	int endDate = -1;
 	std::list < std::pair < std::string, int > > privacyInfoList;
-	pConnector->read(&userId, &startDate, &endDate);
+	int result = pConnector->read(&userId, &startDate, &endDate);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result); pConnector->write(privacyInfoList), "read : %d", result);
 
 	PF_LOGD("requested > startDate : %d, endDate : %d", startDate, endDate);
-	int result = PrivacyGuardDb::getInstance()->PgForeachTotalPrivacyCountOfPrivacy(userId, startDate, endDate, privacyInfoList);
+	result = PrivacyGuardDb::getInstance()->PgForeachTotalPrivacyCountOfPrivacy(userId, startDate, endDate, privacyInfoList);
 	PF_LOGD("response > privacyInfoList size : %d", privacyInfoList.size());
 
 	pConnector->write(result);
@@ -138,11 +245,12 @@ PrivacyInfoService::PgForeachPrivacyCountByPrivacyId(SocketConnection* pConnecto
 	int endDate = -1;
 	std::string privacyId;
 	std::list < std::pair < std::string, int > > packageInfoList;
-	pConnector->read(&userId, &startDate, &endDate, &privacyId);
+	int result = pConnector->read(&userId, &startDate, &endDate, &privacyId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result); pConnector->write(packageInfoList), "read : %d", result);
 
 	PF_LOGD("requested > startDate : %d, endDate : %d, privacyId : %s",
 			startDate, endDate, privacyId.c_str());
-	int result = PrivacyGuardDb::getInstance()->PgForeachPrivacyCountByPrivacyId(userId, startDate, endDate,
+	result = PrivacyGuardDb::getInstance()->PgForeachPrivacyCountByPrivacyId(userId, startDate, endDate,
 						privacyId, packageInfoList);
 	PF_LOGD("response > packageInfoList size : %d", packageInfoList.size());
 
@@ -158,11 +266,12 @@ PrivacyInfoService::PgForeachPrivacyCountByPackageId(SocketConnection* pConnecto
 	int endDate = -1;
 	std::string packageId;
 	std::list < std::pair < std::string, int > > privacyInfoList;
-	pConnector->read(&userId, &startDate, &endDate, &packageId);
+	int result = pConnector->read(&userId, &startDate, &endDate, &packageId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result); pConnector->write(privacyInfoList), "read : %d", result);
 
 	PF_LOGD("requested > startDate : %d, endDate : %d, packageId : %s",
 			startDate, endDate, packageId.c_str());
-	int result = PrivacyGuardDb::getInstance()->PgForeachPrivacyCountByPackageId(userId, startDate, endDate,
+	result = PrivacyGuardDb::getInstance()->PgForeachPrivacyCountByPackageId(userId, startDate, endDate,
 						packageId, privacyInfoList);
 	PF_LOGD("response > privacyInfoList size : %d", privacyInfoList.size());
 
@@ -176,10 +285,11 @@ PrivacyInfoService::PgForeachPrivacyPackageId(SocketConnection* pConnector)
 	int userId = 0;
 	std::list < std::string > packageList;
 
-	pConnector->read(&userId);
+	int result = pConnector->read(&userId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result); pConnector->write(packageList), "read : %d", result);
 	PF_LOGD("requested > userId : %d", userId);
 
-	int result = PrivacyGuardDb::getInstance()->PgForeachPrivacyPackageId(userId, packageList);
+	result = PrivacyGuardDb::getInstance()->PgForeachPrivacyPackageId(userId, packageList);
 	PF_LOGD("response > packageList size : %d", packageList.size());
 
 	pConnector->write(result);
@@ -191,10 +301,10 @@ PrivacyInfoService::PgForeachMonitorPolicyByPackageId(SocketConnection* pConnect
 {
 	int userId = 0;
 	std::string packageId;
-	pConnector->read(&userId, &packageId);
-
 	std::list <privacy_data_s> privacyInfoList;
-	int result = -1;
+	int result = pConnector->read(&userId, &packageId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result); pConnector->write(privacyInfoList), "read : %d", result);
+
 	result = PrivacyGuardDb::getInstance()->PgForeachMonitorPolicyByPackageId(userId, packageId, privacyInfoList);
 
 	PF_LOGD("response > privacyInfoList size : %d", privacyInfoList.size());
@@ -209,11 +319,11 @@ PrivacyInfoService::PgGetMonitorPolicy(SocketConnection* pConnector)
 	int userId = 0;
 	std::string packageId;
 	std::string privacyId;
-	pConnector->read(&userId, &packageId, &privacyId);
+	int monitorPolicy = 1;
+	int result = pConnector->read(&userId, &packageId, &privacyId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result); pConnector->write(monitorPolicy), "read : %d", result);
 
 	PF_LOGD("requested > packageId : %s, privacyId : %s", packageId.c_str(), privacyId.c_str());
-	int monitorPolicy = 1;
-	int result = -1;
 	result = PrivacyGuardDb::getInstance()->PgGetMonitorPolicy(userId, packageId, privacyId, monitorPolicy);
 
 	PF_LOGD("response > monitorPolicy : %d", monitorPolicy);
@@ -240,10 +350,11 @@ PrivacyInfoService::PgForeachPackageByPrivacyId(SocketConnection* pConnector)
 	std::string privacyId;
 	std::list < std::string > packageList;
 
-	pConnector->read(&userId, &privacyId);
+	int result = pConnector->read(&userId, &privacyId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result); pConnector->write(packageList), "read : %d", result);
 	PF_LOGD("requested > userId : %d, privacyId : %s", userId, privacyId.c_str());
 
-	int result = PrivacyGuardDb::getInstance()->PgForeachPackageByPrivacyId(userId, privacyId, packageList);
+	result = PrivacyGuardDb::getInstance()->PgForeachPackageByPrivacyId(userId, privacyId, packageList);
 	PF_LOGD("response > packageList size : %d", packageList.size());
 
 	pConnector->write(result);
@@ -256,10 +367,11 @@ PrivacyInfoService::PgCheckPrivacyPackage(SocketConnection* pConnector)
 	int userId = 0;
 	std::string packageId;
 	bool isPrivacyPackage = false;
-	pConnector->read(&userId, &packageId);
+	int result = pConnector->read(&userId, &packageId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result); pConnector->write(isPrivacyPackage), "read : %d", result);
 
 	PF_LOGD("requested > packageId : %s", packageId.c_str());
-	int result = PrivacyGuardDb::getInstance()->PgCheckPrivacyPackage(userId, packageId, isPrivacyPackage);
+	result = PrivacyGuardDb::getInstance()->PgCheckPrivacyPackage(userId, packageId, isPrivacyPackage);
 
 	pConnector->write(result);
 	pConnector->write(isPrivacyPackage);
@@ -272,13 +384,19 @@ PrivacyInfoService::PgUpdateMonitorPolicy(SocketConnection* pConnector)
 	std::string packageId;
 	std::string privacyId;
 	int monitorPolicy = 1;
-	pConnector->read(&userId, &packageId, &privacyId, &monitorPolicy);
+	int result = pConnector->read(&userId, &packageId, &privacyId, &monitorPolicy);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result), "read : %d", result);
 
 	PF_LOGD("requested > packageId : %s, privacyId : %s, monitorPolicy : %d",
 				packageId.c_str(), privacyId.c_str(), monitorPolicy);
-	int result = PrivacyGuardDb::getInstance()->PgUpdateMonitorPolicy(userId, packageId, privacyId, monitorPolicy);
+	result = PrivacyGuardDb::getInstance()->PgUpdateMonitorPolicy(userId, packageId, privacyId, monitorPolicy);
+
+	MonitorPolicyPublisher::getInstance()->requestPublish();
 
 	pConnector->write(result);
+
+	if (result == PRIV_FLTR_ERROR_SUCCESS)
+		NotificationServer::getInstance()->notifyMonitorPolicyChanged(userId, packageId, privacyId, monitorPolicy);
 }
 
 void
@@ -286,10 +404,11 @@ PrivacyInfoService::PgUpdateMainMonitorPolicy(SocketConnection* pConnector)
 {
 	int userId = 0;
 	bool mainMonitorPolicy = false;
-	pConnector->read(&userId, &mainMonitorPolicy);
+	int result = pConnector->read(&userId, &mainMonitorPolicy);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result), "read : %d", result);
 
 	PF_LOGD("requested > mainMonitorPolicy : %d", mainMonitorPolicy);
-	int result = PrivacyGuardDb::getInstance()->PgUpdateMainMonitorPolicy(userId, mainMonitorPolicy);
+	result = PrivacyGuardDb::getInstance()->PgUpdateMainMonitorPolicy(userId, mainMonitorPolicy);
 
 	pConnector->write(result);
 }
@@ -298,12 +417,12 @@ void
 PrivacyInfoService::PgGetMainMonitorPolicy(SocketConnection* pConnector)
 {
 	int userId = 0;
-	pConnector->read(&userId);
+	bool mainMonitorPolicy = false;
+	int result = pConnector->read(&userId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result); pConnector->write(mainMonitorPolicy), "read : %d", result);
 
 	PF_LOGD("PgGetMainMonitorPolicy userId : %d", userId);
 
-	bool mainMonitorPolicy = false;
-	int result = -1;
 	result = PrivacyGuardDb::getInstance()->PgGetMainMonitorPolicy(userId, mainMonitorPolicy);
 
 	PF_LOGD("response > mainMonitorPolicy : %d", mainMonitorPolicy);
@@ -316,9 +435,10 @@ void
 PrivacyInfoService::PgDeleteMainMonitorPolicyByUserId(SocketConnection* pConnector)
 {
 	int userId = 0;
-	pConnector->read(&userId);
+	int result = pConnector->read(&userId);
+	TryReturn(result == PRIV_FLTR_ERROR_SUCCESS, , pConnector->write(result), "read : %d", result);
 
-	int result = PrivacyGuardDb::getInstance()->PgDeleteMainMonitorPolicyByUserId(userId);
+	result = PrivacyGuardDb::getInstance()->PgDeleteMainMonitorPolicyByUserId(userId);
 
 	pConnector->write(result);
 }
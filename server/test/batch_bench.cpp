@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// Runs SocketService on a socket of its own and makes 100 calls in a row, like the
+// settings asking for the policies of every package : one call after the other, then
+// all of them in one SocketClient::Batch. Prints the time of the 100 calls both ways,
+// and fails when a call fails or returns what it shouldn't.
+//
+// usage : privacy-guard-batch-bench [rounds]
+
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "PrivacyGuardTypes.h"
+#include "SocketConnection.h"
+#include "SocketService.h"
+#include "SocketClient.h"
+
+#define INTERFACE_NAME "BatchBench"
+#define CALLS_PER_ROUND 100
+#define PRIVACIES_PER_PACKAGE 8
+
+// the privacies of a package, like PgForeachMonitorPolicyByPackageId
+static void
+getPrivacies(SocketConnection* pConnector)
+{
+	std::string packageId;
+	int res = pConnector->read(&packageId);
+
+	std::list < std::string > privacyList;
+	for (int i = 0; res == PRIV_FLTR_ERROR_SUCCESS && i < PRIVACIES_PER_PACKAGE; ++i)
+		privacyList.push_back(packageId + "/http://tizen.org/privacy/" + std::to_string(i));
+
+	pConnector->write(res);
+	pConnector->write(privacyList);
+}
+
+static bool
+isExpected(const std::string& packageId, int result, const std::list < std::string >& privacyList)
+{
+	return result == PRIV_FLTR_ERROR_SUCCESS && privacyList.size() == PRIVACIES_PER_PACKAGE
+		&& privacyList.front() == packageId + "/http://tizen.org/privacy/0";
+}
+
+static double
+percentile(std::vector < double > values, double fraction)
+{
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, (size_t)(values.size() * fraction))];
+}
+
+int
+main(int argc, char* argv[])
+{
+	int roundCount = argc > 1 ? atoi(argv[1]) : 1000;
+	std::string address = "/tmp/privacy_guard_batch_bench." + std::to_string(getpid());
+
+	SocketService service(address);
+	if (service.initialize() != PRIV_FLTR_ERROR_SUCCESS
+		|| service.registerServiceCallback(INTERFACE_NAME, "getPrivacies", getPrivacies) != PRIV_FLTR_ERROR_SUCCESS
+		|| service.start() != PRIV_FLTR_ERROR_SUCCESS)
+	{
+		printf("FAIL the service doesn't start\n");
+		unlink(address.c_str());
+		return 1;
+	}
+
+	std::vector < std::string > packageIds;
+	for (int i = 0; i < CALLS_PER_ROUND; ++i)
+		packageIds.push_back("org.tizen.batchbench.application" + std::to_string(i));
+
+	SocketClient socketClient(INTERFACE_NAME, address);
+	std::vector < double > perCallMs;
+	std::vector < double > batchedMs;
+	unsigned long failedCount = 0;
+
+	// the service listens once its thread runs, the first calls may find nobody
+	int result = -1;
+	std::list < std::string > privacyList;
+	for (int attempt = 0; attempt < 100 && socketClient.call("getPrivacies", packageIds[0], &result, &privacyList) != PRIV_FLTR_ERROR_SUCCESS; ++attempt)
+		usleep(10 * 1000);
+
+	for (int round = 0; round < roundCount; ++round)
+	{
+		// one round trip per call
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < CALLS_PER_ROUND; ++i)
+		{
+			result = -1;
+			privacyList.clear();
+			int res = socketClient.call("getPrivacies", packageIds[i], &result, &privacyList);
+			if (res != PRIV_FLTR_ERROR_SUCCESS || isExpected(packageIds[i], result, privacyList) == false)
+				++failedCount;
+		}
+		perCallMs.push_back(std::chrono::duration < double, std::milli > (std::chrono::steady_clock::now() - start).count());
+
+		// the requests written back to back, the responses read after them
+		std::vector < int > results(CALLS_PER_ROUND, -1);
+		std::vector < std::list < std::string > > privacyLists(CALLS_PER_ROUND);
+		start = std::chrono::steady_clock::now();
+		SocketClient::Batch batch;
+		for (int i = 0; i < CALLS_PER_ROUND; ++i)
+			batch.add("getPrivacies", packageIds[i], &results[i], &privacyLists[i]);
+		int res = socketClient.callBatch(batch);
+		batchedMs.push_back(std::chrono::duration < double, std::milli > (std::chrono::steady_clock::now() - start).count());
+		for (int i = 0; i < CALLS_PER_ROUND; ++i)
+		{
+			if (res != PRIV_FLTR_ERROR_SUCCESS || isExpected(packageIds[i], results[i], privacyLists[i]) == false)
+				++failedCount;
+		}
+	}
+
+	service.stop();
+	unlink(address.c_str());
+
+	printf("%d rounds of %d calls\n", roundCount, CALLS_PER_ROUND);
+	printf("%-10s %12s %12s %12s\n", "", "p50 ms", "p99 ms", "us / call");
+	printf("%-10s %12.3f %12.3f %12.2f\n", "per call", percentile(perCallMs, 0.5), percentile(perCallMs, 0.99), percentile(perCallMs, 0.5) * 1000 / CALLS_PER_ROUND);
+	printf("%-10s %12.3f %12.3f %12.2f\n", "batched", percentile(batchedMs, 0.5), percentile(batchedMs, 0.99), percentile(batchedMs, 0.5) * 1000 / CALLS_PER_ROUND);
+
+	if (failedCount != 0)
+	{
+		printf("FAIL %lu calls failed or returned something else\n", failedCount);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+#
+#    Licensed under the Apache License, Version 2.0 (the "License");
+#    you may not use this file except in compliance with the License.
+#    You may obtain a copy of the License at
+#
+#        http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS,
+#    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#    See the License for the specific language governing permissions and
+#    limitations under the License.
+#
+
+# Runs statistics readers next to one log writer on a seeded database, in the
+# old setup and in the one of PrivacyGuardDb:
+#   persist : PERSIST journal, one handle shared under a mutex
+#   wal     : WAL journal, a writer handle and one read-only handle per reader,
+#             passive checkpoints once the WAL reaches 1000 pages
+# The readers run the per-package count of PrivacyGuardDb.cpp, the writer adds
+# batches of 10 log rows. Prints reads/s, rows/s and write latency, and fails
+# on a database error or a lost row.
+#
+# usage : bench_concurrency.py <source dir> [log rows] [readers] [seconds]
+
+import os
+import shutil
+import sqlite3
+import sys
+import tempfile
+import threading
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from check_query_plan import read_queries
+from bench_statistics import BASE_DATE, PACKAGE_COUNT, SECONDS_PER_DAY, USER_ID, create_db, date_range, seed
+
+WRITE_BATCH = 10
+BUSY_TIMEOUT_S = 1.0
+WAL_CHECKPOINT_PAGES = 1000
+LOG_INSERT = "INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DATE) VALUES(?, ?, ?, ?)"
+
+
+class Run:
+	def __init__(self):
+		self.reads = 0
+		self.rows = 0
+		self.writeMs = []
+		self.errors = []
+		self.stop = threading.Event()
+
+
+def reader(run, connect, lock, query, parameters):
+	try:
+		connection = connect()
+		while not run.stop.is_set():
+			with lock:
+				connection.execute(query, parameters).fetchall()
+			run.reads += 1
+	except sqlite3.Error as error:
+		run.errors.append("reader : %s" % error)
+
+
+def writer(run, connection, lock):
+	date = BASE_DATE + 30 * SECONDS_PER_DAY
+	try:
+		while not run.stop.is_set():
+			start = time.perf_counter()
+			with lock:
+				connection.execute("BEGIN IMMEDIATE")
+				connection.executemany(LOG_INSERT, [(USER_ID, 1 + (run.rows + i) % PACKAGE_COUNT, 1, date) for i in range(WRITE_BATCH)])
+				connection.execute("COMMIT")
+			run.writeMs.append((time.perf_counter() - start) * 1000)
+			run.rows += WRITE_BATCH
+	except sqlite3.Error as error:
+		run.errors.append("writer : %s" % error)
+
+
+def bench(path, wal, readerCount, seconds, query):
+	connection = sqlite3.connect(path, isolation_level=None, timeout=BUSY_TIMEOUT_S, check_same_thread=False)
+	if wal:
+		connection.execute("PRAGMA journal_mode = WAL")
+		connection.execute("PRAGMA wal_autocheckpoint = %d" % WAL_CHECKPOINT_PAGES)
+		connect = lambda: sqlite3.connect("file:%s?mode=ro" % path, uri=True, isolation_level=None, timeout=BUSY_TIMEOUT_S)
+		lock = lambda: threading.Lock()
+	else:
+		connection.execute("PRAGMA journal_mode = PERSIST")
+		shared = threading.Lock()
+		connect = lambda: connection
+		lock = lambda: shared
+	before = connection.execute("SELECT COUNT(*) FROM StatisticsMonitorInfo").fetchone()[0]
+
+	parameters = [USER_ID] + date_range(BASE_DATE, BASE_DATE + 30 * SECONDS_PER_DAY - 1)
+	run = Run()
+	threads = [threading.Thread(target=reader, args=(run, connect, lock(), query, parameters)) for i in range(readerCount)]
+	threads.append(threading.Thread(target=writer, args=(run, connection, lock())))
+	for thread in threads:
+		thread.start()
+	time.sleep(seconds)
+	run.stop.set()
+	for thread in threads:
+		thread.join()
+
+	after = connection.execute("SELECT COUNT(*) FROM StatisticsMonitorInfo").fetchone()[0]
+	if after != before + run.rows:
+		run.errors.append("%d rows written, %d found" % (run.rows, after - before))
+	connection.close()
+	return run
+
+
+def percentile(values, fraction):
+	values = sorted(values)
+	return values[min(len(values) - 1, int(len(values) * fraction))] if values else 0.0
+
+
+def main():
+	sourceDir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), "..", "..")
+	rows = int(sys.argv[2]) if len(sys.argv) > 2 else 300000
+	readerCount = int(sys.argv[3]) if len(sys.argv) > 3 else 4
+	seconds = float(sys.argv[4]) if len(sys.argv) > 4 else 5
+	with open(os.path.join(sourceDir, "server", "src", "PrivacyGuardDb.cpp")) as sourceFile:
+		query = [query for query in read_queries(sourceFile.read()) if query.startswith("SELECT P.PKG_ID, SUM(S.CNT)") and "?8" not in query][0]
+
+	failures = 0
+	with tempfile.TemporaryDirectory() as directory:
+		seeded = os.path.join(directory, "seeded.db")
+		memory = create_db(os.path.join(sourceDir, "res", "usr", "bin", "privacy_guard_db.sql"))
+		seed(memory, rows)
+		with sqlite3.connect(seeded) as copy:
+			memory.backup(copy)
+		memory.close()
+
+		print("%d log rows, %d readers, %d s" % (rows, readerCount, seconds))
+		print("%-8s %10s %10s %14s %14s" % ("", "reads/s", "rows/s", "write p50 ms", "write p99 ms"))
+		for name, wal in (("persist", False), ("wal", True)):
+			path = os.path.join(directory, name + ".db")
+			shutil.copyfile(seeded, path)
+			run = bench(path, wal, readerCount, seconds, query)
+			print("%-8s %10.1f %10.1f %14.1f %14.1f" % (name, run.reads / seconds, run.rows / seconds,
+				percentile(run.writeMs, 0.5), percentile(run.writeMs, 0.99)))
+			for error in run.errors:
+				failures += 1
+				print("FAIL %s %s" % (name, error))
+
+	return 1 if failures else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+#
+#    Licensed under the Apache License, Version 2.0 (the "License");
+#    you may not use this file except in compliance with the License.
+#    You may obtain a copy of the License at
+#
+#        http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS,
+#    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#    See the License for the specific language governing permissions and
+#    limitations under the License.
+#
+
+# Compares the access log with package and privacy ids stored as strings on
+# every row against the log of privacy_guard_db.sql, which stores the integer
+# keys of the Package and Privacy tables. Both logs get the same rows and the
+# same three indexes. Prints file size, insert rate and range query time, and
+# fails when both logs disagree on a count.
+#
+# usage : bench_log_encoding.py <source dir> [log rows]
+
+import os
+import random
+import re
+import sqlite3
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from check_query_plan import SCHEMA_0_1
+
+SECONDS_PER_DAY = 86400
+USER_ID = 5001
+PACKAGE_COUNT = 300
+PRIVACY_COUNT = 20
+DAY_COUNT = 30
+BASE_DATE = 1600000000
+BATCH_SIZE = 1000
+
+PACKAGES = ["org.tizen.bench.application%03d" % i for i in range(PACKAGE_COUNT)]
+PRIVACIES = ["http://tizen.org/privacy/benchprivacy%02d" % i for i in range(PRIVACY_COUNT)]
+
+STRING_QUERIES = (
+	"SELECT PKG_ID, COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=? AND USE_DATE>=? AND USE_DATE<=? GROUP BY +PKG_ID",
+	"SELECT PRIVACY_ID, COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=? AND PKG_ID=? AND USE_DATE>=? AND USE_DATE<=? GROUP BY +PRIVACY_ID",
+)
+KEYED_QUERIES = (
+	"SELECT P.PKG_ID, S.CNT FROM (SELECT PKG_KEY, COUNT(*) AS CNT FROM StatisticsMonitorInfo WHERE USER_ID=? AND USE_DATE>=? AND USE_DATE<=? GROUP BY +PKG_KEY) S "
+		"JOIN Package P ON P.PKG_KEY=S.PKG_KEY",
+	"SELECT V.PRIVACY_ID, S.CNT FROM (SELECT PRIVACY_KEY, COUNT(*) AS CNT FROM StatisticsMonitorInfo WHERE USER_ID=? AND PKG_KEY=(SELECT PKG_KEY FROM Package WHERE PKG_ID=?) "
+		"AND USE_DATE>=? AND USE_DATE<=? GROUP BY +PRIVACY_KEY) S JOIN Privacy V ON V.PRIVACY_KEY=S.PRIVACY_KEY",
+)
+
+
+# the log table and its indexes as privacy_guard_db.sql creates them, without the daily rollup
+def keyed_schema(schemaPath):
+	with open(schemaPath) as schema:
+		sql = schema.read()
+	return re.sub(r"CREATE TRIGGER .*?\nEND;", "", sql, flags=re.S)
+
+
+# the 0.1 log table, indexed like the keyed one with the strings in place of the keys
+def string_schema(schemaPath):
+	indexes = re.findall(r"CREATE INDEX StatisticsMonitorInfo_\w+ ON StatisticsMonitorInfo\(.*?\);", keyed_schema(schemaPath))
+	return SCHEMA_0_1 + "\n".join(index.replace("PKG_KEY", "PKG_ID").replace("PRIVACY_KEY", "PRIVACY_ID") for index in indexes)
+
+
+def rows(count):
+	generator = random.Random(1)
+	for i in range(count):
+		yield (generator.randrange(PACKAGE_COUNT), generator.randrange(PRIVACY_COUNT), BASE_DATE + generator.randrange(DAY_COUNT * SECONDS_PER_DAY))
+
+
+def fill(connection, count, keyed):
+	if keyed:
+		connection.executemany("INSERT INTO Package(PKG_ID) VALUES(?)", [(packageId,) for packageId in PACKAGES])
+		connection.executemany("INSERT INTO Privacy(PRIVACY_ID) VALUES(?)", [(privacyId,) for privacyId in PRIVACIES])
+		query = "INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DATE) VALUES(?, ?, ?, ?)"
+		values = lambda package, privacy, date: (USER_ID, package + 1, privacy + 1, date)
+	else:
+		query = "INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_ID, PRIVACY_ID, USE_DATE) VALUES(?, ?, ?, ?)"
+		values = lambda package, privacy, date: (USER_ID, PACKAGES[package], PRIVACIES[privacy], date)
+
+	batch = []
+	for package, privacy, date in rows(count):
+		batch.append(values(package, privacy, date))
+		if len(batch) == BATCH_SIZE:
+			connection.execute("BEGIN")
+			connection.executemany(query, batch)
+			connection.execute("COMMIT")
+			batch = []
+	if batch:
+		connection.execute("BEGIN")
+		connection.executemany(query, batch)
+		connection.execute("COMMIT")
+
+
+def measure(path, schema, count, keyed):
+	connection = sqlite3.connect(path, isolation_level=None)
+	connection.executescript(schema)
+	# the same for both logs, the fsync of each batch would hide the encoding
+	connection.execute("PRAGMA synchronous = OFF")
+
+	start = time.perf_counter()
+	fill(connection, count, keyed)
+	insertSeconds = time.perf_counter() - start
+
+	startDate = BASE_DATE + 3 * SECONDS_PER_DAY
+	endDate = BASE_DATE + 27 * SECONDS_PER_DAY
+	queries = KEYED_QUERIES if keyed else STRING_QUERIES
+	parameters = ([USER_ID, startDate, endDate], [USER_ID, PACKAGES[7], startDate, endDate])
+
+	results = []
+	queryMs = []
+	for query, parameter in zip(queries, parameters):
+		start = time.perf_counter()
+		results.append(dict(connection.execute(query, parameter).fetchall()))
+		queryMs.append((time.perf_counter() - start) * 1000)
+	connection.close()
+	return os.path.getsize(path), count / insertSeconds, queryMs, results
+
+
+def main():
+	sourceDir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), "..", "..")
+	count = int(sys.argv[2]) if len(sys.argv) > 2 else 5000000
+	schemaPath = os.path.join(sourceDir, "res", "usr", "bin", "privacy_guard_db.sql")
+
+	with tempfile.TemporaryDirectory() as directory:
+		string = measure(os.path.join(directory, "string.db"), string_schema(schemaPath), count, False)
+		keyed = measure(os.path.join(directory, "keyed.db"), keyed_schema(schemaPath), count, True)
+
+	print("%d log rows, %d packages, %d privacies" % (count, PACKAGE_COUNT, PRIVACY_COUNT))
+	print("%-28s %14s %14s" % ("", "string ids", "integer keys"))
+	print("%-28s %14.1f %14.1f" % ("file size (MB)", string[0] / 1048576.0, keyed[0] / 1048576.0))
+	print("%-28s %14.0f %14.0f" % ("inserts / s", string[1], keyed[1]))
+	print("%-28s %14.1f %14.1f" % ("by package (ms)", string[2][0], keyed[2][0]))
+	print("%-28s %14.1f %14.1f" % ("by privacy of a package (ms)", string[2][1], keyed[2][1]))
+
+	if string[3] != keyed[3]:
+		print("FAIL the string and the keyed log disagree on a count")
+		return 1
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
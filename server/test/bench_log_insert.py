@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+#
+#    Licensed under the Apache License, Version 2.0 (the "License");
+#    you may not use this file except in compliance with the License.
+#    You may obtain a copy of the License at
+#
+#        http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS,
+#    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#    See the License for the specific language governing permissions and
+#    limitations under the License.
+#
+
+# Times batches of access log inserts on a WAL database created by
+# privacy_guard_db.sql, at batch sizes 10, 100 and 1000:
+#   autocommit  : one implicit transaction per row at DB_SYNCHRONOUS, as before
+#   transaction : the whole batch in one transaction at LOG_SYNCHRONOUS
+# The insert query and both levels are taken from PrivacyGuardDb.cpp. Also
+# fails when a batch with a bad row leaves any of its rows behind.
+#
+# usage : bench_log_insert.py <source dir> [rows per batch size]
+
+import os
+import re
+import sqlite3
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from check_query_plan import read_queries
+
+BATCH_SIZES = (10, 100, 1000)
+USER_ID = 5001
+BASE_DATE = 1600000000
+
+
+def read_level(source, name):
+	return int(re.search(r"#define %s\s+(\d+)" % name, source).group(1))
+
+
+def connect(path, schemaPath):
+	connection = sqlite3.connect(path, isolation_level=None)
+	with open(schemaPath) as schema:
+		connection.executescript(schema.read())
+	connection.execute("PRAGMA journal_mode = WAL")
+	connection.execute("INSERT INTO Package(PKG_ID) VALUES('org.tizen.bench')")
+	connection.execute("INSERT INTO Privacy(PRIVACY_ID) VALUES('http://tizen.org/privacy/bench')")
+	return connection
+
+
+def batch(size, first):
+	return [(USER_ID, 1, 1, BASE_DATE + first + i) for i in range(size)]
+
+
+def insert_autocommit(connection, query, rows, level):
+	connection.execute("PRAGMA synchronous = %d" % level)
+	for row in rows:
+		connection.execute(query, row)
+
+
+def insert_transaction(connection, query, rows, logLevel, level):
+	connection.execute("PRAGMA synchronous = %d" % logLevel)
+	connection.execute("BEGIN IMMEDIATE TRANSACTION")
+	try:
+		for row in rows:
+			connection.execute(query, row)
+		connection.execute("COMMIT TRANSACTION")
+	except sqlite3.Error:
+		connection.execute("ROLLBACK TRANSACTION")
+		raise
+	finally:
+		connection.execute("PRAGMA synchronous = %d" % level)
+
+
+def main():
+	sourceDir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), "..", "..")
+	rowsPerSize = int(sys.argv[2]) if len(sys.argv) > 2 else 5000
+	with open(os.path.join(sourceDir, "server", "src", "PrivacyGuardDb.cpp")) as sourceFile:
+		source = sourceFile.read()
+	query = [query for query in read_queries(source) if query.startswith("INSERT INTO StatisticsMonitorInfo")][0]
+	level = read_level(source, "DB_SYNCHRONOUS")
+	logLevel = read_level(source, "LOG_SYNCHRONOUS")
+	schemaPath = os.path.join(sourceDir, "res", "usr", "bin", "privacy_guard_db.sql")
+
+	failures = 0
+	with tempfile.TemporaryDirectory() as directory:
+		connection = connect(os.path.join(directory, "log.db"), schemaPath)
+		written = 0
+
+		print("synchronous %d per row, %d per batch" % (level, logLevel))
+		print("%-8s %16s %16s" % ("batch", "autocommit r/s", "transaction r/s"))
+		for size in BATCH_SIZES:
+			batches = max(1, rowsPerSize // size)
+			rates = []
+			for insert in (lambda rows: insert_autocommit(connection, query, rows, level),
+					lambda rows: insert_transaction(connection, query, rows, logLevel, level)):
+				start = time.perf_counter()
+				for i in range(batches):
+					insert(batch(size, written))
+					written += size
+				rates.append(batches * size / (time.perf_counter() - start))
+			print("%-8d %16.0f %16.0f" % (size, rates[0], rates[1]))
+
+		# a NULL key fails the last row, none of the batch may stay
+		before = connection.execute("SELECT COUNT(*) FROM StatisticsMonitorInfo").fetchone()[0]
+		try:
+			insert_transaction(connection, query, batch(99, written) + [(USER_ID, None, 1, BASE_DATE)], logLevel, level)
+			failures += 1
+			print("FAIL a row with a NULL key was inserted")
+		except sqlite3.IntegrityError:
+			pass
+		after = connection.execute("SELECT COUNT(*) FROM StatisticsMonitorInfo").fetchone()[0]
+		if after != before or before != written:
+			failures += 1
+			print("FAIL %d rows written, %d found before and %d after the failed batch" % (written, before, after))
+		connection.close()
+
+	return 1 if failures else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+#
+#    Licensed under the Apache License, Version 2.0 (the "License");
+#    you may not use this file except in compliance with the License.
+#    You may obtain a copy of the License at
+#
+#        http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS,
+#    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#    See the License for the specific language governing permissions and
+#    limitations under the License.
+#
+
+# Times the statistics queries of PrivacyGuardDb on a seeded access log and
+# compares them with the old shape, one COUNT(*) per package or privacy.
+# The grouped queries are taken from PrivacyGuardDb.cpp and run on a database
+# created by privacy_guard_db.sql. Fails when both shapes disagree on a count.
+#
+# usage : bench_statistics.py <source dir> [log rows]
+
+import os
+import random
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from check_query_plan import create_db, read_queries
+
+SECONDS_PER_DAY = 86400
+USER_ID = 5001
+PACKAGE_COUNT = 300
+PRIVACY_COUNT = 10
+DAY_COUNT = 30
+BASE_DATE = 1600000000
+
+# the per-key shape the grouped queries replaced
+OLD_KEY_SELECT = "SELECT DISTINCT %s FROM StatisticsMonitorInfo WHERE USER_ID=? AND USE_DATE>=? AND USE_DATE<=?%s"
+OLD_COUNT_SELECT = "SELECT COUNT(*) FROM StatisticsMonitorInfo WHERE USER_ID=? AND %s=? AND USE_DATE>=? AND USE_DATE<=?%s"
+
+
+def seed(connection, rows):
+	connection.executemany("INSERT INTO Package(PKG_ID) VALUES(?)", [("org.bench.pkg%d" % i,) for i in range(PACKAGE_COUNT)])
+	connection.executemany("INSERT INTO Privacy(PRIVACY_ID) VALUES(?)", [("http://tizen.org/privacy/p%d" % i,) for i in range(PRIVACY_COUNT)])
+	generator = random.Random(1)
+	connection.execute("BEGIN")
+	connection.executemany("INSERT INTO StatisticsMonitorInfo(USER_ID, PKG_KEY, PRIVACY_KEY, USE_DATE) VALUES(?, ?, ?, ?)",
+		((USER_ID, generator.randint(1, PACKAGE_COUNT), generator.randint(1, PRIVACY_COUNT),
+			BASE_DATE + generator.randrange(DAY_COUNT * SECONDS_PER_DAY)) for i in range(rows)))
+	connection.execute("COMMIT")
+
+
+# the parameters of bindDateRange, nothing expired
+def date_range(startDate, endDate):
+	firstDay = (startDate + SECONDS_PER_DAY - 1) // SECONDS_PER_DAY
+	lastDay = (endDate + 1) // SECONDS_PER_DAY - 1
+	if firstDay > lastDay:
+		return [startDate, endDate, 1, 0, endDate + 1, endDate]
+	return [startDate, firstDay * SECONDS_PER_DAY - 1, firstDay, lastDay, (lastDay + 1) * SECONDS_PER_DAY, endDate]
+
+
+def run_grouped(connection, query, startDate, endDate, filterId):
+	parameters = [USER_ID] + date_range(startDate, endDate) + ([filterId] if filterId is not None else [])
+	return dict(connection.execute(query, parameters).fetchall())
+
+
+def run_old(connection, key, startDate, endDate, filterColumn, filterKey):
+	names = {"PKG_KEY": "SELECT PKG_ID FROM Package WHERE PKG_KEY=?", "PRIVACY_KEY": "SELECT PRIVACY_ID FROM Privacy WHERE PRIVACY_KEY=?"}
+	filterSql = " AND %s=?" % filterColumn if filterColumn else ""
+	filterParameters = [filterKey] if filterColumn else []
+	counts = {}
+	for (keyValue,) in connection.execute(OLD_KEY_SELECT % (key, filterSql), [USER_ID, startDate, endDate] + filterParameters).fetchall():
+		count = connection.execute(OLD_COUNT_SELECT % (key, filterSql), [USER_ID, keyValue, startDate, endDate] + filterParameters).fetchone()[0]
+		counts[connection.execute(names[key], [keyValue]).fetchone()[0]] = count
+	return counts
+
+
+def timed(function, *arguments):
+	start = time.perf_counter()
+	result = function(*arguments)
+	return result, (time.perf_counter() - start) * 1000
+
+
+def main():
+	sourceDir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), "..", "..")
+	rows = int(sys.argv[2]) if len(sys.argv) > 2 else 1000000
+	with open(os.path.join(sourceDir, "server", "src", "PrivacyGuardDb.cpp")) as sourceFile:
+		queries = [query for query in read_queries(sourceFile.read()) if "SUM(S.CNT)" in query]
+	if len(queries) != 4:
+		print("FAIL expected 4 grouped statistics queries, found %d" % len(queries))
+		return 1
+
+	connection = create_db(os.path.join(sourceDir, "res", "usr", "bin", "privacy_guard_db.sql"))
+	start = time.perf_counter()
+	seed(connection, rows)
+	print("seeded %d rows over %d packages in %.1f s" % (rows, PACKAGE_COUNT, time.perf_counter() - start))
+
+	# a range with partial days at both edges
+	startDate = BASE_DATE + 3 * SECONDS_PER_DAY + 3600
+	endDate = BASE_DATE + 27 * SECONDS_PER_DAY - 3600
+	failures = 0
+	print("%-40s %12s %12s" % ("query", "old (ms)", "grouped (ms)"))
+	for query in queries:
+		byPackage = query.startswith("SELECT P.PKG_ID")
+		key = "PKG_KEY" if byPackage else "PRIVACY_KEY"
+		filtered = "?8" in query
+		filterColumn = ("PRIVACY_KEY" if byPackage else "PKG_KEY") if filtered else None
+		filterId = ("http://tizen.org/privacy/p3" if byPackage else "org.bench.pkg7") if filtered else None
+
+		grouped, groupedMs = timed(run_grouped, connection, query, startDate, endDate, filterId)
+		old, oldMs = timed(run_old, connection, key, startDate, endDate, filterColumn, 4 if byPackage else 8)
+
+		name = "%s%s" % ("by package" if byPackage else "by privacy", " of one " + ("privacy" if byPackage else "package") if filtered else "")
+		print("%-40s %12.1f %12.1f" % (name, oldMs, groupedMs))
+		if grouped != old:
+			failures += 1
+			print("FAIL %s : %d keys differ" % (name, len(set(grouped.items()) ^ set(old.items()))))
+
+	return 1 if failures else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+#
+#    Licensed under the Apache License, Version 2.0 (the "License");
+#    you may not use this file except in compliance with the License.
+#    You may obtain a copy of the License at
+#
+#        http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS,
+#    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#    See the License for the specific language governing permissions and
+#    limitations under the License.
+#
+
+# Fails when a query of PrivacyGuardDb scans a whole table and the scan is not
+# one of ALLOWED_SCANS. Every SELECT, INSERT, UPDATE and DELETE literal of
+# PrivacyGuardDb.cpp is planned on two databases: one created by
+# privacy_guard_db.sql, one created by the 0.1 schema and upgraded by the
+# migrations of PrivacyGuardDb.cpp.
+#
+# usage : check_query_plan.py <source dir>
+
+import os
+import re
+import sqlite3
+import sys
+
+# the scans that are meant to read a whole table
+ALLOWED_SCANS = {
+	"SELECT * FROM MonitorPolicy" : "PgGetAllMonitorPolicy publishes the whole table as the client snapshot",
+}
+
+SQL_STATEMENT = re.compile(r"\s*(SELECT|INSERT|UPDATE|DELETE|WITH)\b", re.I)
+
+# the schema of privacy_guard_db.sql 0.1, the first one to migrate
+SCHEMA_0_1 = """
+CREATE TABLE StatisticsMonitorInfo(USER_ID INTEGER not null, PKG_ID TEXT not null, PRIVACY_ID TEXT not null, USE_DATE INTEGER not null, CHECK(1));
+CREATE TABLE MonitorPolicy(USER_ID INTEGER not null, PKG_ID TEXT not null, PRIVACY_ID TEXT not null, MONITOR_POLICY INTEGER not null, PRIMARY KEY(USER_ID, PKG_ID, PRIVACY_ID) CHECK(1));
+CREATE TABLE MainMonitorPolicy(USER_ID INTEGER not null, MAIN_MONITOR_POLICY BOOLEAN DEFAULT FALSE, PRIMARY KEY(USER_ID) CHECK(1));
+CREATE TABLE DB_VERSION_0_1 (version INT);
+"""
+
+STRING_LITERAL = r'"(?:[^"\\]|\\.)*"'
+
+
+def join_literals(text):
+	return "".join(bytes(literal[1:-1], "utf-8").decode("unicode_escape") for literal in re.findall(STRING_LITERAL, text))
+
+
+def read_migrations(source):
+	block = re.search(r"db_migration_list\[\] = \{(.*?)\n\};", source, re.S).group(1)
+	return [(int(version), join_literals(body)) for version, body in
+		re.findall(r"\{\s*(\d+),((?:\s*" + STRING_LITERAL + r")+)\s*\}", block)]
+
+
+# every run of adjacent string literals outside the migration list that starts a statement
+def read_queries(source):
+	migrations = re.search(r"db_migration_list\[\] = \{(.*?)\n\};", source, re.S)
+	if migrations:
+		source = source[:migrations.start()] + source[migrations.end():]
+	queries = [join_literals(body) for body in re.findall(r"((?:\s*" + STRING_LITERAL + r")+)", source)]
+	return list(dict.fromkeys(query for query in queries if SQL_STATEMENT.match(query)))
+
+
+def count_parameters(query):
+	numbered = [int(number) for number in re.findall(r"\?(\d+)", query)]
+	return max(numbered) if numbered else query.count("?")
+
+
+def create_db(schemaPath):
+	connection = sqlite3.connect(":memory:", isolation_level=None)
+	with open(schemaPath) as schema:
+		connection.executescript(schema.read())
+	return connection
+
+
+def migrate_db(migrations):
+	connection = sqlite3.connect(":memory:", isolation_level=None)
+	connection.executescript(SCHEMA_0_1)
+	for version, query in migrations:
+		connection.executescript("BEGIN IMMEDIATE TRANSACTION;" + query +
+			"DELETE FROM DB_VERSION_0_1; INSERT INTO DB_VERSION_0_1(version) VALUES(%d); COMMIT;" % version)
+	return connection
+
+
+def check(name, connection, queries):
+	tables = [row[0] for row in connection.execute("SELECT name FROM sqlite_master WHERE type='table'")]
+	scanned = re.compile(r"SCAN (TABLE )?(%s)\b" % "|".join(tables))
+	failures = 0
+	for query in queries:
+		try:
+			plan = connection.execute("EXPLAIN QUERY PLAN " + query, [0] * count_parameters(query)).fetchall()
+		except sqlite3.Error as error:
+			# the head of a query built with append() is checked where it is run, as by migrate_db
+			if str(error) == "incomplete input":
+				continue
+			failures += 1
+			print("FAIL %s : %s\n\t%s" % (name, query, error))
+			continue
+		scans = [row[3] for row in plan if scanned.match(row[3])]
+		if scans and query not in ALLOWED_SCANS:
+			failures += 1
+			print("FAIL %s : %s\n\t%s" % (name, query, "\n\t".join(scans)))
+	return failures
+
+
+def main():
+	sourceDir = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), "..", "..")
+	with open(os.path.join(sourceDir, "server", "src", "PrivacyGuardDb.cpp")) as sourceFile:
+		source = sourceFile.read()
+
+	queries = read_queries(source)
+	migrations = read_migrations(source)
+	if not queries or not migrations:
+		print("FAIL no query or migration found in PrivacyGuardDb.cpp")
+		return 1
+
+	created = create_db(os.path.join(sourceDir, "res", "usr", "bin", "privacy_guard_db.sql"))
+	migrated = migrate_db(migrations)
+
+	failures = check("created", created, queries) + check("migrated", migrated, queries)
+
+	# an allowed scan that is gone must leave the list too
+	for query in ALLOWED_SCANS:
+		if query not in queries:
+			failures += 1
+			print("FAIL allowed scan not found in PrivacyGuardDb.cpp : %s" % query)
+
+	# both ways must end at the same schema version
+	versions = [connection.execute("SELECT MAX(version) FROM DB_VERSION_0_1").fetchone()[0] for connection in (created, migrated)]
+	if versions[0] != versions[1] or versions[1] != migrations[-1][0]:
+		failures += 1
+		print("FAIL schema versions : created %s, migrated %s, last migration %d" % (versions[0], versions[1], migrations[-1][0]))
+
+	print("%d queries, %d migrations, %d failures" % (len(queries), len(migrations), failures))
+	return 1 if failures else 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
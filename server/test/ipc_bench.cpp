@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// Runs SocketService on a socket of its own with an echo method, and SocketClients
+// calling it at 1, 16 and 256 clients, each on its own connection. Prints calls/s and
+// the latency of a call.
+// Before that, twice as many clients as there are workers stop halfway through a
+// request : some in the middle of a message, some after the first message of a long
+// list. A call made next to them must not wait for them, the program fails when it
+// takes STALL_LIMIT_MS or a call fails.
+//
+// usage : privacy-guard-ipc-bench [calls]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "PrivacyGuardTypes.h"
+#include "SocketConnection.h"
+#include "SocketService.h"
+#include "SocketClient.h"
+
+#define INTERFACE_NAME "IpcBench"
+// well below the REQUEST_TIMEOUT_MS a worker would wait for a stalled client
+#define STALL_LIMIT_MS 1000
+#define LONG_LIST_SIZE 2000
+
+static void
+echo(SocketConnection* pConnector)
+{
+	int value = 0;
+	int res = pConnector->read(&value);
+	pConnector->write(res == PRIV_FLTR_ERROR_SUCCESS ? value : -1);
+}
+
+static void
+countList(SocketConnection* pConnector)
+{
+	std::list < std::string > list;
+	int res = pConnector->read(&list);
+	pConnector->write(res == PRIV_FLTR_ERROR_SUCCESS ? (int)list.size() : -1);
+}
+
+// the bytes a client sends for one request, with the message boundaries
+static std::string
+encodeRequest(const std::string& methodName, const std::list < std::string >* pList, std::vector < size_t >* pMessageEnds)
+{
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+		return std::string();
+
+	SocketConnection connector(fds[0]);
+	unsigned int requestId = 1;
+	connector.write(requestId, std::string(INTERFACE_NAME), methodName);
+	if (pList != NULL)
+		connector.write(*pList);
+	else
+		connector.write(7);
+	connector.flush();
+	close(fds[0]);
+
+	std::string bytes;
+	char buffer[4096];
+	ssize_t length;
+	while ((length = read(fds[1], buffer, sizeof(buffer))) > 0)
+		bytes.append(buffer, length);
+	close(fds[1]);
+
+	// the length of a message is its first 4 bytes, without the continued flag
+	for (size_t offset = 0; offset + sizeof(unsigned int) <= bytes.size(); )
+	{
+		unsigned int messageLength = 0;
+		memcpy(&messageLength, bytes.data() + offset, sizeof(messageLength));
+		offset += sizeof(messageLength) + (messageLength & 0x7fffffffu);
+		pMessageEnds->push_back(offset);
+	}
+	return bytes;
+}
+
+static int
+connectTo(const std::string& address)
+{
+	sockaddr_un remote;
+	memset(&remote, 0, sizeof(remote));
+	remote.sun_family = AF_UNIX;
+	strcpy(remote.sun_path, address.c_str());
+
+	// the service listens once its thread runs
+	for (int attempt = 0; attempt < 100; ++attempt)
+	{
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd == -1)
+			return -1;
+		if (connect(fd, (struct sockaddr*)&remote, SUN_LEN(&remote)) == 0)
+			return fd;
+		int error = errno;
+		close(fd);
+		if (error != ECONNREFUSED)
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return -1;
+}
+
+// clients that send part of a request and wait, a worker serving them would wait too
+static bool
+stallClients(const std::string& address, int clientCount, std::vector < int >* pFds)
+{
+	std::vector < size_t > shortEnds;
+	std::string shortRequest = encodeRequest("echo", NULL, &shortEnds);
+
+	std::list < std::string > longList;
+	for (int i = 0; i < LONG_LIST_SIZE; ++i)
+		longList.push_back("org.tizen.ipcbench.application" + std::to_string(i));
+	std::vector < size_t > longEnds;
+	std::string longRequest = encodeRequest("countList", &longList, &longEnds);
+	if (shortEnds.size() != 1 || longEnds.size() < 2)
+	{
+		printf("FAIL the requests are not framed as expected : %zu and %zu messages\n", shortEnds.size(), longEnds.size());
+		return false;
+	}
+
+	for (int i = 0; i < clientCount; ++i)
+	{
+		int fd = connectTo(address);
+		if (fd == -1)
+		{
+			printf("FAIL connect : %s\n", strerror(errno));
+			return false;
+		}
+		// half of a message, or the first message of a request going on in the next ones
+		size_t length = (i % 2 == 0) ? shortRequest.size() / 2 : longEnds[0];
+		const std::string& request = (i % 2 == 0) ? shortRequest : longRequest;
+		if (send(fd, request.data(), length, MSG_NOSIGNAL) != (ssize_t)length)
+		{
+			printf("FAIL send : %s\n", strerror(errno));
+			close(fd);
+			return false;
+		}
+		pFds->push_back(fd);
+	}
+	return true;
+}
+
+struct Result
+{
+	double callsPerSecond;
+	double p50Ms;
+	double p99Ms;
+	unsigned long failedCount;
+};
+
+static Result
+run(const std::string& address, const int clientCount, const int callCount)
+{
+	std::atomic < unsigned long > failedCount(0);
+	std::vector < std::vector < double > > latencies(clientCount);
+	int callsPerClient = std::max(1, callCount / clientCount);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector < std::thread > clients;
+	for (int client = 0; client < clientCount; ++client)
+	{
+		clients.push_back(std::thread([&, client]() {
+			SocketClient socketClient(INTERFACE_NAME, address);
+			for (int i = 0; i < callsPerClient; ++i)
+			{
+				int value = client * callsPerClient + i;
+				int result = -1;
+				std::chrono::steady_clock::time_point callStart = std::chrono::steady_clock::now();
+				int res = socketClient.call("echo", value, &result);
+				latencies[client].push_back(std::chrono::duration < double, std::milli > (std::chrono::steady_clock::now() - callStart).count());
+				if (res != PRIV_FLTR_ERROR_SUCCESS || result != value)
+					++failedCount;
+			}
+		}));
+	}
+	for (size_t i = 0; i < clients.size(); ++i)
+		clients[i].join();
+	double elapsedSeconds = std::chrono::duration < double > (std::chrono::steady_clock::now() - start).count();
+
+	std::vector < double > all;
+	for (size_t i = 0; i < latencies.size(); ++i)
+		all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+	std::sort(all.begin(), all.end());
+
+	Result result;
+	result.callsPerSecond = all.size() / elapsedSeconds;
+	result.p50Ms = all[all.size() / 2];
+	result.p99Ms = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+	result.failedCount = failedCount;
+	return result;
+}
+
+int
+main(int argc, char* argv[])
+{
+	int callCount = argc > 1 ? atoi(argv[1]) : 20000;
+	std::string address = "/tmp/privacy_guard_ipc_bench." + std::to_string(getpid());
+
+	SocketService service(address);
+	if (service.initialize() != PRIV_FLTR_ERROR_SUCCESS
+		|| service.registerServiceCallback(INTERFACE_NAME, "echo", echo) != PRIV_FLTR_ERROR_SUCCESS
+		|| service.registerServiceCallback(INTERFACE_NAME, "countList", countList) != PRIV_FLTR_ERROR_SUCCESS
+		|| service.start() != PRIV_FLTR_ERROR_SUCCESS)
+	{
+		printf("FAIL the service doesn't start\n");
+		unlink(address.c_str());
+		return 1;
+	}
+
+	int failures = 0;
+
+#ifdef USE_IPC_EPOLL
+	// a whole long list still gets through next to the stalled ones
+	std::vector < int > stalledFds;
+	if (stallClients(address, 2 * IPC_WORKER_COUNT, &stalledFds) == false)
+	{
+		++failures;
+	}
+	else
+	{
+		SocketClient socketClient(INTERFACE_NAME, address);
+		std::list < std::string > list(LONG_LIST_SIZE, "org.tizen.ipcbench.application");
+		int echoed = -1;
+		int counted = -1;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int res = socketClient.call("echo", 42, &echoed);
+		if (res == PRIV_FLTR_ERROR_SUCCESS)
+			res = socketClient.call("countList", list, &counted);
+		double elapsedMs = std::chrono::duration < double, std::milli > (std::chrono::steady_clock::now() - start).count();
+		printf("%zu stalled clients, calls next to them took %.1f ms\n", stalledFds.size(), elapsedMs);
+		if (res != PRIV_FLTR_ERROR_SUCCESS || echoed != 42 || counted != LONG_LIST_SIZE || elapsedMs >= STALL_LIMIT_MS)
+		{
+			printf("FAIL calls next to stalled clients : %d, echoed %d, counted %d\n", res, echoed, counted);
+			++failures;
+		}
+	}
+	for (size_t i = 0; i < stalledFds.size(); ++i)
+		close(stalledFds[i]);
+#endif
+
+	const int clientCounts[] = { 1, 16, 256 };
+	for (size_t i = 0; i < sizeof(clientCounts) / sizeof(clientCounts[0]); ++i)
+	{
+		Result result = run(address, clientCounts[i], callCount);
+		printf("%3d clients : %8.0f calls/s, p50 %7.3f ms, p99 %7.3f ms, %lu failed\n",
+			clientCounts[i], result.callsPerSecond, result.p50Ms, result.p99Ms, result.failedCount);
+		if (result.failedCount != 0)
+			++failures;
+	}
+
+	service.stop();
+	unlink(address.c_str());
+
+	return failures == 0 ? 0 : 1;
+}
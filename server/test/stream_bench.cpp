@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// Receives the arguments of PgAddPrivacyAccessLog, a user id and a list of 1000
+// (package id, privacy id) pairs, over a socket pair :
+//   framed : SocketConnection, whole messages received into a reusable buffer
+//   fields : the reader SocketConnection had before, a length and a payload per field,
+//            each read with its own select() and read() into a new buffer
+// The sender writes a call with one write in both cases. Prints calls/s, the bytes/s
+// of ids received and the allocations of the receiving thread per call, and fails when
+// a list is not received as sent or the framed reader allocates more than the list.
+//
+// usage : privacy-guard-stream-bench [calls]
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include "PrivacyGuardTypes.h"
+#include "SocketConnection.h"
+
+#define LOG_COUNT 1000
+#define PACKAGE_COUNT 20
+#define PRIVACY_COUNT 10
+#define OLD_MAX_BUFFER 10240
+
+typedef std::list < std::pair < std::string, std::string > > LogList;
+
+// only the allocations of the receiving thread are counted
+static thread_local bool g_bCounting = false;
+static std::atomic < unsigned long > g_allocationCount(0);
+
+// not inlined, the compiler would pair a malloc() it sees with an operator delete
+static void* __attribute__((noinline))
+allocate(size_t size)
+{
+	if (g_bCounting == true)
+		++g_allocationCount;
+	return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(size_t size)
+{
+	void* pMemory = allocate(size);
+	if (pMemory == NULL)
+		throw std::bad_alloc();
+	return pMemory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+static void __attribute__((noinline))
+release(void* pMemory)
+{
+	free(pMemory);
+}
+
+void operator delete(void* pMemory) noexcept
+{
+	release(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+	release(pMemory);
+}
+
+static LogList
+makeLogList(void)
+{
+	LogList logList;
+	for (int i = 0; i < LOG_COUNT; ++i)
+		logList.push_back(std::make_pair("org.tizen.streambench.application" + std::to_string(i % PACKAGE_COUNT),
+			"http://tizen.org/privacy/streambench" + std::to_string(i % PRIVACY_COUNT)));
+	return logList;
+}
+
+// the encoding SocketConnection had before : every field is its length, then its bytes
+static void
+appendField(std::string* pBytes, const void* pField, int length)
+{
+	pBytes->append(reinterpret_cast < const char* > (&length), sizeof(length));
+	pBytes->append(static_cast < const char* > (pField), length);
+}
+
+static std::string
+encodeFields(int userId, const LogList& logList)
+{
+	std::string bytes;
+	appendField(&bytes, &userId, sizeof(userId));
+	int size = logList.size();
+	appendField(&bytes, &size, sizeof(size));
+	for (LogList::const_iterator iter = logList.begin(); iter != logList.end(); ++iter)
+	{
+		appendField(&bytes, iter->first.data(), iter->first.size());
+		appendField(&bytes, iter->second.data(), iter->second.size());
+	}
+	return bytes;
+}
+
+// SocketStream::readStream as it was : waits with pselect, reads into a stack buffer,
+// gathers the parts in a string and copies them out
+static int
+readStreamOld(int fd, size_t num, void* pBytes)
+{
+	char partBuffer[OLD_MAX_BUFFER];
+	std::string wholeBuffer;
+	size_t bytesToRead = num;
+
+	while (bytesToRead != 0)
+	{
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(fd, &readSet);
+		timespec timeout = { 1, 0 };
+		int res = pselect(fd + 1, &readSet, NULL, NULL, &timeout, NULL);
+		if (res == -1 && errno == EINTR)
+			continue;
+		if (res <= 0)
+			return -1;
+
+		ssize_t bytesRead = read(fd, partBuffer, bytesToRead);
+		if (bytesRead <= 0)
+			return -1;
+		wholeBuffer.append(partBuffer, bytesRead);
+		bytesToRead -= bytesRead;
+	}
+	memcpy(pBytes, wholeBuffer.c_str(), num);
+	return 0;
+}
+
+// SocketConnection::read as it was : the length, then a new buffer for the payload
+static int
+readFieldOld(int fd, std::string* pField)
+{
+	int length = 0;
+	if (readStreamOld(fd, sizeof(length), &length) != 0 || length < 0 || length > OLD_MAX_BUFFER)
+		return -1;
+	char* pBuffer = new (std::nothrow) char[length + 1];
+	if (pBuffer == NULL)
+		return -1;
+	int res = readStreamOld(fd, length, pBuffer);
+	if (res == 0)
+		pField->assign(pBuffer, length);
+	delete[] pBuffer;
+	return res;
+}
+
+static int
+readIntOld(int fd, int* pValue)
+{
+	std::string field;
+	if (readFieldOld(fd, &field) != 0 || field.size() != sizeof(int))
+		return -1;
+	memcpy(pValue, field.data(), sizeof(int));
+	return 0;
+}
+
+static int
+readFields(int fd, int* pUserId, LogList* pLogList)
+{
+	int size = 0;
+	if (readIntOld(fd, pUserId) != 0 || readIntOld(fd, &size) != 0)
+		return -1;
+	for (int i = 0; i < size; ++i)
+	{
+		pLogList->push_back(std::pair < std::string, std::string > ());
+		if (readFieldOld(fd, &pLogList->back().first) != 0 || readFieldOld(fd, &pLogList->back().second) != 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int
+readFramed(SocketConnection* pConnector, int* pUserId, LogList* pLogList)
+{
+	int res = pConnector->readMessage();
+	if (res != PRIV_FLTR_ERROR_SUCCESS)
+		return res;
+	return pConnector->read(pUserId, pLogList);
+}
+
+struct Result
+{
+	double callsPerSecond;
+	double allocationsPerCall;
+	unsigned long failedCount;
+};
+
+// the sender writes every call at once, the receiver takes them one after the other
+template < typename Receive >
+static Result
+run(const std::string& bytes, const int callCount, const int userId, const LogList& logList, Receive receive)
+{
+	Result result = { 0.0, 0.0, 0 };
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+	{
+		result.failedCount = callCount;
+		return result;
+	}
+
+	std::thread sender([&]() {
+		for (int i = 0; i < callCount; ++i)
+		{
+			if (send(fds[0], bytes.data(), bytes.size(), MSG_NOSIGNAL) != (ssize_t)bytes.size())
+				break;
+		}
+	});
+
+	unsigned long allocationCount = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < callCount; ++i)
+	{
+		int receivedUserId = 0;
+		LogList receivedList;
+		unsigned long before = g_allocationCount;
+		g_bCounting = true;
+		int res = receive(fds[1], &receivedUserId, &receivedList);
+		g_bCounting = false;
+		// the first call sizes the buffers the next ones reuse
+		if (i > 0)
+			allocationCount += g_allocationCount - before;
+		if (res != 0 || receivedUserId != userId || receivedList != logList)
+			++result.failedCount;
+	}
+	double elapsedSeconds = std::chrono::duration < double > (std::chrono::steady_clock::now() - start).count();
+
+	sender.join();
+	close(fds[0]);
+	close(fds[1]);
+
+	result.callsPerSecond = callCount / elapsedSeconds;
+	result.allocationsPerCall = (double)allocationCount / (callCount - 1);
+	return result;
+}
+
+int
+main(int argc, char* argv[])
+{
+	int callCount = argc > 1 ? atoi(argv[1]) : 2000;
+	if (callCount < 2)
+		callCount = 2;
+	const int userId = 5001;
+	LogList logList = makeLogList();
+
+	// the bytes of one call in the framed encoding, as SocketClient writes them
+	std::string framedBytes;
+	{
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+			return 1;
+		std::thread receiver([&]() {
+			char buffer[4096];
+			ssize_t length;
+			while ((length = read(fds[1], buffer, sizeof(buffer))) > 0)
+				framedBytes.append(buffer, length);
+		});
+		{
+			SocketConnection connector(fds[0]);
+			connector.write(userId, logList);
+			connector.flush();
+		}
+		close(fds[0]);
+		receiver.join();
+		close(fds[1]);
+	}
+	std::string fieldBytes = encodeFields(userId, logList);
+
+	// one connection for all the calls, its buffer is reused
+	std::shared_ptr < SocketConnection > pConnector;
+	Result framed = run(framedBytes, callCount, userId, logList, [&pConnector](int fd, int* pUserId, LogList* pLogList) {
+		if (pConnector == NULL)
+			pConnector.reset(new SocketConnection(fd));
+		return readFramed(pConnector.get(), pUserId, pLogList);
+	});
+	pConnector.reset();
+	Result fields = run(fieldBytes, callCount, userId, logList, readFields);
+
+	// what filling the list costs, the least a reader can allocate
+	unsigned long before = g_allocationCount;
+	g_bCounting = true;
+	{
+		LogList copy(logList);
+	}
+	g_bCounting = false;
+	unsigned long listAllocations = g_allocationCount - before;
+
+	// the bytes/s of the ids received, the framed encoding sends a repeated string once
+	size_t logBytes = 0;
+	for (LogList::const_iterator iter = logList.begin(); iter != logList.end(); ++iter)
+		logBytes += iter->first.size() + iter->second.size();
+
+	printf("%d calls of %d logs, %zu bytes of ids, %zu bytes per field, %zu bytes framed\n", callCount, LOG_COUNT, logBytes, fieldBytes.size(), framedBytes.size());
+	printf("%-8s %12s %12s %18s\n", "", "calls/s", "MB/s", "allocations/call");
+	printf("%-8s %12.0f %12.1f %18.1f\n", "fields", fields.callsPerSecond, fields.callsPerSecond * logBytes / 1048576.0, fields.allocationsPerCall);
+	printf("%-8s %12.0f %12.1f %18.1f\n", "framed", framed.callsPerSecond, framed.callsPerSecond * logBytes / 1048576.0, framed.allocationsPerCall);
+	printf("filling the list takes %lu allocations\n", listAllocations);
+
+	int failures = 0;
+	if (framed.failedCount != 0 || fields.failedCount != 0)
+	{
+		printf("FAIL %lu framed and %lu per field calls not received as sent\n", framed.failedCount, fields.failedCount);
+		++failures;
+	}
+	if (framed.allocationsPerCall > listAllocations)
+	{
+		printf("FAIL the framed reader allocates %.1f times per call besides the list\n", framed.allocationsPerCall - listAllocations);
+		++failures;
+	}
+	return failures == 0 ? 0 : 1;
+}
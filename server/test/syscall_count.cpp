@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// Counts the syscalls of PgAddPrivacyAccessLog calls carrying 1 to 1000 logs, made
+// with SocketClient to SocketService on a socket of its own. The program is linked with
+// --wrap for sendmsg, recvmsg, poll and epoll_wait, the syscalls the IPC makes for a call.
+// Fails when the client sends a call with more than one sendmsg, or when a call takes
+// more than MAX_SYSCALLS_PER_CALL syscalls on either side, whatever its number of logs.
+//
+// usage : privacy-guard-syscall-count [calls]
+
+#include <atomic>
+#include <list>
+#include <string>
+#include <utility>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "PrivacyGuardTypes.h"
+#include "SocketConnection.h"
+#include "SocketService.h"
+#include "SocketClient.h"
+
+#define INTERFACE_NAME "SyscallCount"
+// a call takes 2 to 5 on each side, depending on which thread of the server gets the request
+#define MAX_SYSCALLS_PER_CALL 8.0
+
+typedef std::list < std::pair < std::string, std::string > > LogList;
+
+// the syscalls of the thread making the calls and those of the server threads
+static thread_local bool g_bClient = false;
+static std::atomic < unsigned long > g_clientSendCount(0);
+static std::atomic < unsigned long > g_clientSyscallCount(0);
+static std::atomic < unsigned long > g_serverSyscallCount(0);
+
+static void
+count(bool bSend)
+{
+	if (g_bClient == false)
+	{
+		++g_serverSyscallCount;
+		return;
+	}
+	++g_clientSyscallCount;
+	if (bSend == true)
+		++g_clientSendCount;
+}
+
+extern "C" {
+ssize_t __real_sendmsg(int fd, const struct msghdr* pMessage, int flags);
+ssize_t __real_recvmsg(int fd, struct msghdr* pMessage, int flags);
+int __real_poll(struct pollfd* pFds, nfds_t fdCount, int timeoutMs);
+int __real_epoll_wait(int epollFd, struct epoll_event* pEvents, int maxEvents, int timeoutMs);
+
+ssize_t
+__wrap_sendmsg(int fd, const struct msghdr* pMessage, int flags)
+{
+	count(true);
+	return __real_sendmsg(fd, pMessage, flags);
+}
+
+ssize_t
+__wrap_recvmsg(int fd, struct msghdr* pMessage, int flags)
+{
+	count(false);
+	return __real_recvmsg(fd, pMessage, flags);
+}
+
+int
+__wrap_poll(struct pollfd* pFds, nfds_t fdCount, int timeoutMs)
+{
+	count(false);
+	return __real_poll(pFds, fdCount, timeoutMs);
+}
+
+int
+__wrap_epoll_wait(int epollFd, struct epoll_event* pEvents, int maxEvents, int timeoutMs)
+{
+	count(false);
+	return __real_epoll_wait(epollFd, pEvents, maxEvents, timeoutMs);
+}
+}
+
+// what PrivacyInfoService::PgAddPrivacyAccessLog reads and answers
+static void
+addPrivacyAccessLog(SocketConnection* pConnector)
+{
+	int userId = 0;
+	LogList logList;
+	int res = pConnector->read(&userId, &logList);
+	pConnector->write(res == PRIV_FLTR_ERROR_SUCCESS ? (int)logList.size() : -1);
+}
+
+struct Count
+{
+	double clientSends;
+	double clientSyscalls;
+	double serverSyscalls;
+	unsigned long failedCount;
+};
+
+static Count
+countCalls(SocketClient* pSocketClient, const LogList& logList, int callCount)
+{
+	Count result = { 0.0, 0.0, 0.0, 0 };
+	unsigned long clientSends = g_clientSendCount;
+	unsigned long clientSyscalls = g_clientSyscallCount;
+	unsigned long serverSyscalls = g_serverSyscallCount;
+
+	for (int i = 0; i < callCount; ++i)
+	{
+		int logCount = -1;
+		int res = pSocketClient->call("PgAddPrivacyAccessLog", 5001, logList, &logCount);
+		if (res != PRIV_FLTR_ERROR_SUCCESS || logCount != (int)logList.size())
+			++result.failedCount;
+	}
+
+	// the server is done with the last call once it waits for the next one
+	usleep(10 * 1000);
+	result.clientSends = (double)(g_clientSendCount - clientSends) / callCount;
+	result.clientSyscalls = (double)(g_clientSyscallCount - clientSyscalls) / callCount;
+	result.serverSyscalls = (double)(g_serverSyscallCount - serverSyscalls) / callCount;
+	return result;
+}
+
+int
+main(int argc, char* argv[])
+{
+	int callCount = argc > 1 ? atoi(argv[1]) : 200;
+	std::string address = "/tmp/privacy_guard_syscall_count." + std::to_string(getpid());
+
+	SocketService service(address);
+	if (service.initialize() != PRIV_FLTR_ERROR_SUCCESS
+		|| service.registerServiceCallback(INTERFACE_NAME, "PgAddPrivacyAccessLog", addPrivacyAccessLog) != PRIV_FLTR_ERROR_SUCCESS
+		|| service.start() != PRIV_FLTR_ERROR_SUCCESS)
+	{
+		printf("FAIL the service doesn't start\n");
+		unlink(address.c_str());
+		return 1;
+	}
+
+	g_bClient = true;
+	SocketClient socketClient(INTERFACE_NAME, address);
+
+	// the service listens once its thread runs, the first call also sizes the buffers
+	LogList logList;
+	logList.push_back(std::make_pair(std::string("org.tizen.syscallcount.application"), std::string("http://tizen.org/privacy/location")));
+	int logCount = -1;
+	for (int attempt = 0; attempt < 100 && socketClient.call("PgAddPrivacyAccessLog", 5001, logList, &logCount) != PRIV_FLTR_ERROR_SUCCESS; ++attempt)
+		usleep(10 * 1000);
+
+	int failures = 0;
+	printf("%-6s %14s %18s %18s\n", "logs", "client sends", "client syscalls", "server syscalls");
+	const int logCounts[] = { 1, 10, 100, 1000 };
+	for (size_t i = 0; i < sizeof(logCounts) / sizeof(logCounts[0]); ++i)
+	{
+		// every log of its own package, nothing is sent once for several logs
+		logList.clear();
+		for (int j = 0; j < logCounts[i]; ++j)
+			logList.push_back(std::make_pair("org.tizen.syscallcount.application" + std::to_string(j), "http://tizen.org/privacy/location" + std::to_string(j)));
+		countCalls(&socketClient, logList, 1);
+
+		Count result = countCalls(&socketClient, logList, callCount);
+		printf("%-6d %14.2f %18.2f %18.2f\n", logCounts[i], result.clientSends, result.clientSyscalls, result.serverSyscalls);
+
+		if (result.failedCount != 0)
+		{
+			printf("FAIL %lu calls of %d logs failed\n", result.failedCount, logCounts[i]);
+			++failures;
+		}
+		if (result.clientSends > 1.0)
+		{
+			printf("FAIL a call of %d logs is sent with %.2f sendmsg\n", logCounts[i], result.clientSends);
+			++failures;
+		}
+		if (result.clientSyscalls > MAX_SYSCALLS_PER_CALL || result.serverSyscalls > MAX_SYSCALLS_PER_CALL)
+		{
+			printf("FAIL a call of %d logs takes more than %.0f syscalls\n", logCounts[i], MAX_SYSCALLS_PER_CALL);
+			++failures;
+		}
+	}
+
+	service.stop();
+	unlink(address.c_str());
+
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2013 Samsung Electronics Co., Ltd All Rights Reserved
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+// Encodes and decodes responses of PrivacyInfoService in the wire format of WireFormat.h
+// and in the one SocketConnection had before, where every field is a 4 byte length and
+// its bytes, an int included. Both go through a socket pair with one send and one
+// receive per response, only the encoding differs. The responses :
+//   policy    : PgGetMonitorPolicy, the result and an int
+//   policies  : PgForeachMonitorPolicyByPackageId, the result and 30 privacy_data_s
+//   counts    : PgForeachTotalPrivacyCountOfPackage, the result and 300 (package id, count)
+// Prints bytes, encodes/s and decodes/s, and fails when a response is decoded wrong.
+//
+// usage : privacy-guard-wire-format-bench [responses]
+
+#include <chrono>
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "PrivacyGuardTypes.h"
+#include "SocketConnection.h"
+
+#define POLICY_COUNT 30
+#define PACKAGE_COUNT 300
+
+typedef std::list < std::pair < std::string, int > > CountList;
+
+// the format before : a length, then the bytes of the field
+class OldEncoder
+{
+public:
+	void write(const int& value)
+	{
+		append(&value, sizeof(value));
+	}
+
+	void write(const std::string& value)
+	{
+		append(value.data(), value.size());
+	}
+
+	void write(const privacy_data_s& value)
+	{
+		append(value.privacy_id, strlen(value.privacy_id));
+		write(value.monitor_policy);
+	}
+
+	template < typename K, typename V >
+	void write(const std::pair < K, V >& value)
+	{
+		write(value.first);
+		write(value.second);
+	}
+
+	template < typename T >
+	void write(const std::list < T >& list)
+	{
+		write((int)list.size());
+		for (typename std::list < T >::const_iterator iter = list.begin(); iter != list.end(); ++iter)
+			write(*iter);
+	}
+
+	std::string m_bytes;
+
+private:
+	void append(const void* pField, int length)
+	{
+		m_bytes.append(reinterpret_cast < const char* > (&length), sizeof(length));
+		m_bytes.append(static_cast < const char* > (pField), length);
+	}
+};
+
+// and its reader, a new buffer for every field as SocketConnection::read had
+class OldDecoder
+{
+public:
+	OldDecoder(const char* pBytes, size_t size)
+		: m_pBytes(pBytes)
+		, m_size(size)
+		, m_offset(0)
+	{
+	}
+
+	bool read(int& value)
+	{
+		std::string field;
+		if (readField(&field) == false || field.size() != sizeof(value))
+			return false;
+		memcpy(&value, field.data(), sizeof(value));
+		return true;
+	}
+
+	bool read(std::string& value)
+	{
+		return readField(&value);
+	}
+
+	bool read(privacy_data_s& value)
+	{
+		std::string privacyId;
+		if (readField(&privacyId) == false)
+			return false;
+		value.privacy_id = strdup(privacyId.c_str());
+		return read(value.monitor_policy);
+	}
+
+	template < typename K, typename V >
+	bool read(std::pair < K, V >& value)
+	{
+		return read(value.first) && read(value.second);
+	}
+
+	template < typename T >
+	bool read(std::list < T >& list)
+	{
+		int size = 0;
+		if (read(size) == false)
+			return false;
+		for (int i = 0; i < size; ++i)
+		{
+			list.push_back(T());
+			if (read(list.back()) == false)
+				return false;
+		}
+		return true;
+	}
+
+private:
+	bool readField(std::string* pField)
+	{
+		int length = 0;
+		if (m_size - m_offset < sizeof(length))
+			return false;
+		memcpy(&length, m_pBytes + m_offset, sizeof(length));
+		m_offset += sizeof(length);
+		if (length < 0 || m_size - m_offset < (size_t)length)
+			return false;
+		char* pBuffer = new char[length + 1];
+		memcpy(pBuffer, m_pBytes + m_offset, length);
+		pField->assign(pBuffer, length);
+		delete[] pBuffer;
+		m_offset += length;
+		return true;
+	}
+
+	const char* m_pBytes;
+	size_t m_size;
+	size_t m_offset;
+};
+
+static void
+freePolicies(std::list < privacy_data_s >& policyList)
+{
+	for (std::list < privacy_data_s >::iterator iter = policyList.begin(); iter != policyList.end(); ++iter)
+		free(iter->privacy_id);
+	policyList.clear();
+}
+
+static bool
+isSame(const std::list < privacy_data_s >& left, const std::list < privacy_data_s >& right)
+{
+	if (left.size() != right.size())
+		return false;
+	for (std::list < privacy_data_s >::const_iterator l = left.begin(), r = right.begin(); l != left.end(); ++l, ++r)
+	{
+		if (strcmp(l->privacy_id, r->privacy_id) != 0 || l->monitor_policy != r->monitor_policy)
+			return false;
+	}
+	return true;
+}
+
+static bool
+isSame(const CountList& left, const CountList& right)
+{
+	return left == right;
+}
+
+static bool
+isSame(const int& left, const int& right)
+{
+	return left == right;
+}
+
+static void
+release(std::list < privacy_data_s >& value)
+{
+	freePolicies(value);
+}
+
+template < typename T >
+static void
+release(T& value)
+{
+}
+
+struct Result
+{
+	size_t bytes;
+	double encodesPerSecond;
+	double decodesPerSecond;
+	unsigned long failedCount;
+};
+
+static double
+perSecond(int count, std::chrono::steady_clock::duration elapsed)
+{
+	return count / std::chrono::duration < double > (elapsed).count();
+}
+
+template < typename T >
+static Result
+runFramed(const T& response, int responseCount)
+{
+	Result result = { 0, 0.0, 0.0, 0 };
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+	{
+		result.failedCount = responseCount;
+		return result;
+	}
+	SocketConnection writer(fds[0]);
+	SocketConnection reader(fds[1]);
+
+	std::chrono::steady_clock::duration encodeTime(0);
+	std::chrono::steady_clock::duration decodeTime(0);
+	for (int i = 0; i < responseCount; ++i)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		writer.write((int)PRIV_FLTR_ERROR_SUCCESS, response);
+		result.bytes = writer.getOutputSize();
+		int res = writer.flush();
+		std::chrono::steady_clock::time_point encoded = std::chrono::steady_clock::now();
+
+		int decodedResult = -1;
+		T decoded = T();
+		if (res == PRIV_FLTR_ERROR_SUCCESS)
+			res = reader.readMessage();
+		if (res == PRIV_FLTR_ERROR_SUCCESS)
+			res = reader.read(&decodedResult, &decoded);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		encodeTime += encoded - start;
+		decodeTime += end - encoded;
+		if (res != PRIV_FLTR_ERROR_SUCCESS || decodedResult != PRIV_FLTR_ERROR_SUCCESS || isSame(decoded, response) == false)
+			++result.failedCount;
+		release(decoded);
+	}
+	close(fds[0]);
+	close(fds[1]);
+
+	result.encodesPerSecond = perSecond(responseCount, encodeTime);
+	result.decodesPerSecond = perSecond(responseCount, decodeTime);
+	return result;
+}
+
+template < typename T >
+static Result
+runOld(const T& response, int responseCount)
+{
+	Result result = { 0, 0.0, 0.0, 0 };
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+	{
+		result.failedCount = responseCount;
+		return result;
+	}
+	std::vector < char > buffer;
+
+	std::chrono::steady_clock::duration encodeTime(0);
+	std::chrono::steady_clock::duration decodeTime(0);
+	for (int i = 0; i < responseCount; ++i)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		OldEncoder encoder;
+		encoder.write((int)PRIV_FLTR_ERROR_SUCCESS);
+		encoder.write(response);
+		result.bytes = encoder.m_bytes.size();
+		bool bSent = send(fds[0], encoder.m_bytes.data(), encoder.m_bytes.size(), MSG_NOSIGNAL) == (ssize_t)encoder.m_bytes.size();
+		std::chrono::steady_clock::time_point encoded = std::chrono::steady_clock::now();
+
+		buffer.resize(result.bytes);
+		size_t received = 0;
+		while (bSent == true && received < buffer.size())
+		{
+			ssize_t length = recv(fds[1], &buffer[received], buffer.size() - received, 0);
+			if (length <= 0)
+				break;
+			received += length;
+		}
+		int decodedResult = -1;
+		T decoded = T();
+		OldDecoder decoder(&buffer[0], received);
+		bool bDecoded = decoder.read(decodedResult) && decoder.read(decoded);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		encodeTime += encoded - start;
+		decodeTime += end - encoded;
+		if (bDecoded == false || decodedResult != PRIV_FLTR_ERROR_SUCCESS || isSame(decoded, response) == false)
+			++result.failedCount;
+		release(decoded);
+	}
+	close(fds[0]);
+	close(fds[1]);
+
+	result.encodesPerSecond = perSecond(responseCount, encodeTime);
+	result.decodesPerSecond = perSecond(responseCount, decodeTime);
+	return result;
+}
+
+template < typename T >
+static int
+compare(const char* pName, const T& response, int responseCount)
+{
+	Result old = runOld(response, responseCount);
+	Result framed = runFramed(response, responseCount);
+	printf("%-9s %-6s %10zu %14.0f %14.0f\n", pName, "old", old.bytes, old.encodesPerSecond, old.decodesPerSecond);
+	printf("%-9s %-6s %10zu %14.0f %14.0f\n", pName, "framed", framed.bytes, framed.encodesPerSecond, framed.decodesPerSecond);
+
+	if (old.failedCount != 0 || framed.failedCount != 0)
+	{
+		printf("FAIL %s : %lu old and %lu framed responses decoded wrong\n", pName, old.failedCount, framed.failedCount);
+		return 1;
+	}
+	return 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+	int responseCount = argc > 1 ? atoi(argv[1]) : 20000;
+
+	std::list < privacy_data_s > policyList;
+	for (int i = 0; i < POLICY_COUNT; ++i)
+	{
+		privacy_data_s policy;
+		policy.privacy_id = strdup(("http://tizen.org/privacy/wireformatbench" + std::to_string(i)).c_str());
+		policy.monitor_policy = i % 2;
+		policyList.push_back(policy);
+	}
+
+	CountList countList;
+	for (int i = 0; i < PACKAGE_COUNT; ++i)
+		countList.push_back(std::make_pair("org.tizen.wireformatbench.application" + std::to_string(i), i * 37));
+
+	printf("%d responses of each\n", responseCount);
+	printf("%-9s %-6s %10s %14s %14s\n", "", "", "bytes", "encodes/s", "decodes/s");
+	int failures = 0;
+	failures += compare("policy", 1, responseCount);
+	failures += compare("policies", policyList, responseCount);
+	failures += compare("counts", countList, responseCount / 10);
+
+	freePolicies(policyList);
+	return failures == 0 ? 0 : 1;
+}